@@ -64,6 +64,10 @@ struct uffs_BufSt{
 	struct uffs_BufSt *prev;			//!< link to previous buffer
 	struct uffs_BufSt *next_dirty;		//!< link to next dirty buffer
 	struct uffs_BufSt *prev_dirty;		//!< link to previous dirty buffer
+	struct uffs_BufSt *next_free;		//!< link to next free (clean, not referenced) buffer
+	struct uffs_BufSt *prev_free;		//!< link to previous free buffer
+	struct uffs_BufSt *hash_next;		//!< link to next buffer in the same hash bucket
+	struct uffs_BufSt **hash_pprev;		//!< link to the pointer of this buffer in the hash bucket
 	u8 type;							//!< #UFFS_TYPE_DIR or #UFFS_TYPE_FILE or #UFFS_TYPE_DATA
 	u8 ext_mark;						//!< extension mark. 
 	u16 parent;							//!< parent serial
@@ -85,10 +89,18 @@ URET uffs_BufInit(struct uffs_DeviceSt *dev, int buf_max, int dirty_buf_max);
 /** release page buffers */
 URET uffs_BufReleaseAll(struct uffs_DeviceSt *dev);
 
+/** re-index the buffer after its parent, serial or page_id is changed */
+void uffs_BufRehash(struct uffs_DeviceSt *dev, uffs_Buf *buf);
+
 /** find the page buffer, move to link list head if found */
 uffs_Buf * uffs_BufGet(struct uffs_DeviceSt *dev, u16 parent, u16 serial, u16 page_id);
 uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev, u8 type, TreeNode *node, u16 page_id, int oflag);
 
+#if CONFIG_READ_AHEAD_PAGES > 0
+/** load the following pages to page buffers ahead of a sequential reader */
+int uffs_BufReadAhead(struct uffs_DeviceSt *dev, u8 type, TreeNode *node, u16 page_id, int count);
+#endif
+
 /** alloc a new page buffer */
 uffs_Buf *uffs_BufNew(struct uffs_DeviceSt *dev, u8 type, u16 parent, u16 serial, u16 page_id);
 
@@ -0,0 +1,96 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+/** 
+ * \file uffs_ckpt.h
+ * \brief tree checkpoint, a snapshot of the block tree kept in reserved blocks,
+ *        plus a journal of blocks modified after the snapshot
+ */
+
+#ifndef _UFFS_CKPT_H_
+#define _UFFS_CKPT_H_
+
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_core.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define UFFS_CKPT_BLOCKS			2		//!< blocks reserved at the end of partition for tree checkpoint
+
+/** for uffs_CkptSt::state */
+#define UFFS_CKPT_STATE_NONE		0		//!< no valid checkpoint on flash
+#define UFFS_CKPT_STATE_CLEAN		1		//!< checkpoint + journal on flash matches the tree in RAM
+#define UFFS_CKPT_STATE_DISABLED	2		//!< checkpoint area can't be used
+
+/** 
+ * \struct uffs_CkptSt
+ * \brief tree checkpoint descriptor
+ */
+struct uffs_CkptSt {
+	u16 start;			//!< first reserved block, #UFFS_INVALID_BLOCK if no block reserved
+	u16 active;			//!< reserved block holding the current checkpoint, #UFFS_INVALID_BLOCK if none
+	u16 pages;			//!< pages used by the current checkpoint
+	u8 state;			//!< #UFFS_CKPT_STATE_NONE, #UFFS_CKPT_STATE_CLEAN or #UFFS_CKPT_STATE_DISABLED
+	u32 seq;			//!< sequence number of the newest checkpoint seen on flash
+	u16 jnl_page;		//!< next free journal page in active block
+	u16 jnl_count;		//!< number of blocks in journal
+	u16 jnl_max;		//!< max number of blocks a journal page can hold
+	u8 *jnl_buf;		//!< journal page image: header followed by block numbers
+};
+
+/** reserve checkpoint blocks from the partition, call before uffs_TreeInit() */
+URET uffs_CkptInit(uffs_Device *dev);
+
+/** restore tree from checkpoint, return U_FAIL if tree need to be built by scanning */
+URET uffs_CkptLoad(uffs_Device *dev);
+
+/** release checkpoint resources */
+void uffs_CkptRelease(uffs_Device *dev);
+
+/** write a new checkpoint if the tree has changed since the last one */
+URET uffs_CkptSave(uffs_Device *dev);
+
+/** record block in journal, called before the block is programmed/erased/marked bad */
+void uffs_CkptJournalAdd(uffs_Device *dev, int block);
+
+/** get blocks modified after the checkpoint was taken, return the number of blocks */
+int uffs_CkptJournalBlocks(uffs_Device *dev, const u16 **blocks);
+
+/** erase the checkpoint area, called when formatting the device */
+URET uffs_CkptFormat(uffs_Device *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
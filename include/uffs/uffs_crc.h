@@ -40,7 +40,12 @@
 
 #include "uffs/uffs_types.h"
 
+/** CRC16 update function, see uffs_crc16sethook() */
+typedef u16 (*uffs_Crc16Func)(const void *data, int length, u16 crc);
+
 u16 uffs_crc16update(const void *data, int length, u16 crc);
+u16 uffs_crc16update_table(const void *data, int length, u16 crc);
 u16 uffs_crc16sum(const void *data, int length);
+void uffs_crc16sethook(uffs_Crc16Func func);
 
 #endif
@@ -0,0 +1,101 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+/** 
+ * \file uffs_dcache.h
+ * \brief dentry cache, names and attributes of DIR/FILE objects kept in RAM
+ *        so that name lookup and readdir don't load the header page
+ */
+
+#ifndef _UFFS_DCACHE_H_
+#define _UFFS_DCACHE_H_
+
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_core.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+struct uffs_FileInfoSt;
+
+/** 
+ * \struct uffs_DentrySt
+ * \brief cached copy of the uffs_FileInfo of a DIR/FILE object
+ */
+struct uffs_DentrySt {
+	u16 serial;			//!< object serial, #INVALID_UFFS_SERIAL if the entry is empty
+	u16 parent;			//!< parent serial
+	u8 type;			//!< #UFFS_TYPE_DIR or #UFFS_TYPE_FILE
+	u8 name_len;		//!< length of name
+	u32 attr;			//!< file/dir attribute
+	u32 create_time;
+	u32 last_modify;
+	u32 access;
+	char name[CONFIG_DENTRY_CACHE_NAME_LEN];
+};
+
+/** 
+ * \struct uffs_DentryCacheSt
+ * \brief dentry cache descriptor, entries are direct mapped by serial
+ */
+struct uffs_DentryCacheSt {
+	struct uffs_DentrySt *entries;	//!< CONFIG_DENTRY_CACHE_ENTRIES entries, NULL if not allocated
+	u32 hit;						//!< lookups served from the cache
+	u32 miss;						//!< lookups that had to load the header page
+};
+
+/** allocate dentry cache */
+URET uffs_DcacheInit(uffs_Device *dev);
+
+/** release dentry cache */
+void uffs_DcacheRelease(uffs_Device *dev);
+
+/** drop all entries, called when formatting the device */
+void uffs_DcacheInvalidateAll(uffs_Device *dev);
+
+/** find the entry of object [serial], NULL if it's not cached */
+const struct uffs_DentrySt * uffs_DcacheFind(uffs_Device *dev, int type, u16 serial, u16 parent);
+
+/** cache the header info [fi] of object [serial], names longer than CONFIG_DENTRY_CACHE_NAME_LEN are not cached */
+void uffs_DcachePut(uffs_Device *dev, int type, u16 serial, u16 parent, const struct uffs_FileInfoSt *fi);
+
+/** drop the entry of object [serial], called when the header page is changed or the object is deleted */
+void uffs_DcacheInvalidate(uffs_Device *dev, u16 serial);
+
+/** fill [fi] from the cached entry [d] */
+void uffs_DcacheLoadInfo(const struct uffs_DentrySt *d, struct uffs_FileInfoSt *fi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -48,6 +48,8 @@
 #include "uffs/uffs_mem.h"
 #include "uffs/uffs_core.h"
 #include "uffs/uffs_flash.h"
+#include "uffs/uffs_ckpt.h"
+#include "uffs/uffs_dcache.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -64,8 +66,12 @@ extern "C"{
  * \brief block information structure, used to manager block information caches
  */
 struct uffs_BlockInfoCacheSt {
-	uffs_BlockInfo *head;			//!< buffer head of block info(spares)
-	uffs_BlockInfo *tail;			//!< buffer tail
+	uffs_BlockInfo *head;			//!< free list head (not referenced, least recently used)
+	uffs_BlockInfo *tail;			//!< free list tail (most recently released)
+	uffs_BlockInfo *infos;			//!< all block info buffers
+	int count;						//!< number of block info buffers
+	u16 *hash;						//!< hash index: block number -> index of infos
+	int hash_size;					//!< slots of hash index
 	void *mem_pool;					//!< internal memory pool, used for release whole buffer
 };
 
@@ -106,6 +112,10 @@ struct uffs_PageBufDescSt {
 	uffs_Buf *head;			//!< head of buffers (double linked list)
 	uffs_Buf *tail;			//!< tail of buffers (double linked list)
 	uffs_Buf *clone;		//!< head of clone buffers (single linked list)
+	uffs_Buf *free_head;	//!< head of free buffers, most recently released
+	uffs_Buf *free_tail;	//!< tail of free buffers, least recently released
+	uffs_Buf **hash;		//!< hash buckets, indexed by (parent, serial, page_id)
+	int hash_size;			//!< number of hash buckets
 	struct uffs_DirtyGroupSt dirtyGroup[MAX_DIRTY_BUF_GROUPS];	//!< dirty buffer groups
 	int buf_max;			//!< maximum buffers
 	int dirty_buf_max;		//!< maximum dirty buffer allowed
@@ -206,6 +216,8 @@ struct uffs_DeviceSt {
 	struct uffs_FlashStatSt			st;			//!< statistic (counters)
 	struct uffs_memAllocatorSt		mem;		//!< uffs memory allocator
 	struct uffs_ConfigSt			cfg;		//!< uffs config
+	struct uffs_CkptSt				ckpt;		//!< tree checkpoint
+	struct uffs_DentryCacheSt		dcache;		//!< dentry cache
 	u32	ref_count;								//!< device reference count
 	int	dev_num;								//!< device number (partition number)	
 };
@@ -265,8 +265,98 @@ struct uffs_FlashOpsSt {
 	 * \return 0 if all pages are clean, otherwise return -1.
 	 */
 	int (*CheckErasedBlock)(uffs_Device *dev, u32 block);
+
+	/**
+	 * Read the spare and the first data bytes of several pages in a block in one batch.
+	 *
+	 * \note this function is optional, UFFS use it to speed up block scanning when mount.
+	 *		driver should pipeline the page reads so that the bus does not idle between commands.
+	 *
+	 * \note data_len bytes from each page are stored to data, spare_len bytes of spare
+	 *		from each page are stored to spare, one after another in the order of pages[].
+	 *
+	 * \return	#UFFS_FLASH_NO_ERR: success
+	 *			#UFFS_FLASH_ECC_OK: page has flip bits and corrected by flash
+	 *			#UFFS_FLASH_IO_ERR: I/O error
+	 *			#UFFS_FLASH_ECC_FAIL: page has flip bits and ecc correct failed
+	 */
+	int (*ScanBlockMeta)(uffs_Device *dev, u32 block, const u32 *pages, int count,
+							u8 *data, int data_len, u8 *spare, int spare_len);
+
+	/**
+	 * Write a full page given in two pieces: mini header and data, UFFS do the layout for spare area.
+	 *
+	 * \note this function is optional, UFFS use it to write page data straight from the caller's buffer.
+	 *		only used with ecc_opt UFFS_ECC_NONE or UFFS_ECC_HW_AUTO and layout_opt UFFS_LAYOUT_UFFS.
+	 *
+	 * \return	#UFFS_FLASH_NO_ERR: success
+	 *			#UFFS_FLASH_IO_ERR: I/O error, expect retry ?
+	 *			#UFFS_FLASH_BAD_BLK: a bad block detected.
+	 */
+	int (*WritePageDirect)(uffs_Device *dev, u32 block, u32 page, const u8 *header, int header_len,
+							const u8 *data, int data_len, const u8 *spare, int spare_len);
+
+	/**
+	 * Read the data of several consecutive pages in a block, for read-ahead.
+	 *
+	 * \note this function is optional, UFFS use it to load pages ahead of a sequential reader.
+	 *		driver should overlap loading the next page from array with the transfer of current page.
+	 *		only used with ecc_opt UFFS_ECC_NONE or UFFS_ECC_HW_AUTO and layout_opt UFFS_LAYOUT_UFFS.
+	 *
+	 * \note data_len bytes of page (page + i) are stored to data[i], the result of that page
+	 *		(#UFFS_FLASH_NO_ERR, #UFFS_FLASH_ECC_OK or #UFFS_FLASH_ECC_FAIL) is stored to ret[i].
+	 *
+	 * \return	#UFFS_FLASH_NO_ERR: all pages are transferred
+	 *			#UFFS_FLASH_IO_ERR: I/O error
+	 */
+	int (*ReadPageSeq)(uffs_Device *dev, u32 block, u32 page, int count,
+							u8 **data, int data_len, int *ret);
+
+	/**
+	 * Read len bytes of page spare, starting at spare column offs.
+	 *
+	 * \note this function is optional, UFFS use it to read page tag or bad block status byte
+	 *		without transferring the rest of the spare. only used with layout_opt UFFS_LAYOUT_UFFS.
+	 *
+	 * \return	#UFFS_FLASH_NO_ERR: success
+	 *			#UFFS_FLASH_ECC_OK: page has flip bits and corrected by flash
+	 *			#UFFS_FLASH_IO_ERR: I/O error
+	 *			#UFFS_FLASH_ECC_FAIL: page has flip bits and ecc correct failed
+	 */
+	int (*ReadPageSpare)(uffs_Device *dev, u32 block, u32 page, int offs, u8 *spare, int len);
+
+	/**
+	 * Start or stop pipelining page writes (cache program).
+	 *
+	 * \note this function is optional, UFFS turn it on while flushing buffers to consecutive pages.
+	 *		when on, WritePage()/WritePageWithLayout()/WritePageDirect() may return before the page
+	 *		is programmed, so that the next page is loaded while the previous one is being programmed.
+	 *		a program failure of a page is then returned by the next page write, or by turning it off.
+	 *
+	 * \return	#UFFS_FLASH_NO_ERR: success
+	 *			#UFFS_FLASH_IO_ERR: I/O error
+	 *			#UFFS_FLASH_BAD_BLK: the last page written failed (when turning off)
+	 */
+	int (*WritePipeline)(uffs_Device *dev, UBOOL on);
 };
 
+/** can page data be written straight from caller's buffer ? */
+#define UFFS_FLASH_CAN_WRITE_DIRECT(dev) \
+	((dev)->ops->WritePageDirect != NULL && \
+	 (dev)->attr->layout_opt == UFFS_LAYOUT_UFFS && \
+	 ((dev)->attr->ecc_opt == UFFS_ECC_NONE || (dev)->attr->ecc_opt == UFFS_ECC_HW_AUTO))
+
+/** can consecutive pages be read in one sequence ? */
+#define UFFS_FLASH_CAN_READ_SEQ(dev) \
+	((dev)->ops->ReadPageSeq != NULL && \
+	 (dev)->attr->layout_opt == UFFS_LAYOUT_UFFS && \
+	 ((dev)->attr->ecc_opt == UFFS_ECC_NONE || (dev)->attr->ecc_opt == UFFS_ECC_HW_AUTO))
+
+/** can part of the spare be read without the rest of it ? */
+#define UFFS_FLASH_CAN_READ_SPARE(dev) \
+	((dev)->ops->ReadPageSpare != NULL && \
+	 (dev)->attr->layout_opt == UFFS_LAYOUT_UFFS)
+
 /** make spare from tag store and ecc */
 void uffs_FlashMakeSpare(uffs_Device *dev, const uffs_TagStore *ts, const u8 *ecc, u8* spare);
 
@@ -279,15 +369,31 @@ int uffs_FlashReadPageTag(uffs_Device *dev, int block, int page, uffs_Tags *tag)
 /** read page data to page buf and do ECC correct */
 int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBOOL skip_ecc);
 
+/** read a whole page (mini header and data) to memory and do ECC correct */
+int uffs_FlashReadPageData(uffs_Device *dev, int block, int page, u8 *header, UBOOL skip_ecc);
+
+/** read whole pages (mini header and data) of consecutive pages in one sequence */
+int uffs_FlashReadPageSeq(uffs_Device *dev, int block, int page, int count, u8 **header, int *ret);
+
 /** write page data and spare */
 int uffs_FlashWritePageCombine(uffs_Device *dev, int block, int page, uffs_Buf *buf, uffs_Tags *tag);
 
+/** write a full page of data straight from memory, and spare */
+int uffs_FlashWritePageDirect(uffs_Device *dev, int block, int page, const u8 *data, uffs_Tags *tag);
+
+/** start or stop pipelining page writes to a block, return the result of the last page when stopping */
+int uffs_FlashWritePipeline(uffs_Device *dev, int block, UBOOL on);
+
 /** Mark this block as bad block */
 int uffs_FlashMarkBadBlock(uffs_Device *dev, int block);
 
 /** Is this block a bad block ? */
 UBOOL uffs_FlashIsBadBlock(uffs_Device *dev, int block);
 
+/** read bad block status, page 0 tag and mini header in one batch */
+struct uffs_MiniHeaderSt;
+int uffs_FlashScanBlockMeta(uffs_Device *dev, uffs_BlockInfo *bc, struct uffs_MiniHeaderSt *header);
+
 /** Erase flash block */
 int uffs_FlashEraseBlock(uffs_Device *dev, int block);
 
@@ -73,6 +73,14 @@ struct uffs_ObjectSt {
 
 	/******* current *******/
 	u32 pos;							//!< current position in file
+#if CONFIG_READ_AHEAD_PAGES > 0
+	u32 ra_pos;							//!< where the last read ended, reading from here is sequential
+#endif
+#ifdef CONFIG_FILE_EXTENTS
+	u16 *extents;						//!< data node index of each fdn, EMPTY_NODE if not looked up yet
+	u16 extent_cap;						//!< entries in extents
+	u32 extent_gen;						//!< tree data_gen when extents was last valid
+#endif
 
 	/***** others *******/
 	UBOOL attr_loaded;					//!< attributes loaded ?
@@ -62,6 +62,8 @@ typedef struct uffs_memAllocatorSt {
 
 	int spare_data_size;				//!< spare size consumed by UFFS, 
 										//!< calculated by UFFS according to the layout information.
+	int spare_tag_offs;					//!< offset of the first tag byte in spare,
+										//!< tag and seal byte are in [spare_tag_offs, spare_data_size).
 
 	/* for static memory allocator */
 	char *buf_start;
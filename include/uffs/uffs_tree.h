@@ -94,7 +94,7 @@ struct FdataSt {	/* 10 bytes */
 	u16 serial;
 };
 
-//UFFS TreeNode (14 or 16 bytes)
+//UFFS TreeNode (18 or 20 bytes)
 typedef struct uffs_TreeNodeSt {
 	union {
 		struct BlockListSt list;
@@ -104,6 +104,8 @@ typedef struct uffs_TreeNodeSt {
 	} u;
 	u16 hash_next;		
 	u16 hash_prev;			
+	u16 child_next;		/* next DIR/FILE node in the same child entry (by parent) */
+	u16 child_prev;
 } TreeNode;
 
 
@@ -147,6 +149,7 @@ typedef struct uffs_TreeNodeSt {
 #define MAX_UFFS_FDN			0x3fff	//!< maximum file data block serial numbers (uffs_TagStore#serial: 14 bits)
 #define PARENT_OF_ROOT			0xfffd	//!< parent of ROOT ? kidding me ...
 #define INVALID_UFFS_SERIAL		0xffff	//!< invalid serial num
+#define UFFS_LAZY_LEN			0xffffffff	//!< length of file/data node not resolved yet (lazy mount)
 
 #define DIR_NODE_HASH_MASK		0x1f
 #define DIR_NODE_ENTRY_LEN		(DIR_NODE_HASH_MASK + 1)
@@ -156,6 +159,9 @@ typedef struct uffs_TreeNodeSt {
 
 #define DATA_NODE_HASH_MASK		0x1ff
 #define DATA_NODE_ENTRY_LEN		(DATA_NODE_HASH_MASK + 1)
+
+#define CHILD_NODE_HASH_MASK	0x3f
+#define CHILD_NODE_ENTRY_LEN	(CHILD_NODE_HASH_MASK + 1)
 #define FROM_IDX(idx, pool)		((TreeNode *)uffs_PoolGetBufByIndex(pool, idx))
 #define TO_IDX(p, pool)			((u16)uffs_PoolGetIndex(pool, (void *) p))
 
@@ -163,6 +169,10 @@ typedef struct uffs_TreeNodeSt {
 #define GET_FILE_HASH(serial)			(serial & FILE_NODE_HASH_MASK)
 #define GET_DIR_HASH(serial)			(serial & DIR_NODE_HASH_MASK)
 #define GET_DATA_HASH(parent, serial)	((parent + serial) & DATA_NODE_HASH_MASK)
+#define GET_CHILD_HASH(parent)			(parent & CHILD_NODE_HASH_MASK)
+
+#define FSN_MAP_SET(tree, serial)		((tree)->fsn_map[((serial) & MAX_UFFS_FSN) >> 3] |= (1 << ((serial) & 7)))
+#define FSN_MAP_CLR(tree, serial)		((tree)->fsn_map[((serial) & MAX_UFFS_FSN) >> 3] &= ~(1 << ((serial) & 7)))
 
 
 struct uffs_TreeSt {
@@ -178,7 +188,14 @@ struct uffs_TreeSt {
 	u16 dir_entry[DIR_NODE_ENTRY_LEN];
 	u16 file_entry[FILE_NODE_ENTRY_LEN];
 	u16 data_entry[DATA_NODE_ENTRY_LEN];
+	u16 dir_child[CHILD_NODE_ENTRY_LEN];	//!< DIR nodes hashed by parent, linked by child_next
+	u16 file_child[CHILD_NODE_ENTRY_LEN];	//!< FILE nodes hashed by parent, linked by child_next
+	u8 fsn_map[(MAX_UFFS_FSN + 1) / 8];		//!< DIR/FILE serials in use (on tree or suspended), one bit each
+	u16 *block_map;							//!< owner node of each partition block, region code << 13 | node index
 	u16 max_serial;
+#ifdef CONFIG_FILE_EXTENTS
+	u32 data_gen;						//!< bumped when a DATA node leaves the tree, invalidates object extent tables
+#endif
 };
 
 
@@ -227,7 +244,13 @@ void uffs_TreeInsertToBadBlockList(uffs_Device *dev, TreeNode *node);
 
 void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node);
 
-void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, u16 block);
+void uffs_TreeSetNodeBlock(uffs_Device *dev, u8 type, TreeNode *node, u16 block);
+void uffs_TreeSetNodeParent(uffs_Device *dev, u8 type, TreeNode *node, u16 parent);
+
+#ifdef CONFIG_LAZY_MOUNT
+URET uffs_TreeResolveFile(uffs_Device *dev, TreeNode *node);
+URET uffs_TreeResolveAll(uffs_Device *dev);
+#endif
 
 
 #ifdef __cplusplus
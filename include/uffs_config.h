@@ -192,11 +192,102 @@
 
 /**
  * \def CONFIG_PAGE_WRITE_VERIFY
+ * \note not defined for the "program status only" level, the flash driver
+ *       checks the program status on every write anyway.
  */
-#ifdef CONFIG_UFFS_PAGE_WRITE_VERIFY
+#if defined(CONFIG_UFFS_PAGE_WRITE_VERIFY) &&                                  \
+    !defined(CONFIG_UFFS_PAGE_WRITE_VERIFY_STATUS)
 #define CONFIG_PAGE_WRITE_VERIFY
 #endif
 
+/**
+ * \def CONFIG_PAGE_WRITE_VERIFY_LEVEL
+ * \note what is read back to verify a page write:
+ *       UFFS_VERIFY_FULL: whole page and tag, compared with what is written.
+ *       UFFS_VERIFY_TAG: mini header and tag only, page data is left to the
+ *       ECC status of the flash (for on-die ECC).
+ */
+#define UFFS_VERIFY_FULL 0
+#define UFFS_VERIFY_TAG 1
+
+#ifdef CONFIG_UFFS_PAGE_WRITE_VERIFY_TAG
+#define CONFIG_PAGE_WRITE_VERIFY_LEVEL UFFS_VERIFY_TAG
+#else
+#define CONFIG_PAGE_WRITE_VERIFY_LEVEL UFFS_VERIFY_FULL
+#endif
+
+/**
+ * \def CONFIG_PAGE_WRITE_VERIFY_INTERVAL
+ * \note verify one of every N pages of a block, the others are left to the
+ *       program status.
+ */
+#ifdef CONFIG_UFFS_PAGE_WRITE_VERIFY_INTERVAL
+#define CONFIG_PAGE_WRITE_VERIFY_INTERVAL CONFIG_UFFS_PAGE_WRITE_VERIFY_INTERVAL
+#else
+#define CONFIG_PAGE_WRITE_VERIFY_INTERVAL 1
+#endif
+
+/**
+ * \def CONFIG_TREE_CHECKPOINT
+ */
+#ifdef CONFIG_UFFS_TREE_CHECKPOINT
+#define CONFIG_TREE_CHECKPOINT
+#endif
+
+/**
+ * \def CONFIG_LAZY_MOUNT
+ */
+#ifdef CONFIG_UFFS_LAZY_MOUNT
+#define CONFIG_LAZY_MOUNT
+#endif
+
+/**
+ * \def CONFIG_DIRECT_WRITE
+ */
+#ifdef CONFIG_UFFS_DIRECT_WRITE
+#define CONFIG_DIRECT_WRITE
+#endif
+
+/**
+ * \def CONFIG_READ_AHEAD_PAGES
+ */
+#ifdef CONFIG_UFFS_READ_AHEAD_PAGES
+#define CONFIG_READ_AHEAD_PAGES CONFIG_UFFS_READ_AHEAD_PAGES
+#else
+#define CONFIG_READ_AHEAD_PAGES 0
+#endif
+
+/**
+ * \def CONFIG_FILE_EXTENTS
+ * \note open files remember the data node of each block they access,
+ *       instead of searching the data node hash table every time.
+ */
+#ifdef CONFIG_UFFS_FILE_EXTENTS
+#define CONFIG_FILE_EXTENTS
+#endif
+
+/**
+ * \def CONFIG_DENTRY_CACHE_ENTRIES
+ * \note number of DIR/FILE names and attributes cached in RAM, 0 disables
+ *       the dentry cache.
+ */
+#ifdef CONFIG_UFFS_DENTRY_CACHE_ENTRIES
+#define CONFIG_DENTRY_CACHE_ENTRIES CONFIG_UFFS_DENTRY_CACHE_ENTRIES
+#else
+#define CONFIG_DENTRY_CACHE_ENTRIES 0
+#endif
+
+/**
+ * \def CONFIG_DENTRY_CACHE_NAME_LEN
+ * \note longest name kept in the dentry cache, longer names are always
+ *       loaded from the header page.
+ */
+#ifdef CONFIG_UFFS_DENTRY_CACHE_NAME_LEN
+#define CONFIG_DENTRY_CACHE_NAME_LEN CONFIG_UFFS_DENTRY_CACHE_NAME_LEN
+#else
+#define CONFIG_DENTRY_CACHE_NAME_LEN 32
+#endif
+
 /**
  * \def CONFIG_BAD_BLOCK_POLICY_STRICT
  */
@@ -219,7 +310,8 @@
  *	\brief calculate memory bytes for block info caches
  */
 #define UFFS_BLOCK_INFO_BUFFER_SIZE(n_pages_per_block)                         \
-  ((sizeof(uffs_BlockInfo) + sizeof(uffs_PageSpare) * n_pages_per_block) *     \
+  ((sizeof(uffs_BlockInfo) + sizeof(uffs_PageSpare) * n_pages_per_block +     \
+    sizeof(u16) * 2) *                                                         \
    MAX_CACHED_BLOCK_INFO)
 
 /**
@@ -227,7 +319,7 @@
  *	\brief calculate memory bytes for page buffers
  */
 #define UFFS_PAGE_BUFFER_SIZE(n_page_size)                                     \
-  ((sizeof(uffs_Buf) + n_page_size) * MAX_PAGE_BUFFERS)
+  ((sizeof(uffs_Buf) + sizeof(uffs_Buf *) + n_page_size) * MAX_PAGE_BUFFERS)
 
 /**
  *	\def UFFS_TREE_BUFFER_SIZE
@@ -283,6 +375,10 @@
 #error "Please increase FD_SIGNATURE_SHIFT !"
 #endif
 
+#if (CONFIG_READ_AHEAD_PAGES >= MAX_PAGE_BUFFERS - CLONE_BUFFERS_THRESHOLD)
+#error "CONFIG_READ_AHEAD_PAGES should < (MAX_PAGE_BUFFERS - CLONE_BUFFERS_THRESHOLD)"
+#endif
+
 #if CONFIG_MAX_PENDING_BLOCKS < 2
 #error "Please increase CONFIG_MAX_PENDING_BLOCKS, normally 4"
 #endif
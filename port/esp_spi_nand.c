@@ -17,8 +17,10 @@
 #include "esp_spi_nand.h"
 #include "esp_heap_caps.h" // For runtime mock sizing check
 #include "esp_log.h"
+#include "esp_rom_crc.h"
 #include "esp_spi_nand_common.h"
 #include "esp_spi_nand_types.h"
+#include "uffs/uffs_crc.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -38,8 +40,14 @@ static int uffs_spi_nand_free(struct uffs_DeviceSt *dev, void *p) {
 static int uffs_spi_nand_device_init(uffs_Device *dev) {
   // This is called by UFFS when mounting
   if (dev->ops->InitFlash) {
-    return dev->ops->InitFlash(dev);
+    if (dev->ops->InitFlash(dev) < 0)
+      return -1;
   }
+#ifdef CONFIG_UFFS_SPI_NAND_BBT
+  // Without the table, bad blocks are checked by reading the markers
+  if (spi_nand_bbt_load(dev) != 0)
+    ESP_LOGW(TAG, "Bad block table not available");
+#endif
   return 0;
 }
 
@@ -47,6 +55,14 @@ static int uffs_spi_nand_device_release(uffs_Device *dev) {
   if (dev->ops->ReleaseFlash) {
     dev->ops->ReleaseFlash(dev);
   }
+#ifdef CONFIG_UFFS_SPI_NAND_BBT
+  spi_nand_bbt_release(dev);
+#endif
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  spi_nand_program_wait(priv);
+  spi_nand_wait_release(priv);
+  heap_caps_free(priv->bounce);
+  priv->bounce = NULL;
   return 0;
 }
 
@@ -85,6 +101,8 @@ esp_err_t uffs_spi_nand_init_generic(struct uffs_DeviceSt *dev,
 #else
   priv->total_blocks = 1024; // Generic fallback size
 #endif
+  // Timing unknown, poll once per tick
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_TICK, 0, 0, 0);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -99,9 +117,12 @@ esp_err_t uffs_spi_nand_init_generic(struct uffs_DeviceSt *dev,
   ops->ReleaseFlash = NULL;
   ops->ReadPage = uffs_spi_nand_read_page_generic;
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   // We don't have a generic write_page_with_layout because it needs MakeSpare
   // which might be specific But we can use a simple one
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
+  ops->ScanBlockMeta = uffs_spi_nand_scan_block_meta_generic;
+  ops->ReadPageSpare = uffs_spi_nand_read_page_spare_generic;
 
   dev->attr = attr;
   dev->ops = ops;
@@ -119,6 +140,13 @@ static const spi_nand_driver_desc_t drivers[] = {
     {.mfr_id = 0x0B, .name = "XTX", .init = uffs_spi_nand_init_xtx},
 };
 
+#ifdef CONFIG_UFFS_ROM_CRC16
+// ROM crc16_le inverts the CRC in and out, UFFS CRC16 doesn't
+static u16 uffs_spi_nand_rom_crc16(const void *data, int length, u16 crc) {
+  return (u16)~esp_rom_crc16_le((u16)~crc, data, length);
+}
+#endif
+
 esp_err_t esp_uffs_spi_nand_init(uffs_Device *dev,
                                  spi_device_handle_t spi_handle) {
   if (!dev || !spi_handle)
@@ -156,10 +184,37 @@ esp_err_t esp_uffs_spi_nand_init(uffs_Device *dev,
   }
 
   if (ret == ESP_OK) {
+#ifdef CONFIG_UFFS_SPI_NAND_BBT
+    dev->ops->IsBadBlock = uffs_spi_nand_bbt_is_bad;
+    dev->ops->MarkBadBlock = uffs_spi_nand_bbt_mark_bad;
+#endif
     dev->Init = uffs_spi_nand_device_init;
     dev->Release = uffs_spi_nand_device_release;
     dev->mem.malloc = uffs_spi_nand_malloc;
     dev->mem.free = uffs_spi_nand_free;
+#ifdef CONFIG_UFFS_ROM_CRC16
+    uffs_crc16sethook(uffs_spi_nand_rom_crc16);
+#endif
   }
   return ret;
 }
+
+esp_err_t esp_uffs_spi_nand_get_wait_stats(uffs_Device *dev,
+                                           spi_nand_wait_op_t op,
+                                           spi_nand_wait_stats_t *stats) {
+  if (!dev || !dev->attr || !dev->attr->_private || !stats ||
+      op >= SPI_NAND_WAIT_OP_MAX)
+    return ESP_ERR_INVALID_ARG;
+
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  *stats = priv->wait_stats[op];
+  return ESP_OK;
+}
+
+void esp_uffs_spi_nand_reset_wait_stats(uffs_Device *dev) {
+  if (!dev || !dev->attr || !dev->attr->_private)
+    return;
+
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  memset(priv->wait_stats, 0, sizeof(priv->wait_stats));
+}
@@ -25,6 +25,27 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Flash operations the driver waits for
+ */
+typedef enum {
+  SPI_NAND_WAIT_READ = 0, // Page read to cache (tR)
+  SPI_NAND_WAIT_PROG,     // Page program (tPROG)
+  SPI_NAND_WAIT_ERASE,    // Block erase (tBERS)
+  SPI_NAND_WAIT_OP_MAX,
+} spi_nand_wait_op_t;
+
+/**
+ * @brief Busy wait statistics of one operation type
+ */
+typedef struct {
+  uint32_t count;    // Operations waited for
+  uint32_t polls;    // Status register reads
+  uint32_t sleeps;   // Times the task slept while the chip was busy
+  uint64_t total_us; // Time spent waiting
+  uint32_t max_us;   // Longest wait
+} spi_nand_wait_stats_t;
+
 /**
  * @brief Initialize the UFFS device structure for a generic SPI NAND
  *
@@ -45,6 +66,29 @@ extern "C" {
 esp_err_t esp_uffs_spi_nand_init(uffs_Device *dev,
                                  spi_device_handle_t spi_handle);
 
+/**
+ * @brief Get the busy wait statistics of a device
+ *
+ * Shows how much time is spent waiting for the chip to finish page reads,
+ * programs and erases.
+ *
+ * @param dev Device initialized by esp_uffs_spi_nand_init().
+ * @param op Operation type.
+ * @param stats Filled with the statistics counted since init or the last
+ * reset.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters.
+ */
+esp_err_t esp_uffs_spi_nand_get_wait_stats(uffs_Device *dev,
+                                           spi_nand_wait_op_t op,
+                                           spi_nand_wait_stats_t *stats);
+
+/**
+ * @brief Reset the busy wait statistics of a device
+ *
+ * @param dev Device initialized by esp_uffs_spi_nand_init().
+ */
+void esp_uffs_spi_nand_reset_wait_stats(uffs_Device *dev);
+
 #ifdef __cplusplus
 }
 #endif
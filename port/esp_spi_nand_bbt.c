@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024 Ihtesham Ullah
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "esp_log.h"
+#include "esp_spi_nand_common.h"
+#include "uffs/uffs_crc.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_flash.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_UFFS_SPI_NAND_BBT
+
+static const char *TAG = "uffs_nand_bbt";
+
+#define BBT_MAGIC 0x30544242 // "BBT0"
+
+// Page 0 of each table block: header followed by the bitmap
+typedef struct {
+  uint32_t magic;
+  uint32_t version; // the copy with the highest version wins
+  uint32_t blocks;  // blocks covered by the bitmap
+  uint16_t crc;     // crc16 of the bitmap
+  uint16_t copies;  // usable table blocks, a cleared bit is a bad copy
+} spi_nand_bbt_hdr_t;
+
+#define BBT_BYTES(priv) (((priv)->total_blocks + 7) / 8)
+#define BBT_IS_BAD(priv, b) ((priv)->bbt[(b) >> 3] & (1 << ((b) & 7)))
+#define BBT_SET_BAD(priv, b) ((priv)->bbt[(b) >> 3] |= (1 << ((b) & 7)))
+#define BBT_ALL_COPIES ((1 << SPI_NAND_BBT_BLOCKS) - 1)
+
+// Factory bad block marker: status byte in spare of page 0 or page 1
+static bool spi_nand_bbt_check_marker(struct uffs_DeviceSt *dev, u32 block) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  int offs = dev->attr->block_status_offs;
+  uint8_t spare[64];
+
+  if (offs >= (int)sizeof(spare) || offs >= (int)priv->spare_size)
+    return false;
+
+  for (u32 page = 0; page < 2; page++) {
+    int ret;
+    if (dev->ops->ReadPageSpare) // Status byte only
+      ret = dev->ops->ReadPageSpare(dev, block, page, offs, &spare[offs], 1);
+    else
+      ret = dev->ops->ReadPage(dev, block, page, NULL, 0, NULL, spare,
+                               offs + 1);
+    if (UFFS_FLASH_HAVE_ERR(ret))
+      continue;
+    if (spare[offs] != 0xFF)
+      return true;
+  }
+
+  return false;
+}
+
+// Write the table to the usable copies in mask. A copy that fails is dropped
+// from bbt_copies, and the remaining copies are written again with a new
+// version so that the loss is kept on flash and not retried on every mount.
+static int spi_nand_bbt_save(struct uffs_DeviceSt *dev, uint32_t mask) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  size_t len = sizeof(spi_nand_bbt_hdr_t) + BBT_BYTES(priv);
+  uint32_t written = 0, failed;
+
+  uint8_t *buf = malloc(len);
+  if (!buf)
+    return -1;
+
+  spi_nand_bbt_hdr_t *hdr = (spi_nand_bbt_hdr_t *)buf;
+  hdr->magic = BBT_MAGIC;
+  hdr->blocks = priv->total_blocks;
+  hdr->crc = uffs_crc16sum(priv->bbt, BBT_BYTES(priv));
+  memcpy(buf + sizeof(spi_nand_bbt_hdr_t), priv->bbt, BBT_BYTES(priv));
+
+  for (;;) {
+    hdr->version = priv->bbt_version;
+    hdr->copies = (uint16_t)(~BBT_ALL_COPIES | priv->bbt_copies);
+    written = failed = 0;
+    for (u32 i = 0; i < SPI_NAND_BBT_BLOCKS; i++) {
+      if (!(mask & priv->bbt_copies & (1 << i)))
+        continue;
+      if (dev->ops->EraseBlock(dev, i) == UFFS_FLASH_NO_ERR &&
+          dev->ops->WritePage(dev, i, 0, buf, len, NULL, 0) ==
+              UFFS_FLASH_NO_ERR) {
+        written |= 1 << i;
+      } else {
+        ESP_LOGW(TAG, "Bad block table copy %u failed", (unsigned int)i);
+        failed |= 1 << i;
+      }
+    }
+    priv->bbt_copies &= ~failed;
+    if (!failed || !priv->bbt_copies)
+      break;
+    mask = priv->bbt_copies;
+    priv->bbt_version++;
+  }
+  free(buf);
+
+  if (written == 0) {
+    ESP_LOGE(TAG, "Fail to write bad block table");
+    return -1;
+  }
+
+  return 0;
+}
+
+int spi_nand_bbt_load(struct uffs_DeviceSt *dev) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  size_t len = sizeof(spi_nand_bbt_hdr_t) + BBT_BYTES(priv);
+  uint32_t best = 0, latest = 0, copies = BBT_ALL_COPIES;
+  int valid = 0;
+
+  if (len > priv->page_size)
+    return -1;
+
+  if (!priv->bbt) {
+    priv->bbt = calloc(1, BBT_BYTES(priv));
+    if (!priv->bbt)
+      return -1;
+  }
+
+  uint8_t *buf = malloc(len);
+  if (!buf) {
+    spi_nand_bbt_release(dev);
+    return -1;
+  }
+
+  spi_nand_bbt_hdr_t *hdr = (spi_nand_bbt_hdr_t *)buf;
+  uint8_t *bitmap = buf + sizeof(spi_nand_bbt_hdr_t);
+
+  for (u32 i = 0; i < SPI_NAND_BBT_BLOCKS; i++) {
+    int ret = dev->ops->ReadPage(dev, i, 0, buf, len, NULL, NULL, 0);
+    if (UFFS_FLASH_HAVE_ERR(ret) || hdr->magic != BBT_MAGIC ||
+        hdr->blocks != priv->total_blocks ||
+        hdr->crc != uffs_crc16sum(bitmap, BBT_BYTES(priv)))
+      continue;
+
+    if (valid == 0 || hdr->version > best) {
+      best = hdr->version;
+      copies = hdr->copies & BBT_ALL_COPIES;
+      memcpy(priv->bbt, bitmap, BBT_BYTES(priv));
+      latest = 1 << i;
+    } else if (hdr->version == best) {
+      latest |= 1 << i;
+    }
+    valid++;
+  }
+  free(buf);
+
+  if (valid == 0) {
+    // First use: build the table from factory bad block markers. A table
+    // block that is factory bad is never erased, its marker would be lost.
+    ESP_LOGI(TAG, "No bad block table, scanning %u blocks",
+             (unsigned int)priv->total_blocks);
+    memset(priv->bbt, 0, BBT_BYTES(priv));
+    priv->bbt_copies = BBT_ALL_COPIES;
+    for (u32 b = 0; b < priv->total_blocks; b++) {
+      if (spi_nand_bbt_check_marker(dev, b)) {
+        ESP_LOGW(TAG, "Factory bad block %u", (unsigned int)b);
+        BBT_SET_BAD(priv, b);
+        if (b < SPI_NAND_BBT_BLOCKS)
+          priv->bbt_copies &= ~(1 << b);
+      }
+    }
+    priv->bbt_version = 1;
+    return spi_nand_bbt_save(dev, BBT_ALL_COPIES);
+  }
+
+  priv->bbt_version = best;
+  priv->bbt_copies = copies;
+  if (copies & ~latest) {
+    // A copy is lost or stale (e.g. power loss while saving), rewrite it
+    ESP_LOGW(TAG, "Repair bad block table, version %u",
+             (unsigned int)best);
+    spi_nand_bbt_save(dev, copies & ~latest);
+  }
+
+  return 0;
+}
+
+void spi_nand_bbt_release(struct uffs_DeviceSt *dev) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  free(priv->bbt);
+  priv->bbt = NULL;
+}
+
+int uffs_spi_nand_bbt_is_bad(struct uffs_DeviceSt *dev, u32 block) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+
+  if (block < SPI_NAND_BBT_BLOCKS || block >= priv->total_blocks)
+    return 1; // Table blocks are kept away from UFFS
+
+  if (!priv->bbt) // Table not available, read the marker
+    return spi_nand_bbt_check_marker(dev, block) ? 1 : 0;
+
+  return BBT_IS_BAD(priv, block) ? 1 : 0;
+}
+
+int uffs_spi_nand_bbt_mark_bad(struct uffs_DeviceSt *dev, u32 block) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  int offs = dev->attr->block_status_offs;
+  uint8_t spare[64];
+
+  if (block < SPI_NAND_BBT_BLOCKS || block >= priv->total_blocks ||
+      offs >= (int)sizeof(spare))
+    return -1;
+
+  // Also mark the block itself, in case the table is lost
+  memset(spare, 0xFF, sizeof(spare));
+  spare[offs] = 0x00;
+  dev->ops->EraseBlock(dev, block);
+  int ret = dev->ops->WritePage(dev, block, 0, NULL, 0, spare, offs + 1);
+
+  if (priv->bbt) {
+    BBT_SET_BAD(priv, block);
+    priv->bbt_version++;
+    if (spi_nand_bbt_save(dev, BBT_ALL_COPIES) == 0)
+      return 0;
+  }
+
+  return ret == UFFS_FLASH_NO_ERR ? 0 : -1;
+}
+
+#endif
@@ -15,13 +15,22 @@
  */
 
 #include "esp_spi_nand_common.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "uffs/uffs_device.h"
 #include "uffs/uffs_flash.h"
+#include <stdbool.h>
 #include <string.h>
 
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#include <unistd.h>
+#else
+#include "esp_rom_sys.h"
+#endif
+
 static const char *TAG = "uffs_nand_common";
 
 esp_err_t spi_nand_op(spi_device_handle_t spi, const uint8_t *tx_data,
@@ -70,11 +79,384 @@ esp_err_t spi_nand_wait_busy(spi_device_handle_t spi, uint32_t timeout_ms,
   }
 }
 
+void spi_nand_wait_init(spi_nand_priv_t *priv, spi_nand_wait_mode_t mode,
+                        uint32_t t_read_us, uint32_t t_prog_us,
+                        uint32_t t_erase_us) {
+  priv->wait_mode = mode;
+  priv->wait_typ_us[SPI_NAND_WAIT_READ] = t_read_us;
+  priv->wait_typ_us[SPI_NAND_WAIT_PROG] = t_prog_us;
+  priv->wait_typ_us[SPI_NAND_WAIT_ERASE] = t_erase_us;
+}
+
+static int64_t spi_nand_time_us(void) {
+#ifdef CONFIG_IDF_TARGET_LINUX
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+  return esp_timer_get_time();
+#endif
+}
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+static void spi_nand_wait_timer_cb(void *arg) {
+  xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+#endif
+
+// Sleep for us microseconds: whole ticks with vTaskDelay, shorter sleeps on
+// a one shot esp_timer so other tasks can run meanwhile
+static void spi_nand_sleep_us(spi_nand_priv_t *priv, uint32_t us) {
+  const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+
+  if (us >= tick_us) {
+    vTaskDelay(us / tick_us);
+    return;
+  }
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+  usleep(us);
+#else
+  if (us < SPI_NAND_TIMER_MIN_US) {
+    esp_rom_delay_us(us);
+    return;
+  }
+
+  if (!priv->wait_timer) {
+    if (!priv->wait_sem)
+      priv->wait_sem = xSemaphoreCreateBinary();
+    esp_timer_create_args_t args = {
+        .callback = spi_nand_wait_timer_cb,
+        .arg = priv->wait_sem,
+        .name = "uffs_nand_wait",
+    };
+    if (!priv->wait_sem ||
+        esp_timer_create(&args, &priv->wait_timer) != ESP_OK) {
+      priv->wait_timer = NULL;
+      vTaskDelay(1);
+      return;
+    }
+  }
+
+  if (esp_timer_start_once(priv->wait_timer, us) != ESP_OK) {
+    vTaskDelay(1);
+    return;
+  }
+  if (xSemaphoreTake(priv->wait_sem, 2) != pdTRUE) {
+    // Don't leave a give pending for the next sleep, it would return early
+    esp_timer_stop(priv->wait_timer);
+    xSemaphoreTake(priv->wait_sem, 0);
+  }
+#endif
+}
+
+esp_err_t spi_nand_wait(spi_nand_priv_t *priv, spi_nand_wait_op_t op,
+                        uint8_t *status_out) {
+  spi_nand_wait_stats_t *stats = &priv->wait_stats[op];
+  uint32_t typ = priv->wait_typ_us[op];
+  bool adaptive = priv->wait_mode == SPI_NAND_WAIT_MODE_ADAPTIVE && typ > 0;
+  uint8_t cmd[] = {CMD_GET_FEATURE, REG_STATUS};
+  uint8_t status;
+  int64_t start = spi_nand_time_us();
+  int64_t elapsed;
+
+  // The chip can't be ready before the typical time, don't poll until then
+  if (adaptive && typ > SPI_NAND_POLL_WINDOW_US) {
+    spi_nand_sleep_us(priv, typ - SPI_NAND_POLL_WINDOW_US);
+    stats->sleeps++;
+  }
+
+  while (1) {
+    spi_transaction_t t = {
+        .length = 16, // 8 bit cmd + 8 bit addr
+        .tx_buffer = cmd,
+        .rxlength = 8, // 8 bit status
+        .rx_buffer = &status,
+    };
+    esp_err_t ret = spi_device_polling_transmit(priv->spi, &t);
+    if (ret != ESP_OK)
+      return ret;
+    stats->polls++;
+
+    elapsed = spi_nand_time_us() - start;
+    if (!(status & SR_BUSY))
+      break;
+
+    if (elapsed > NAND_TIMEOUT_MS * 1000) {
+      ESP_LOGE(TAG, "NAND Busy Timeout! Status: 0x%02X", status);
+      return ESP_ERR_TIMEOUT;
+    }
+
+    if (!adaptive) {
+      vTaskDelay(1); // 1 tick
+      stats->sleeps++;
+    } else if (elapsed > typ + SPI_NAND_POLL_WINDOW_US) {
+      // Slower than typical (e.g. worn block), back off instead of spinning
+      uint32_t us = typ / 4;
+      if (us < SPI_NAND_POLL_WINDOW_US)
+        us = SPI_NAND_POLL_WINDOW_US;
+      spi_nand_sleep_us(priv, us);
+      stats->sleeps++;
+    }
+  }
+
+  stats->count++;
+  stats->total_us += elapsed;
+  if (elapsed > stats->max_us)
+    stats->max_us = elapsed;
+
+  if (status_out)
+    *status_out = status;
+  return ESP_OK;
+}
+
+void spi_nand_wait_release(spi_nand_priv_t *priv) {
+#ifndef CONFIG_IDF_TARGET_LINUX
+  if (priv->wait_timer) {
+    esp_timer_stop(priv->wait_timer);
+    esp_timer_delete(priv->wait_timer);
+    priv->wait_timer = NULL;
+  }
+  if (priv->wait_sem) {
+    vSemaphoreDelete(priv->wait_sem);
+    priv->wait_sem = NULL;
+  }
+#endif
+}
+
 esp_err_t spi_nand_write_enable(spi_device_handle_t spi) {
   uint8_t cmd = CMD_WRITE_ENABLE;
   return spi_nand_op(spi, &cmd, 1, NULL, 0);
 }
 
+esp_err_t spi_nand_program_wait(spi_nand_priv_t *priv) {
+  if (!priv->prog_pending)
+    return ESP_OK;
+
+  uint8_t status = 0;
+  uint32_t page_addr = priv->prog_page_addr;
+  priv->prog_pending = false;
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_PROG, &status) != ESP_OK) {
+    priv->prog_result = UFFS_FLASH_IO_ERR;
+    return ESP_FAIL;
+  }
+
+  if (status & SR_P_FAIL) {
+    ESP_LOGE(TAG, "Program Failed at Blk %u Pg %u (Stat: 0x%02X)",
+             (unsigned int)(page_addr / priv->block_size),
+             (unsigned int)(page_addr % priv->block_size), status);
+    priv->prog_result = UFFS_FLASH_BAD_BLK;
+  }
+
+  return ESP_OK;
+}
+
+// Result of the page left programming, taken once
+static int spi_nand_program_result(spi_nand_priv_t *priv) {
+  spi_nand_program_wait(priv);
+
+  int ret = priv->prog_result;
+  priv->prog_result = UFFS_FLASH_NO_ERR;
+  return ret;
+}
+
+esp_err_t spi_nand_enable_quad(spi_nand_priv_t *priv, bool has_qe) {
+#ifdef CONFIG_UFFS_SPI_NAND_QUAD
+  if (has_qe) {
+    uint8_t cmd_rd[2] = {CMD_GET_FEATURE, REG_CONFIG};
+    uint8_t cfg = 0;
+
+    if (spi_nand_op(priv->spi, cmd_rd, 2, &cfg, 1) != ESP_OK)
+      return ESP_FAIL;
+
+    if (!(cfg & CFG_QE)) {
+      uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_CONFIG, cfg | CFG_QE};
+      if (spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0) != ESP_OK ||
+          spi_nand_op(priv->spi, cmd_rd, 2, &cfg, 1) != ESP_OK ||
+          !(cfg & CFG_QE)) {
+        ESP_LOGW(TAG, "Fail to set QE bit, using x1 transfers");
+        priv->quad = false;
+        return ESP_ERR_NOT_SUPPORTED;
+      }
+    }
+  }
+  priv->quad = true;
+#endif
+  return ESP_OK;
+}
+
+void spi_nand_chain_init(spi_nand_chain_t *chain, spi_device_handle_t spi) {
+  memset(chain, 0, sizeof(*chain));
+  chain->spi = spi;
+}
+
+esp_err_t spi_nand_chain_add(spi_nand_chain_t *chain, const uint8_t *cmd,
+                             size_t cmd_len, const uint8_t *tx_data,
+                             size_t tx_len, uint8_t *rx_data, size_t rx_len) {
+  return spi_nand_chain_add_ex(chain, cmd, cmd_len, tx_data, tx_len, rx_data,
+                               rx_len, 0);
+}
+
+esp_err_t spi_nand_chain_add_ex(spi_nand_chain_t *chain, const uint8_t *cmd,
+                                size_t cmd_len, const uint8_t *tx_data,
+                                size_t tx_len, uint8_t *rx_data, size_t rx_len,
+                                uint32_t data_flags) {
+  bool split_tx = tx_data && tx_len > 0;
+  bool split_rx = data_flags && rx_data && rx_len > 0;
+  int need = (split_tx || split_rx) ? 2 : 1;
+
+  if (cmd_len > sizeof(chain->cmd[0]) ||
+      chain->count + need > SPI_NAND_CHAIN_MAX) {
+    chain->err = ESP_ERR_INVALID_SIZE;
+    return chain->err;
+  }
+
+  spi_transaction_t *t = &chain->trans[chain->count];
+  memset(t, 0, need * sizeof(*t));
+  memcpy(chain->cmd[chain->count], cmd, cmd_len);
+  t->length = cmd_len * 8;
+  t->tx_buffer = chain->cmd[chain->count];
+  if (!split_rx) {
+    t->rxlength = rx_len * 8;
+    t->rx_buffer = rx_data;
+  }
+  chain->count++;
+
+  if (need == 2) {
+    // Data follows the command, CS stays low in between
+    t->flags = SPI_TRANS_CS_KEEP_ACTIVE;
+    t[1].flags = data_flags;
+    if (split_tx) {
+      t[1].length = tx_len * 8;
+      t[1].tx_buffer = tx_data;
+    } else {
+      t[1].rxlength = rx_len * 8;
+      t[1].rx_buffer = rx_data;
+    }
+    chain->count++;
+  }
+
+  return ESP_OK;
+}
+
+static void spi_nand_chain_collect(spi_nand_chain_t *chain) {
+  spi_transaction_t *done;
+  esp_err_t ret = spi_device_get_trans_result(chain->spi, &done, portMAX_DELAY);
+  if (chain->err == ESP_OK)
+    chain->err = ret;
+  chain->done++;
+}
+
+// Queue the transactions back to back without waiting for them. Polling
+// transactions can't be issued until the chain is collected.
+esp_err_t spi_nand_chain_submit(spi_nand_chain_t *chain) {
+  if (chain->err != ESP_OK || chain->queued == chain->count)
+    return chain->err;
+
+  // Hold the bus, so a CS frame split in pieces is not interleaved with
+  // transactions of other devices
+  if (!chain->acquired) {
+    chain->err = spi_device_acquire_bus(chain->spi, portMAX_DELAY);
+    if (chain->err != ESP_OK)
+      return chain->err;
+    chain->acquired = true;
+  }
+
+  while (chain->queued < chain->count) {
+    if (chain->queued - chain->done == SPI_NAND_QUEUE_DEPTH)
+      spi_nand_chain_collect(chain);
+
+    esp_err_t ret = spi_device_queue_trans(
+        chain->spi, &chain->trans[chain->queued], portMAX_DELAY);
+    if (ret != ESP_OK) {
+      chain->err = ret;
+      break;
+    }
+    chain->queued++;
+  }
+
+  return chain->err;
+}
+
+// Collect the results of all submitted transactions, then the chain is
+// empty and can be filled again.
+esp_err_t spi_nand_chain_wait(spi_nand_chain_t *chain) {
+  while (chain->done < chain->queued)
+    spi_nand_chain_collect(chain);
+
+  if (chain->acquired) {
+    spi_device_release_bus(chain->spi);
+    chain->acquired = false;
+  }
+
+  esp_err_t ret = chain->err;
+  chain->count = chain->queued = chain->done = 0;
+  chain->err = ESP_OK;
+  return ret;
+}
+
+esp_err_t spi_nand_chain_run(spi_nand_chain_t *chain) {
+  spi_nand_chain_submit(chain);
+  return spi_nand_chain_wait(chain);
+}
+
+// READ FROM CACHE (0x03 + 2 byte col addr + 1 dummy), or the x4 variant
+// (0x6B) with the data phase on 4 lines
+void spi_nand_chain_read_cache(spi_nand_priv_t *priv, spi_nand_chain_t *chain,
+                               uint16_t col, uint8_t *buf, int len) {
+  if (priv->quad) {
+    uint8_t cmd[4] = {CMD_READ_CACHE_X4, (col >> 8) & 0xFF, col & 0xFF, 0};
+    spi_nand_chain_add_ex(chain, cmd, 4, NULL, 0, buf, len,
+                          SPI_TRANS_MODE_QIO);
+  } else {
+    uint8_t cmd[4] = {CMD_READ_CACHE, (col >> 8) & 0xFF, col & 0xFF, 0};
+    spi_nand_chain_add(chain, cmd, 4, NULL, 0, buf, len);
+  }
+}
+
+// Page + spare staging buffer. NULL if it can't be allocated.
+static uint8_t *spi_nand_bounce(spi_nand_priv_t *priv) {
+  if (!priv->bounce)
+    priv->bounce =
+        heap_caps_malloc(priv->page_size + priv->spare_size, MALLOC_CAP_DMA);
+
+  return priv->bounce;
+}
+
+// Data from Col 0 and spare from Col PageSize. A whole page with spare is
+// read in one transfer through the bounce buffer, otherwise both parts are
+// queued as one chain.
+esp_err_t spi_nand_read_from_cache(spi_nand_priv_t *priv, uint8_t *data,
+                                   int data_len, uint8_t *spare,
+                                   int spare_len) {
+  spi_nand_chain_t chain;
+  uint8_t *buf = NULL;
+
+  spi_nand_chain_init(&chain, priv->spi);
+
+  if (data && data_len == (int)priv->page_size && spare && spare_len > 0 &&
+      spare_len <= (int)priv->spare_size)
+    buf = spi_nand_bounce(priv);
+
+  if (buf) {
+    spi_nand_chain_read_cache(priv, &chain, 0, buf, data_len + spare_len);
+    esp_err_t ret = spi_nand_chain_run(&chain);
+    if (ret == ESP_OK) {
+      memcpy(data, buf, data_len);
+      memcpy(spare, buf + data_len, spare_len);
+    }
+    return ret;
+  }
+
+  if (data && data_len > 0)
+    spi_nand_chain_read_cache(priv, &chain, 0, data, data_len);
+
+  if (spare && spare_len > 0) // Start of spare
+    spi_nand_chain_read_cache(priv, &chain, priv->page_size, spare, spare_len);
+
+  return spi_nand_chain_run(&chain);
+}
+
 // Geneirc implementations adapted from original uffs_spi_nand_read_page
 int uffs_spi_nand_read_page_generic(struct uffs_DeviceSt *dev, u32 block,
                                     u32 page, uint8_t *data, int data_len,
@@ -83,6 +465,9 @@ int uffs_spi_nand_read_page_generic(struct uffs_DeviceSt *dev, u32 block,
   spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
   uint32_t page_addr = block * priv->block_size + page;
 
+  if (spi_nand_program_wait(priv) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
   // 1. PAGE READ to Cache (0x13 + 3 byte addr)
   uint8_t cmd_read[4];
   cmd_read[0] = CMD_PAGE_READ;
@@ -95,7 +480,7 @@ int uffs_spi_nand_read_page_generic(struct uffs_DeviceSt *dev, u32 block,
 
   // 2. Wait for Load
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   // 3. Check ECC Status
@@ -110,103 +495,302 @@ int uffs_spi_nand_read_page_generic(struct uffs_DeviceSt *dev, u32 block,
     ecc_res = UFFS_FLASH_ECC_OK; // Corrected
   }
 
-  // 4. READ FROM CACHE (0x03 + 2 byte col addr + 1 dummy)
-  // Read Data
-  if (data && data_len > 0) {
-    // Col Addr 0
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, 0, 0, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)data_len * 8,
-                           .rx_buffer = data};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
+  // 4. READ FROM CACHE
+  if (spi_nand_read_from_cache(priv, data, data_len, spare, spare_len) !=
+      ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
-  // Read Spare
-  if (spare && spare_len > 0) {
-    // Calculate Col Addr for spare
-    uint16_t col = priv->page_size; // Start of spare
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, (col >> 8) & 0xFF, col & 0xFF, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)spare_len * 8,
-                           .rx_buffer = spare};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
+  return ecc_res;
+}
+
+// Read part of the spare only: Cache Read from Col PageSize + offs, so a tag
+// or a bad block status byte doesn't pull the whole spare over the bus.
+int uffs_spi_nand_read_page_spare_generic(struct uffs_DeviceSt *dev,
+                                          u32 block, u32 page, int offs,
+                                          uint8_t *spare, int len) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  uint32_t page_addr = block * priv->block_size + page;
+
+  if (offs < 0 || len <= 0 || offs + len > (int)priv->spare_size)
+    return UFFS_FLASH_IO_ERR;
+
+  if (spi_nand_program_wait(priv) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
+  // 1. PAGE READ to Cache
+  uint8_t cmd_read[4];
+  cmd_read[0] = CMD_PAGE_READ;
+  cmd_read[1] = (page_addr >> 16) & 0xFF;
+  cmd_read[2] = (page_addr >> 8) & 0xFF;
+  cmd_read[3] = page_addr & 0xFF;
+
+  if (spi_nand_op(priv->spi, cmd_read, 4, NULL, 0) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
+  // 2. Wait for Load
+  uint8_t status = 0;
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
+  // 3. Check ECC Status
+  int ecc_res = UFFS_FLASH_NO_ERR;
+  int ecc_stat = (status & SR_ECC_MASK) >> 4;
+
+  if (ecc_stat == 2) { // Uncorrectable
+    ESP_LOGE(TAG, "ECC Uncorrectable Error at Blk %u Pg %u",
+             (unsigned int)block, (unsigned int)page);
+    return UFFS_FLASH_ECC_FAIL;
+  } else if (ecc_stat == 1 || ecc_stat == 3) {
+    ecc_res = UFFS_FLASH_ECC_OK; // Corrected
   }
 
+  // 4. READ FROM CACHE of the requested spare bytes
+  spi_nand_chain_t chain;
+  spi_nand_chain_init(&chain, priv->spi);
+  spi_nand_chain_read_cache(priv, &chain, priv->page_size + offs, spare, len);
+  if (spi_nand_chain_run(&chain) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
   return ecc_res;
 }
 
-int uffs_spi_nand_write_page_generic(struct uffs_DeviceSt *dev, u32 block,
-                                     u32 page, const uint8_t *data,
-                                     int data_len, const uint8_t *spare,
-                                     int spare_len) {
+// Read consecutive pages with cache read sequential (0x31): the next page is
+// loaded from array while the current one is read out of the cache. Only for
+// chips that support it, 0x3F ends the sequence on the last page.
+int uffs_spi_nand_read_page_seq_generic(struct uffs_DeviceSt *dev, u32 block,
+                                        u32 page, int count, uint8_t **data,
+                                        int data_len, int *ret) {
   spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
   uint32_t page_addr = block * priv->block_size + page;
+  uint8_t status = 0;
 
-  // 1. Write Enable
-  if (spi_nand_write_enable(priv->spi) != ESP_OK)
+  if (spi_nand_program_wait(priv) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
-  // 2. Program Load (0x02 + 2 byte col addr) - Data
+  // 1. PAGE READ to Cache of the first page
+  uint8_t cmd_read[4];
+  cmd_read[0] = CMD_PAGE_READ;
+  cmd_read[1] = (page_addr >> 16) & 0xFF;
+  cmd_read[2] = (page_addr >> 8) & 0xFF;
+  cmd_read[3] = page_addr & 0xFF;
 
-  // Load Data (Col 0)
-  if (data && data_len > 0) {
-    uint8_t cmd[3] = {CMD_PROGRAM_LOAD, 0, 0};
+  if (spi_nand_op(priv->spi, cmd_read, 4, NULL, 0) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
-    spi_transaction_t t1 = {
-        .length = 24, .tx_buffer = cmd, .flags = SPI_TRANS_CS_KEEP_ACTIVE};
-    if (spi_device_transmit(priv->spi, &t1) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
-    spi_transaction_t t2 = {
-        .length = (size_t)data_len * 8,
-        .tx_buffer = data,
-    };
-    if (spi_device_transmit(priv->spi, &t2) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
+  // The cache read of page i - 1 and the command moving page i to cache are
+  // queued as one chain (a single page is in the cache already)
+  spi_nand_chain_t chain;
+  spi_nand_chain_init(&chain, priv->spi);
+
+  for (int i = 0; i < count; i++) {
+    // 2. READ FROM CACHE of previous page, then move page i to cache and
+    // start loading page i + 1
+    if (i > 0)
+      spi_nand_chain_read_cache(priv, &chain, 0, data[i - 1], data_len);
+    if (count > 1) {
+      uint8_t cmd = (i < count - 1) ? CMD_READ_CACHE_SEQ : CMD_READ_CACHE_END;
+      spi_nand_chain_add(&chain, &cmd, 1, NULL, 0, NULL, 0);
+      if (spi_nand_chain_run(&chain) != ESP_OK)
+        return UFFS_FLASH_IO_ERR;
+      if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
+        return UFFS_FLASH_IO_ERR;
+    }
 
-  // Load Spare (Col PageSize)
-  if (spare && spare_len > 0) {
-    uint8_t cmd_code;
-    if (data && data_len > 0) {
-      cmd_code = 0x84; // Random Data Input (Modify existing buffer)
+    // 3. Check ECC Status of the page in cache
+    int ecc_stat = (status & SR_ECC_MASK) >> 4;
+    if (ecc_stat == 2) { // Uncorrectable, keep reading the sequence
+      ESP_LOGE(TAG, "ECC Uncorrectable Error at Blk %u Pg %u",
+               (unsigned int)block, (unsigned int)(page + i));
+      ret[i] = UFFS_FLASH_ECC_FAIL;
+    } else if (ecc_stat == 1 || ecc_stat == 3) {
+      ret[i] = UFFS_FLASH_ECC_OK; // Corrected
     } else {
-      cmd_code = 0x02; // Program Load (Reset buffer)
+      ret[i] = UFFS_FLASH_NO_ERR;
+    }
+  }
+
+  // 4. READ FROM CACHE of the last page
+  spi_nand_chain_read_cache(priv, &chain, 0, data[count - 1], data_len);
+  if (spi_nand_chain_run(&chain) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
+  return UFFS_FLASH_NO_ERR;
+}
+
+// Read spare (and first data bytes) of several pages for block scanning.
+// Cache reads of the previous page and PAGE READ of the next page are
+// queued as one batch, so only the busy wait separates two pages.
+int uffs_spi_nand_scan_block_meta_generic(struct uffs_DeviceSt *dev, u32 block,
+                                          const u32 *pages, int count,
+                                          uint8_t *data, int data_len,
+                                          uint8_t *spare, int spare_len) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  spi_nand_chain_t chain;
+  uint8_t cmd_read[4];
+  int ecc_res = UFFS_FLASH_NO_ERR;
+
+  if (spi_nand_program_wait(priv) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
+  spi_nand_chain_init(&chain, priv->spi);
+
+  for (int i = 0; i <= count; i++) {
+    // 1. READ FROM CACHE of previous page
+    if (i > 0) {
+      if (data && data_len > 0)
+        spi_nand_chain_read_cache(priv, &chain, 0, data + (i - 1) * data_len,
+                                  data_len);
+      spi_nand_chain_read_cache(priv, &chain, priv->page_size,
+                                spare + (i - 1) * spare_len, spare_len);
     }
 
-    uint16_t col = priv->page_size;
-    uint8_t cmd[3] = {cmd_code, (col >> 8) & 0xFF, col & 0xFF};
+    // 2. PAGE READ to Cache of next page
+    if (i < count) {
+      uint32_t page_addr = block * priv->block_size + pages[i];
+      cmd_read[0] = CMD_PAGE_READ;
+      cmd_read[1] = (page_addr >> 16) & 0xFF;
+      cmd_read[2] = (page_addr >> 8) & 0xFF;
+      cmd_read[3] = page_addr & 0xFF;
+      spi_nand_chain_add(&chain, cmd_read, 4, NULL, 0, NULL, 0);
+    }
 
-    spi_transaction_t t1 = {
-        .length = 24, .tx_buffer = cmd, .flags = SPI_TRANS_CS_KEEP_ACTIVE};
-    if (spi_device_transmit(priv->spi, &t1) != ESP_OK)
+    if (spi_nand_chain_run(&chain) != ESP_OK)
       return UFFS_FLASH_IO_ERR;
 
-    spi_transaction_t t2 = {
-        .length = (size_t)spare_len * 8,
-        .tx_buffer = spare,
-    };
-    if (spi_device_transmit(priv->spi, &t2) != ESP_OK)
+    if (i == count)
+      break;
+
+    // 3. Wait for Load and check ECC Status
+    uint8_t status = 0;
+    if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
       return UFFS_FLASH_IO_ERR;
+
+    int ecc_stat = (status & SR_ECC_MASK) >> 4;
+    if (ecc_stat == 2) { // Uncorrectable
+      ESP_LOGE(TAG, "ECC Uncorrectable Error at Blk %u Pg %u",
+               (unsigned int)block, (unsigned int)pages[i]);
+      return UFFS_FLASH_ECC_FAIL;
+    } else if (ecc_stat == 1 || ecc_stat == 3) {
+      ecc_res = UFFS_FLASH_ECC_OK; // Corrected
+    }
+  }
+
+  return ecc_res;
+}
+
+// Add one piece of the page to be loaded to the cache at column col. The
+// first piece uses Program Load, which also resets the rest of the cache to
+// 0xFF. The x4 variants (0x32/0x34) send the data on 4 lines.
+static void spi_nand_program_load(spi_nand_priv_t *priv,
+                                  spi_nand_chain_t *chain, bool first,
+                                  uint16_t col, const uint8_t *buf, int len) {
+  uint8_t cmd_code;
+
+  if (priv->quad)
+    cmd_code = first ? CMD_PROGRAM_LOAD_X4 : CMD_PROGRAM_LOAD_RANDOM_X4;
+  else
+    cmd_code = first ? CMD_PROGRAM_LOAD : CMD_PROGRAM_LOAD_RANDOM;
+
+  uint8_t cmd[3] = {cmd_code, (col >> 8) & 0xFF, col & 0xFF};
+  spi_nand_chain_add_ex(chain, cmd, 3, buf, len, NULL, 0,
+                        priv->quad ? SPI_TRANS_MODE_QIO : 0);
+}
+
+// Program a page from up to three pieces: header and data (Col 0) and spare
+// (Col PageSize). Write enable, loads and execute are queued as one chain.
+static int spi_nand_program_page(struct uffs_DeviceSt *dev, u32 block,
+                                 u32 page, const uint8_t *header,
+                                 int header_len, const uint8_t *data,
+                                 int data_len, const uint8_t *spare,
+                                 int spare_len) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+  uint32_t page_addr = block * priv->block_size + page;
+  spi_nand_chain_t chain;
+  bool first = true;
+
+  spi_nand_chain_init(&chain, priv->spi);
+
+  // 1. Write Enable. With the previous page still programming, it goes after
+  // the loads: WEL is cleared when the program ends.
+  uint8_t cmd_we = CMD_WRITE_ENABLE;
+  bool busy = priv->prog_pending;
+  if (!busy)
+    spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0);
+
+  if (!header)
+    header_len = 0;
+  if (!data)
+    data_len = 0;
+
+  // A whole page with spare is staged in the bounce buffer and loaded at
+  // once, the DMA capable buffer is the data phase of the load
+  uint8_t *buf = NULL;
+  if (header_len + data_len == (int)priv->page_size && spare &&
+      spare_len > 0 && spare_len <= (int)priv->spare_size)
+    buf = spi_nand_bounce(priv);
+
+  // 2. Program Load (0x02/0x32 + 2 byte col addr), then Random Data Input
+  // (0x84/0x34)
+  if (buf) {
+    int len = priv->page_size + spare_len;
+    if (header_len > 0)
+      memcpy(buf, header, header_len);
+    if (data_len > 0)
+      memcpy(buf + header_len, data, data_len);
+    memcpy(buf + priv->page_size, spare, spare_len);
+
+    spi_nand_program_load(priv, &chain, true, 0, buf, len);
+  } else {
+    if (header_len > 0) {
+      spi_nand_program_load(priv, &chain, first, 0, header, header_len);
+      first = false;
+    }
+
+    if (data_len > 0) {
+      spi_nand_program_load(priv, &chain, first, header_len, data, data_len);
+      first = false;
+    }
+
+    if (spare && spare_len > 0)
+      spi_nand_program_load(priv, &chain, first, priv->page_size, spare,
+                            spare_len);
   }
 
+  // The cache takes this page while the previous one is programmed, then
+  // the previous result decides whether to go on
+  esp_err_t err = busy ? spi_nand_chain_run(&chain) : ESP_OK;
+  int prev = spi_nand_program_result(priv);
+  if (err != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+  if (prev != UFFS_FLASH_NO_ERR)
+    return prev;
+  if (busy)
+    spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0);
+
   // 3. Program Execute (0x10 + 3 byte Addr)
   uint8_t cmd_exec[4];
   cmd_exec[0] = CMD_PROGRAM_EXECUTE;
   cmd_exec[1] = (page_addr >> 16) & 0xFF;
   cmd_exec[2] = (page_addr >> 8) & 0xFF;
   cmd_exec[3] = page_addr & 0xFF;
+  spi_nand_chain_add(&chain, cmd_exec, 4, NULL, 0, NULL, 0);
 
-  if (spi_nand_op(priv->spi, cmd_exec, 4, NULL, 0) != ESP_OK)
+  if (spi_nand_chain_run(&chain) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
+  // Cache program: return now, the next command waits for the page
+  if (priv->prog_pipeline) {
+    priv->prog_pending = true;
+    priv->prog_page_addr = page_addr;
+    return UFFS_FLASH_NO_ERR;
+  }
+
   // 4. Wait for Finish
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_PROG, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   if (status & SR_P_FAIL) {
@@ -218,27 +802,52 @@ int uffs_spi_nand_write_page_generic(struct uffs_DeviceSt *dev, u32 block,
   return UFFS_FLASH_NO_ERR;
 }
 
+int uffs_spi_nand_write_page_generic(struct uffs_DeviceSt *dev, u32 block,
+                                     u32 page, const uint8_t *data,
+                                     int data_len, const uint8_t *spare,
+                                     int spare_len) {
+  return spi_nand_program_page(dev, block, page, NULL, 0, data, data_len,
+                               spare, spare_len);
+}
+
+// Header and data are loaded to the cache one after another, so the page
+// data can be programmed straight from the caller's buffer.
+int uffs_spi_nand_write_page_direct_generic(
+    struct uffs_DeviceSt *dev, u32 block, u32 page, const uint8_t *header,
+    int header_len, const uint8_t *data, int data_len, const uint8_t *spare,
+    int spare_len) {
+  return spi_nand_program_page(dev, block, page, header, header_len, data,
+                               data_len, spare, spare_len);
+}
+
 int uffs_spi_nand_erase_block_generic(struct uffs_DeviceSt *dev, u32 block) {
   spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
   uint32_t page_addr = block * priv->block_size; // Row address is page index
 
-  // 1. Write Enable
-  if (spi_nand_write_enable(priv->spi) != ESP_OK)
+  if (spi_nand_program_wait(priv) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
+  spi_nand_chain_t chain;
+  spi_nand_chain_init(&chain, priv->spi);
+
+  // 1. Write Enable
+  uint8_t cmd_we = CMD_WRITE_ENABLE;
+  spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0);
+
   // 2. Block Erase (0xD8 + 3 byte Addr)
   uint8_t cmd_erase[4];
   cmd_erase[0] = CMD_BLOCK_ERASE;
   cmd_erase[1] = (page_addr >> 16) & 0xFF;
   cmd_erase[2] = (page_addr >> 8) & 0xFF;
   cmd_erase[3] = page_addr & 0xFF;
+  spi_nand_chain_add(&chain, cmd_erase, 4, NULL, 0, NULL, 0);
 
-  if (spi_nand_op(priv->spi, cmd_erase, 4, NULL, 0) != ESP_OK)
+  if (spi_nand_chain_run(&chain) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   // 3. Wait
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_ERASE, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   if (status & SR_E_FAIL) {
@@ -248,3 +857,13 @@ int uffs_spi_nand_erase_block_generic(struct uffs_DeviceSt *dev, u32 block) {
 
   return UFFS_FLASH_NO_ERR;
 }
+
+int uffs_spi_nand_write_pipeline_generic(struct uffs_DeviceSt *dev, UBOOL on) {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
+
+  priv->prog_pipeline = on;
+  if (on)
+    return UFFS_FLASH_NO_ERR;
+
+  return spi_nand_program_result(priv);
+}
@@ -18,7 +18,16 @@
 
 #include "driver/spi_master.h"
 #include "esp_err.h"
+#include "esp_spi_nand.h"
+#include "sdkconfig.h"
 #include "uffs/uffs_device.h"
+#include <stdbool.h>
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,15 +41,22 @@ extern "C" {
 #define CMD_PAGE_READ 0x13       // Read page to cache
 #define CMD_READ_CACHE 0x03      // Read from cache
 #define CMD_READ_CACHE_FAST 0x0B // Read from cache fast
+#define CMD_READ_CACHE_X4 0x6B   // Read from cache, data on 4 lines
+#define CMD_READ_CACHE_SEQ 0x31  // Page to cache, load next page (sequential)
+#define CMD_READ_CACHE_END 0x3F  // Page to cache, end of sequential read
 #define CMD_WRITE_ENABLE 0x06
 #define CMD_WRITE_DISABLE 0x04
 #define CMD_PROGRAM_LOAD 0x02    // Load data to cache
+#define CMD_PROGRAM_LOAD_RANDOM 0x84 // Load data, keep the rest of cache
+#define CMD_PROGRAM_LOAD_X4 0x32 // Load data to cache, data on 4 lines
+#define CMD_PROGRAM_LOAD_RANDOM_X4 0x34 // Random load, data on 4 lines
 #define CMD_PROGRAM_EXECUTE 0x10 // Program cache to page
 #define CMD_BLOCK_ERASE 0xD8
 
 // Status Register Addresses
 #define REG_STATUS 0xC0
 #define REG_BLOCK_LOCK 0xA0
+#define REG_CONFIG 0xB0 // Configuration (OTP, ECC, QE)
 
 // Status Register Bits
 #define SR_BUSY (1 << 0)   // OIP (Operation In Progress)
@@ -49,9 +65,27 @@ extern "C" {
 #define SR_P_FAIL (1 << 3) // Program Fail
 #define SR_ECC_MASK 0x30   // ECC Status Mask (varies slightly)
 
+// Configuration Register Bits
+#define CFG_QE (1 << 0) // Quad Enable, on chips that have it
+
 // Timeout configuration
 #define NAND_TIMEOUT_MS 500
 
+// Adaptive busy wait: the status is polled without sleeping from the
+// typical operation time minus this window until the typical time plus the
+// window, sleeps shorter than SPI_NAND_TIMER_MIN_US are busy delays.
+#define SPI_NAND_POLL_WINDOW_US 20
+#define SPI_NAND_TIMER_MIN_US 50
+
+// Bad block table copies, kept in the first blocks of the chip
+#define SPI_NAND_BBT_BLOCKS 2
+
+// How a driver waits for the chip to become ready
+typedef enum {
+  SPI_NAND_WAIT_MODE_TICK,     // Poll, sleep one RTOS tick while busy
+  SPI_NAND_WAIT_MODE_ADAPTIVE, // Sleep through the typical time, then poll
+} spi_nand_wait_mode_t;
+
 // Internal Private Data Structure
 typedef struct {
   spi_device_handle_t spi;
@@ -59,8 +93,61 @@ typedef struct {
   uint32_t spare_size;
   uint32_t block_size; // pages per block
   uint32_t total_blocks;
+  uint8_t *bbt;         // Bad block bitmap, 1 bit per block
+  uint32_t bbt_version; // Version of the table on flash
+  uint8_t bbt_copies;   // Table blocks still usable, 1 bit per copy
+  bool quad;            // Cache read/program load data on 4 lines
+  uint8_t *bounce;      // Page + spare, DMA capable, allocated on first
+                        // use, see spi_nand_bounce()
+  bool prog_pipeline;   // Cache program: pages are left programming
+  bool prog_pending;    // A page is programming, see spi_nand_program_wait()
+  int prog_result;      // Result of the page left programming (UFFS_FLASH_*)
+  uint32_t prog_page_addr;
+  spi_nand_wait_mode_t wait_mode;
+  uint32_t wait_typ_us[SPI_NAND_WAIT_OP_MAX]; // Typical tR, tPROG, tBERS
+  spi_nand_wait_stats_t wait_stats[SPI_NAND_WAIT_OP_MAX];
+#ifndef CONFIG_IDF_TARGET_LINUX
+  esp_timer_handle_t wait_timer; // Microsecond sleep, created on first use
+  SemaphoreHandle_t wait_sem;    // Given by the timer
+#endif
 } spi_nand_priv_t;
 
+// Command chain: transactions queued back to back and collected at once, the
+// CPU is free between spi_nand_chain_submit() and spi_nand_chain_wait().
+// The SPI device queue_size must be at least SPI_NAND_QUEUE_DEPTH.
+#define SPI_NAND_CHAIN_MAX 8
+#define SPI_NAND_QUEUE_DEPTH 4
+
+typedef struct {
+  spi_device_handle_t spi;
+  spi_transaction_t trans[SPI_NAND_CHAIN_MAX];
+  uint8_t cmd[SPI_NAND_CHAIN_MAX][4]; // Command bytes of each transaction
+  int count;                          // Transactions in the chain
+  int queued;                         // Handed to the SPI driver
+  int done;                           // Results collected
+  bool acquired;                      // Bus held until the chain is collected
+  esp_err_t err;
+} spi_nand_chain_t;
+
+void spi_nand_chain_init(spi_nand_chain_t *chain, spi_device_handle_t spi);
+
+// Add a command (up to 4 bytes) reading rx_len bytes back, followed by
+// tx_len bytes of data in the same CS frame if tx_data is given
+esp_err_t spi_nand_chain_add(spi_nand_chain_t *chain, const uint8_t *cmd,
+                             size_t cmd_len, const uint8_t *tx_data,
+                             size_t tx_len, uint8_t *rx_data, size_t rx_len);
+
+// Same as spi_nand_chain_add, but the data phase is a separate transaction in the same CS frame
+// using the given transfer mode flags (e.g. SPI_TRANS_MODE_QIO)
+esp_err_t spi_nand_chain_add_ex(spi_nand_chain_t *chain, const uint8_t *cmd,
+                                size_t cmd_len, const uint8_t *tx_data,
+                                size_t tx_len, uint8_t *rx_data, size_t rx_len,
+                                uint32_t data_flags);
+
+esp_err_t spi_nand_chain_submit(spi_nand_chain_t *chain);
+esp_err_t spi_nand_chain_wait(spi_nand_chain_t *chain);
+esp_err_t spi_nand_chain_run(spi_nand_chain_t *chain);
+
 // Common Helpers
 esp_err_t spi_nand_op(spi_device_handle_t spi, const uint8_t *tx_data,
                       size_t tx_len, uint8_t *rx_data, size_t rx_len);
@@ -68,8 +155,35 @@ esp_err_t spi_nand_op(spi_device_handle_t spi, const uint8_t *tx_data,
 esp_err_t spi_nand_wait_busy(spi_device_handle_t spi, uint32_t timeout_ms,
                              uint8_t *status_out);
 
+// Set the wait strategy and typical operation times of the chip
+void spi_nand_wait_init(spi_nand_priv_t *priv, spi_nand_wait_mode_t mode,
+                        uint32_t t_read_us, uint32_t t_prog_us,
+                        uint32_t t_erase_us);
+
+// Wait for the operation in progress, timing it in the stats of op
+esp_err_t spi_nand_wait(spi_nand_priv_t *priv, spi_nand_wait_op_t op,
+                        uint8_t *status_out);
+
+void spi_nand_wait_release(spi_nand_priv_t *priv);
+
 esp_err_t spi_nand_write_enable(spi_device_handle_t spi);
 
+// Wait for a page left programming by the cache program, its result is kept
+// for the next page write. Called before any other command to the chip.
+esp_err_t spi_nand_program_wait(spi_nand_priv_t *priv);
+
+// Use x4 data transfers (CONFIG_UFFS_SPI_NAND_QUAD), setting the QE bit
+// first on chips that have one. Called from InitFlash.
+esp_err_t spi_nand_enable_quad(spi_nand_priv_t *priv, bool has_qe);
+
+// Add a cache read at column col to the chain, x4 if enabled
+void spi_nand_chain_read_cache(spi_nand_priv_t *priv, spi_nand_chain_t *chain,
+                               uint16_t col, uint8_t *buf, int len);
+
+esp_err_t spi_nand_read_from_cache(spi_nand_priv_t *priv, uint8_t *data,
+                                   int data_len, uint8_t *spare,
+                                   int spare_len);
+
 // Common UFFS Hooks (Generic implementation)
 int uffs_spi_nand_read_page_generic(struct uffs_DeviceSt *dev, u32 block,
                                     u32 page, uint8_t *data, int data_len,
@@ -81,8 +195,36 @@ int uffs_spi_nand_write_page_generic(struct uffs_DeviceSt *dev, u32 block,
                                      int data_len, const uint8_t *spare,
                                      int spare_len);
 
+int uffs_spi_nand_write_page_direct_generic(
+    struct uffs_DeviceSt *dev, u32 block, u32 page, const uint8_t *header,
+    int header_len, const uint8_t *data, int data_len, const uint8_t *spare,
+    int spare_len);
+
+int uffs_spi_nand_read_page_seq_generic(struct uffs_DeviceSt *dev, u32 block,
+                                        u32 page, int count, uint8_t **data,
+                                        int data_len, int *ret);
+
+int uffs_spi_nand_read_page_spare_generic(struct uffs_DeviceSt *dev,
+                                          u32 block, u32 page, int offs,
+                                          uint8_t *spare, int len);
+
 int uffs_spi_nand_erase_block_generic(struct uffs_DeviceSt *dev, u32 block);
 
+// Cache program, for chips that take a program load while the previous page
+// is programmed
+int uffs_spi_nand_write_pipeline_generic(struct uffs_DeviceSt *dev, UBOOL on);
+
+int uffs_spi_nand_scan_block_meta_generic(struct uffs_DeviceSt *dev, u32 block,
+                                          const u32 *pages, int count,
+                                          uint8_t *data, int data_len,
+                                          uint8_t *spare, int spare_len);
+
+// On-flash bad block table (CONFIG_UFFS_SPI_NAND_BBT)
+int spi_nand_bbt_load(struct uffs_DeviceSt *dev);
+void spi_nand_bbt_release(struct uffs_DeviceSt *dev);
+int uffs_spi_nand_bbt_is_bad(struct uffs_DeviceSt *dev, u32 block);
+int uffs_spi_nand_bbt_mark_bad(struct uffs_DeviceSt *dev, u32 block);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,9 @@ static int uffs_gd_init_flash(struct uffs_DeviceSt *dev) {
   uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_BLOCK_LOCK, status_reg_1};
   spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0);
 
+  // Quad Enable bit in the configuration register
+  spi_nand_enable_quad(priv, true);
+
   return 0;
 }
 
@@ -60,7 +63,7 @@ static int uffs_gd_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
 
   // 2. Wait for Load
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   // 3. Check ECC Status (GD Specific)
@@ -77,28 +80,9 @@ static int uffs_gd_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
   }
 
   // 4. READ FROM CACHE
-  // Read Data
-  if (data && data_len > 0) {
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, 0, 0, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)data_len * 8,
-                           .rx_buffer = data};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
-
-  // Read Spare
-  if (spare && spare_len > 0) {
-    uint16_t col = priv->page_size;
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, (col >> 8) & 0xFF, col & 0xFF, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)spare_len * 8,
-                           .rx_buffer = spare};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
+  if (spi_nand_read_from_cache(priv, data, data_len, spare, spare_len) !=
+      ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
   return ecc_res;
 }
@@ -139,6 +123,8 @@ esp_err_t uffs_spi_nand_init_gd(struct uffs_DeviceSt *dev,
   priv->spare_size = 64;
   priv->block_size = 64;
   priv->total_blocks = 128; // Reduced for Mock Test (1024->128)
+  // Typical GD5F1GQ4: tR 80 us, tPROG 400 us, tBERS 3 ms
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 80, 400, 3000);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -153,6 +139,7 @@ esp_err_t uffs_spi_nand_init_gd(struct uffs_DeviceSt *dev,
   ops->ReleaseFlash = NULL;          // Optional
   ops->ReadPage = uffs_gd_read_page; // Custom ECC check
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   ops->WritePageWithLayout = uffs_gd_write_page_with_layout;
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
 
@@ -54,6 +54,9 @@ static int uffs_micron_init_flash(struct uffs_DeviceSt *dev) {
   uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_BLOCK_LOCK, status_reg_1};
   spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0);
 
+  // x4 instructions always available, no QE bit
+  spi_nand_enable_quad(priv, false);
+
   return 0;
 }
 
@@ -63,6 +66,9 @@ static int uffs_micron_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
   spi_nand_priv_t *priv = (spi_nand_priv_t *)dev->attr->_private;
   uint32_t page_addr = block * priv->block_size + page;
 
+  if (spi_nand_program_wait(priv) != ESP_OK)
+    return UFFS_FLASH_IO_ERR;
+
   // 1. PAGE READ to Cache
   uint8_t cmd_read[4];
   cmd_read[0] = CMD_PAGE_READ;
@@ -75,7 +81,7 @@ static int uffs_micron_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
 
   // 2. Wait
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   // 3. Check ECC
@@ -98,25 +104,9 @@ static int uffs_micron_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
   }
 
   // 4. READ FROM CACHE
-  if (data && data_len > 0) {
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, 0, 0, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)data_len * 8,
-                           .rx_buffer = data};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
-  if (spare && spare_len > 0) {
-    uint16_t col = priv->page_size;
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, (col >> 8) & 0xFF, col & 0xFF, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)spare_len * 8,
-                           .rx_buffer = spare};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
+  if (spi_nand_read_from_cache(priv, data, data_len, spare, spare_len) !=
+      ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
   return ecc_res;
 }
@@ -153,6 +143,8 @@ esp_err_t uffs_spi_nand_init_micron(struct uffs_DeviceSt *dev,
   priv->spare_size = 64;
   priv->block_size = 64;
   priv->total_blocks = 128; // Reduced for Mock Test (1024->128)
+  // Typical MT29F1G01: tR 50 us (ECC on), tPROG 220 us, tBERS 2 ms
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 50, 220, 2000);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -165,9 +157,17 @@ esp_err_t uffs_spi_nand_init_micron(struct uffs_DeviceSt *dev,
 
   ops->InitFlash = uffs_micron_init_flash;
   ops->ReadPage = uffs_micron_read_page;
+  ops->ReadPageSeq = uffs_spi_nand_read_page_seq_generic; // 0x31/0x3F, ECC
+                                                         // 0-3 as above
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   ops->WritePageWithLayout = uffs_micron_write_page_with_layout;
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
+  ops->ReadPageSpare = uffs_spi_nand_read_page_spare_generic; // ECC as above
+#ifdef CONFIG_UFFS_SPI_NAND_CACHE_PROGRAM
+  // Program load is taken while the previous page is programmed
+  ops->WritePipeline = uffs_spi_nand_write_pipeline_generic;
+#endif
 
   dev->attr = attr;
   dev->ops = ops;
@@ -34,6 +34,9 @@ static int uffs_winbond_init_flash(struct uffs_DeviceSt *dev) {
   uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_BLOCK_LOCK, status_reg_1};
   spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0);
 
+  // x4 instructions always available, no QE bit
+  spi_nand_enable_quad(priv, false);
+
   return 0;
 }
 
@@ -89,6 +92,8 @@ esp_err_t uffs_spi_nand_init_winbond(struct uffs_DeviceSt *dev,
 #else
   priv->total_blocks = 1024; // Standard W25N01GV size
 #endif
+  // Typical W25N01GV: tRD 50 us (ECC on), tPP 250 us, tBE 2 ms
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 50, 250, 2000);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -103,8 +108,11 @@ esp_err_t uffs_spi_nand_init_winbond(struct uffs_DeviceSt *dev,
   ops->ReleaseFlash = uffs_winbond_release_flash;
   ops->ReadPage = uffs_spi_nand_read_page_generic;
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   ops->WritePageWithLayout = uffs_winbond_write_page_with_layout;
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
+  ops->ScanBlockMeta = uffs_spi_nand_scan_block_meta_generic;
+  ops->ReadPageSpare = uffs_spi_nand_read_page_spare_generic;
 
   dev->attr = attr;
   dev->ops = ops;
@@ -46,6 +46,9 @@ static int uffs_xtx_init_flash(struct uffs_DeviceSt *dev) {
   uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_BLOCK_LOCK, status_reg_1};
   spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0);
 
+  // Quad Enable bit in the configuration register
+  spi_nand_enable_quad(priv, true);
+
   return 0;
 }
 
@@ -82,6 +85,8 @@ esp_err_t uffs_spi_nand_init_xtx(struct uffs_DeviceSt *dev,
   priv->spare_size = 64;
   priv->block_size = 64;
   priv->total_blocks = 128; // Reduced for Mock Test (1024->128)
+  // Typical XT26G: tR 60 us, tPROG 300 us, tBERS 3 ms
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 60, 300, 3000);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -95,8 +100,11 @@ esp_err_t uffs_spi_nand_init_xtx(struct uffs_DeviceSt *dev,
   ops->InitFlash = uffs_xtx_init_flash;
   ops->ReadPage = uffs_spi_nand_read_page_generic;
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   ops->WritePageWithLayout = uffs_xtx_write_page_with_layout;
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
+  ops->ScanBlockMeta = uffs_spi_nand_scan_block_meta_generic;
+  ops->ReadPageSpare = uffs_spi_nand_read_page_spare_generic;
 
   dev->attr = attr;
   dev->ops = ops;
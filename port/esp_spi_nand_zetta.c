@@ -53,6 +53,9 @@ static int uffs_zetta_init_flash(struct uffs_DeviceSt *dev) {
   uint8_t cmd_wr[3] = {CMD_SET_FEATURE, REG_BLOCK_LOCK, status_reg_1};
   spi_nand_op(priv->spi, cmd_wr, 3, NULL, 0);
 
+  // Quad Enable bit in the configuration register
+  spi_nand_enable_quad(priv, true);
+
   return 0;
 }
 
@@ -73,7 +76,7 @@ static int uffs_zetta_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
     return UFFS_FLASH_IO_ERR;
 
   uint8_t status = 0;
-  if (spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS, &status) != ESP_OK)
+  if (spi_nand_wait(priv, SPI_NAND_WAIT_READ, &status) != ESP_OK)
     return UFFS_FLASH_IO_ERR;
 
   // Zetta/GD Style Check (Mask 0x70)
@@ -88,25 +91,9 @@ static int uffs_zetta_read_page(struct uffs_DeviceSt *dev, u32 block, u32 page,
     ecc_res = UFFS_FLASH_ECC_OK;
   }
 
-  if (data && data_len > 0) {
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, 0, 0, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)data_len * 8,
-                           .rx_buffer = data};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
-  if (spare && spare_len > 0) {
-    uint16_t col = priv->page_size;
-    uint8_t cmd_cache[4] = {CMD_READ_CACHE, (col >> 8) & 0xFF, col & 0xFF, 0};
-    spi_transaction_t t = {.length = 32,
-                           .tx_buffer = cmd_cache,
-                           .rxlength = (size_t)spare_len * 8,
-                           .rx_buffer = spare};
-    if (spi_device_transmit(priv->spi, &t) != ESP_OK)
-      return UFFS_FLASH_IO_ERR;
-  }
+  if (spi_nand_read_from_cache(priv, data, data_len, spare, spare_len) !=
+      ESP_OK)
+    return UFFS_FLASH_IO_ERR;
 
   return ecc_res;
 }
@@ -145,6 +132,8 @@ esp_err_t uffs_spi_nand_init_zetta(struct uffs_DeviceSt *dev,
   priv->spare_size = 64;
   priv->block_size = 64;
   priv->total_blocks = 128; // Reduced for Mock Test (1024->128)
+  // Typical ZD35: tR 60 us, tPROG 400 us, tBERS 3 ms
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 60, 400, 3000);
 
   attr->page_data_size = priv->page_size;
   attr->pages_per_block = priv->block_size;
@@ -158,6 +147,7 @@ esp_err_t uffs_spi_nand_init_zetta(struct uffs_DeviceSt *dev,
   ops->InitFlash = uffs_zetta_init_flash;
   ops->ReadPage = uffs_zetta_read_page;
   ops->WritePage = uffs_spi_nand_write_page_generic;
+  ops->WritePageDirect = uffs_spi_nand_write_page_direct_generic;
   ops->WritePageWithLayout = uffs_zetta_write_page_with_layout;
   ops->EraseBlock = uffs_spi_nand_erase_block_generic;
 
@@ -229,17 +229,15 @@ retry:
 
     switch (region) {
     case SEARCH_REGION_DIR:
-      bad->u.dir.block = good->u.list.block;
       type = UFFS_TYPE_DIR;
       break;
     case SEARCH_REGION_FILE:
-      bad->u.file.block = good->u.list.block;
       type = UFFS_TYPE_FILE;
       break;
     case SEARCH_REGION_DATA:
-      bad->u.data.block = good->u.list.block;
       type = UFFS_TYPE_DATA;
     }
+    uffs_TreeSetNodeBlock(dev, type, bad, good->u.list.block);
 
     // from now, the 'bad' is actually good block :)))
     uffs_Perror(UFFS_MSG_NOISY,
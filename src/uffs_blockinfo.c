@@ -48,6 +48,9 @@
 
 #define UFFS_CLONE_BLOCK_INFO_NEXT ((uffs_BlockInfo *)(-2))
 
+#define BC_HASH_EMPTY 0xffff
+#define BC_HASH_SIZE(n) ((n) * 2)
+
 /**
  * \brief before block info cache is enable,
  *			this function should be called to initialize it
@@ -66,17 +69,24 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 	uffs_BlockInfo *work = NULL;
 	int size, i, j;
 
-	if (dev->bc.head != NULL) {
+	if (dev->bc.infos != NULL) {
 		uffs_Perror(UFFS_MSG_NOISY,
 					"block info cache has been inited already, "
 					"now release it first.");
 		uffs_BlockInfoReleaseCache(dev);
 	}
 
+	if (maxCachedBlocks <= 0 || maxCachedBlocks >= BC_HASH_EMPTY) {
+		uffs_Perror(UFFS_MSG_DEAD,
+					"invalid block info cache number %d", maxCachedBlocks);
+		return U_FAIL;
+	}
+
 	size = ( 
 			sizeof(uffs_BlockInfo) +
 			sizeof(uffs_PageSpare) * dev->attr->pages_per_block
-			) * maxCachedBlocks;
+			) * maxCachedBlocks +
+			sizeof(u16) * BC_HASH_SIZE(maxCachedBlocks);
 
 	if (dev->mem.blockinfo_pool_size == 0) {
 		if (dev->mem.malloc) {
@@ -105,39 +115,35 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 	size += sizeof(uffs_BlockInfo) * maxCachedBlocks;
 
 	pageSpares = (uffs_PageSpare *)((char *)buf + size);
+	size += sizeof(uffs_PageSpare) * dev->attr->pages_per_block * maxCachedBlocks;
 
-	//initialize block info
-	work = &(blockInfos[0]);
-	dev->bc.head = work;
-	work->ref_count = 0;
-	work->prev = NULL;
-	work->next = &(blockInfos[1]);
-	work->block = UFFS_INVALID_BLOCK;
-
-	for (i = 0; i < maxCachedBlocks - 2; i++) {
-		work = &(blockInfos[i+1]);
-		work->prev = &(blockInfos[i]);
-		work->next = &(blockInfos[i+2]);
-		work->ref_count = 0;
+	dev->bc.hash = (u16 *)((char *)buf + size);
+	dev->bc.hash_size = BC_HASH_SIZE(maxCachedBlocks);
+	for (i = 0; i < dev->bc.hash_size; i++)
+		dev->bc.hash[i] = BC_HASH_EMPTY;
+
+	dev->bc.infos = blockInfos;
+	dev->bc.count = maxCachedBlocks;
+
+	//initialize block info, all of them are free at the beginning
+	for (i = 0; i < maxCachedBlocks; i++) {
+		work = &(blockInfos[i]);
+		work->prev = (i > 0 ? &(blockInfos[i-1]) : NULL);
+		work->next = (i < maxCachedBlocks - 1 ? &(blockInfos[i+1]) : NULL);
 		work->block = UFFS_INVALID_BLOCK;
+		work->ref_count = 0;
 	}
-	//the last node
-	work = &(blockInfos[i+1]);
-	work->prev = &(blockInfos[i]);
-	work->next = NULL;
-	work->block = UFFS_INVALID_BLOCK;
-	work->ref_count = 0;
-	dev->bc.tail = work;
+	dev->bc.head = &(blockInfos[0]);
+	dev->bc.tail = &(blockInfos[maxCachedBlocks - 1]);
 
 	//initialize spares
-	work = dev->bc.head;
 	for (i = 0; i < maxCachedBlocks; i++) {
+		work = &(blockInfos[i]);
 		work->spares = &(pageSpares[i*dev->attr->pages_per_block]);
 		for (j = 0; j < dev->attr->pages_per_block; j++) {
 			work->spares[j].expired = 1;
 		}
 		work->expired_count = dev->attr->pages_per_block;
-		work = work->next;
 	}
 	return U_SUCC;
 }
@@ -149,11 +155,11 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
  */
 URET uffs_BlockInfoReleaseCache(uffs_Device *dev)
 {
-	uffs_BlockInfo *work;
+	int i;
 
-	if (dev->bc.head) {
-		for (work = dev->bc.head; work != NULL; work = work->next) {
-			if (work->ref_count != 0) {
+	if (dev->bc.infos) {
+		for (i = 0; i < dev->bc.count; i++) {
+			if (dev->bc.infos[i].ref_count != 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS,
 					"There have refed block info cache, release cache fail.");
 				return U_FAIL;
@@ -166,11 +172,16 @@ URET uffs_BlockInfoReleaseCache(uffs_Device *dev)
 	}
 
 	dev->bc.head = dev->bc.tail = NULL;
+	dev->bc.infos = NULL;
+	dev->bc.count = 0;
+	dev->bc.hash = NULL;
+	dev->bc.hash_size = 0;
 	dev->bc.mem_pool = NULL;
 
 	return U_SUCC;
 }
 
+/* free list: block infos not referenced, head is the least recently used */
 static void _BreakBcFromList(uffs_Device *dev, uffs_BlockInfo *bc)
 {
 	if (bc->prev)
@@ -184,20 +195,60 @@ static void _BreakBcFromList(uffs_Device *dev, uffs_BlockInfo *bc)
 
 	if (dev->bc.tail == bc)
 		dev->bc.tail = bc->prev;
+
+	bc->next = bc->prev = NULL;
 }
 
 static void _InsertToBcListTail(uffs_Device *dev, uffs_BlockInfo *bc)
 {
 	bc->next = NULL;
 	bc->prev = dev->bc.tail;
-	bc->prev->next = bc;
+	if (bc->prev)
+		bc->prev->next = bc;
+	else
+		dev->bc.head = bc;
 	dev->bc.tail = bc;
 }
 
-static void _MoveBcToTail(uffs_Device *dev, uffs_BlockInfo *bc)
+/* hash index: open addressing with linear probing, block -> block info */
+static int _HashSlot(uffs_Device *dev, int block)
+{
+	int i = block % dev->bc.hash_size;
+	u16 idx;
+
+	while ((idx = dev->bc.hash[i]) != BC_HASH_EMPTY) {
+		if (dev->bc.infos[idx].block == block)
+			break;
+		i = (i + 1) % dev->bc.hash_size;
+	}
+
+	return i;
+}
+
+static void _HashInsert(uffs_Device *dev, uffs_BlockInfo *bc)
+{
+	dev->bc.hash[_HashSlot(dev, bc->block)] = (u16)(bc - dev->bc.infos);
+}
+
+static void _HashRemove(uffs_Device *dev, uffs_BlockInfo *bc)
 {
-	_BreakBcFromList(dev, bc);
-	_InsertToBcListTail(dev, bc);
+	int size = dev->bc.hash_size;
+	int i, j, home;
+
+	i = _HashSlot(dev, bc->block);
+	if (dev->bc.hash[i] == BC_HASH_EMPTY)
+		return;
+
+	// shift back the following entries of the probe sequence, no tombstones
+	dev->bc.hash[i] = BC_HASH_EMPTY;
+	for (j = (i + 1) % size; dev->bc.hash[j] != BC_HASH_EMPTY; j = (j + 1) % size) {
+		home = dev->bc.infos[dev->bc.hash[j]].block % size;
+		if ((j - home + size) % size >= (j - i + size) % size) {
+			dev->bc.hash[i] = dev->bc.hash[j];
+			dev->bc.hash[j] = BC_HASH_EMPTY;
+			i = j;
+		}
+	}
 }
 
 
@@ -282,15 +333,21 @@ URET uffs_BlockInfoLoad(uffs_Device *dev, uffs_BlockInfo *work, int page)
 uffs_BlockInfo * uffs_BlockInfoFindInCache(uffs_Device *dev, int block)
 {
 	uffs_BlockInfo *work;
-	
+	u16 idx;
+
+	if (dev->bc.hash == NULL)
+		return NULL;
+
 	//search cached block
-	for (work = dev->bc.head; work != NULL; work = work->next) {
-		if (work->block == block) {
-			work->ref_count++;
-			return work;
-		}
-	}
-	return NULL;
+	idx = dev->bc.hash[_HashSlot(dev, block)];
+	if (idx == BC_HASH_EMPTY)
+		return NULL;
+
+	work = &(dev->bc.infos[idx]);
+	if (work->ref_count++ == 0)
+		_BreakBcFromList(dev, work);
+
+	return work;
 }
 
 
@@ -311,21 +368,21 @@ uffs_BlockInfo * uffs_BlockInfoGet(uffs_Device *dev, int block)
 	int i;
 
 	//search cached block
-	if ((work = uffs_BlockInfoFindInCache(dev, block)) != NULL) {
-		_MoveBcToTail(dev, work);
+	if ((work = uffs_BlockInfoFindInCache(dev, block)) != NULL)
 		return work;
-	}
 
-	//can't find block from cache, need to find a free(unlocked) cache
-	for (work = dev->bc.head; work != NULL; work = work->next) {
-		if(work->ref_count == 0) break;
-	}
+	//can't find block from cache, reuse the least recently used free cache
+	work = dev->bc.head;
 	if (work == NULL) {
 		//caches used out !
 		uffs_Perror(UFFS_MSG_SERIOUS,  "insufficient block info cache");
 		return NULL;
 	}
 
+	_BreakBcFromList(dev, work);
+	if (work->block != UFFS_INVALID_BLOCK)
+		_HashRemove(dev, work);
+
 	work->block = block;
 	work->expired_count = dev->attr->pages_per_block;
 	for (i = 0; i < dev->attr->pages_per_block; i++) {
@@ -335,8 +392,7 @@ uffs_BlockInfo * uffs_BlockInfoGet(uffs_Device *dev, int block)
 	}
 
 	work->ref_count = 1;
-
-	_MoveBcToTail(dev, work);
+	_HashInsert(dev, work);
 
 	return work;
 }
@@ -355,8 +411,8 @@ void uffs_BlockInfoPut(uffs_Device *dev, uffs_BlockInfo *p)
 			uffs_Perror(UFFS_MSG_SERIOUS,
 				"Put an unused block info cache back ?");
 		}
-		else {
-			p->ref_count--;
+		else if (--p->ref_count == 0) {
+			_InsertToBcListTail(dev, p);
 		}
 	}
 }
@@ -399,13 +455,11 @@ void uffs_BlockInfoExpire(uffs_Device *dev, uffs_BlockInfo *p, int page)
  */
 UBOOL uffs_BlockInfoIsAllFree(uffs_Device *dev)
 {
-	uffs_BlockInfo *work;
+	int i;
 
-	work = dev->bc.head;
-	while (work) {
-		if (work->ref_count != 0)
+	for (i = 0; i < dev->bc.count; i++) {
+		if (dev->bc.infos[i].ref_count != 0)
 			return U_FALSE;
-		work = work->next;
 	}
 
 	return U_TRUE;
@@ -413,13 +467,11 @@ UBOOL uffs_BlockInfoIsAllFree(uffs_Device *dev)
 
 void uffs_BlockInfoExpireAll(uffs_Device *dev)
 {
-	uffs_BlockInfo *bc;
+	int i;
+
+	for (i = 0; i < dev->bc.count; i++)
+		uffs_BlockInfoExpire(dev, &(dev->bc.infos[i]), UFFS_ALL_PAGES);
 
-	bc = dev->bc.head;
-	while (bc) {
-		uffs_BlockInfoExpire(dev, bc, UFFS_ALL_PAGES);
-		bc = bc->next;
-	}
 	return;
 }
 
@@ -168,6 +168,112 @@ static void _MoveNodeToHead(uffs_Device *dev, uffs_Buf *p)
 	_LinkToBufListHead(dev, p);
 }
 
+/**
+ * \brief break a buf from free buffer list
+ * \param[in] dev uffs device
+ * \param[in] buf buffer to be broke
+ */
+static void _BreakFromFreeList(uffs_Device *dev, uffs_Buf *buf)
+{
+	if (buf->prev_free == NULL && dev->buf.free_head != buf)
+		return;		// not in the list
+
+	if (buf->next_free)
+		buf->next_free->prev_free = buf->prev_free;
+	else
+		dev->buf.free_tail = buf->prev_free;
+
+	if (buf->prev_free)
+		buf->prev_free->next_free = buf->next_free;
+	else
+		dev->buf.free_head = buf->next_free;
+
+	buf->next_free = buf->prev_free = NULL;
+}
+
+/**
+ * \brief put a buf to the head of free buffer list,
+ *			the list tail is the least recently released one.
+ * \param[in] dev uffs device
+ * \param[in] buf buffer to be put
+ */
+static void _LinkToFreeListHead(uffs_Device *dev, uffs_Buf *buf)
+{
+	_BreakFromFreeList(dev, buf);
+
+	buf->prev_free = NULL;
+	buf->next_free = dev->buf.free_head;
+
+	if (dev->buf.free_head)
+		dev->buf.free_head->prev_free = buf;
+	else
+		dev->buf.free_tail = buf;
+
+	dev->buf.free_head = buf;
+}
+
+/**
+ * \brief take a reference of a buffer in the pool
+ */
+static void _BufRef(uffs_Device *dev, uffs_Buf *buf)
+{
+	if (buf->ref_count++ == 0)
+		_BreakFromFreeList(dev, buf);
+}
+
+#define BUF_HASH(dev, parent, serial, page_id) \
+	(((u32)(parent) * 33 + ((u32)(serial) << 6) + (page_id)) % (dev)->buf.hash_size)
+
+static void _BreakFromHash(uffs_Buf *buf)
+{
+	if (buf->hash_pprev == NULL)
+		return;		// not in hash
+
+	*buf->hash_pprev = buf->hash_next;
+	if (buf->hash_next)
+		buf->hash_next->hash_pprev = buf->hash_pprev;
+
+	buf->hash_next = NULL;
+	buf->hash_pprev = NULL;
+}
+
+static void _LinkToHash(uffs_Device *dev, uffs_Buf *buf)
+{
+	uffs_Buf **head = &dev->buf.hash[BUF_HASH(dev, buf->parent, buf->serial, buf->page_id)];
+
+	buf->hash_next = *head;
+	if (*head)
+		(*head)->hash_pprev = &buf->hash_next;
+	buf->hash_pprev = head;
+	*head = buf;
+}
+
+/**
+ * \brief change the (parent, serial, page_id) of a buffer in the pool
+ */
+static void _BufSetId(uffs_Device *dev, uffs_Buf *buf,
+						u16 parent, u16 serial, u16 page_id)
+{
+	buf->parent = parent;
+	buf->serial = serial;
+	buf->page_id = page_id;
+	uffs_BufRehash(dev, buf);
+}
+
+/**
+ * \brief re-index the buffer after its parent, serial or page_id is changed
+ * \param[in] dev uffs device
+ * \param[in] buf buffer in the pool, cloned buffer is not indexed
+ */
+void uffs_BufRehash(uffs_Device *dev, uffs_Buf *buf)
+{
+	if (buf->hash_pprev == NULL)
+		return;
+
+	_BreakFromHash(buf);
+	_LinkToHash(dev, buf);
+}
+
 
 /**
  * \brief put the buffer in clone buffers list
@@ -229,7 +335,7 @@ URET uffs_BufInit(uffs_Device *dev, int buf_max, int dirty_buf_max)
 		return U_FAIL;
 	}
 	
-	size = (sizeof(uffs_Buf) + dev->com.pg_size) * buf_max;
+	size = (sizeof(uffs_Buf) + sizeof(uffs_Buf *) + dev->com.pg_size) * buf_max;
 	if (dev->mem.pagebuf_pool_size == 0) {
 		if (dev->mem.malloc) {
 			dev->mem.pagebuf_pool_buf = dev->mem.malloc(dev, size);
@@ -290,6 +396,16 @@ URET uffs_BufInit(uffs_Device *dev, int buf_max, int dirty_buf_max)
 		_InsertToCloneBufList(dev, buf);
 	}
 
+	// hash buckets follow the page data, all the rest buffers are free
+	dev->buf.hash = (uffs_Buf **)((u8 *)pool + (sizeof(uffs_Buf) + dev->com.pg_size) * buf_max);
+	dev->buf.hash_size = buf_max;
+	memset(dev->buf.hash, 0, sizeof(uffs_Buf *) * buf_max);
+	dev->buf.free_head = dev->buf.free_tail = NULL;
+	for (buf = dev->buf.head; buf; buf = buf->next) {
+		_LinkToHash(dev, buf);
+		_LinkToFreeListHead(dev, buf);
+	}
+
 	return U_SUCC;
 }
 
@@ -348,6 +464,9 @@ URET uffs_BufReleaseAll(uffs_Device *dev)
 
 	dev->buf.pool = NULL;
 	dev->buf.head = dev->buf.tail = NULL;
+	dev->buf.free_head = dev->buf.free_tail = NULL;
+	dev->buf.hash = NULL;
+	dev->buf.hash_size = 0;
 
 	return U_SUCC;
 }
@@ -375,6 +494,8 @@ static void _LinkToDirtyList(uffs_Device *dev, int slot, uffs_Buf *buf)
 		return;
 	}
 
+	_BreakFromFreeList(dev, buf);
+
 	buf->mark = UFFS_BUF_DIRTY;
 	buf->prev_dirty = NULL;
 	buf->next_dirty = dev->buf.dirtyGroup[slot].dirty;
@@ -390,17 +511,16 @@ static uffs_Buf * _FindFreeBuf(uffs_Device *dev)
 {
 	uffs_Buf *buf;
 
-#if 0
-	buf = dev->buf.head;
-	while (buf) {
-
-		if (buf->ref_count == 0 && 
+	// the least recently released buffer, drop the ones no longer free
+	while ((buf = dev->buf.free_tail) != NULL) {
+		if (buf->ref_count == 0 &&
 			buf->mark != UFFS_BUF_DIRTY)
 			return buf;
 
-		buf = buf->next;
+		_BreakFromFreeList(dev, buf);
 	}
-#else
+
+	// free list missed some (e.g. mark changed outside), search the pool
 	buf = dev->buf.tail;
 	while (buf) {
 
@@ -410,7 +530,6 @@ static uffs_Buf * _FindFreeBuf(uffs_Device *dev)
 
 		buf = buf->prev;
 	}
-#endif
 
 	return buf;
 }
@@ -455,9 +574,22 @@ uffs_Buf * uffs_BufFindFrom(uffs_Device *dev, uffs_Buf *start,
 uffs_Buf * uffs_BufFind(uffs_Device *dev,
 						u16 parent, u16 serial, u16 page_id)
 {
-	uffs_Buf *p = dev->buf.head;
+	uffs_Buf *p;
+
+	if (page_id == UFFS_ALL_PAGES)
+		return uffs_BufFindFrom(dev, dev->buf.head, parent, serial, page_id);
+
+	p = dev->buf.hash[BUF_HASH(dev, parent, serial, page_id)];
+	while (p) {
+		if (p->parent == parent &&
+			p->serial == serial &&
+			p->page_id == page_id &&
+			p->mark != UFFS_BUF_EMPTY)
+			return p;
+		p = p->hash_next;
+	}
 
-	return uffs_BufFindFrom(dev, p, parent, serial, page_id);
+	return NULL; //buffer not found
 }
 
 
@@ -505,6 +637,9 @@ static URET _BreakFromDirty(uffs_Device *dev, uffs_Buf *dirtyBuf)
 
 	dev->buf.dirtyGroup[slot].count--;
 
+	if (dirtyBuf->ref_count == 0)
+		_LinkToFreeListHead(dev, dirtyBuf);
+
 	return U_SUCC;
 }
 
@@ -555,20 +690,20 @@ static URET _CheckDirtyList(uffs_Buf *dirty)
 	return U_SUCC;
 }
 
-/** find a page in dirty list, which has minimum page_id */
-uffs_Buf * _FindMinimunPageIdFromDirtyList(uffs_Buf *dirtyList)
+/** find a page in dirty list, which has minimum page_id above 'after' (NULL for any) */
+uffs_Buf * _FindMinimunPageIdFromDirtyList(uffs_Buf *dirtyList, uffs_Buf *after)
 {
-	uffs_Buf * work = dirtyList;
-	uffs_Buf * buf = dirtyList;
+	uffs_Buf * work;
+	uffs_Buf * buf = NULL;
 
-	if (buf) {
-		work = work->next_dirty;
-		while (work) {
-			if (work->page_id < buf->page_id)
-				buf = work;
-			work = work->next_dirty;
-		}
+	for (work = dirtyList; work; work = work->next_dirty) {
+		if (after && work->page_id <= after->page_id)
+			continue;
+		if (buf == NULL || work->page_id < buf->page_id)
+			buf = work;
+	}
 
+	if (buf) {
 		uffs_Assert(buf->mark == UFFS_BUF_DIRTY, 
 					"buf (serial = %d, parent = %d, page_id = %d, type = %d) in dirty list but mark is 0x%x ?",
 					buf->serial, buf->parent, buf->page_id, buf->type, buf->mark);
@@ -610,6 +745,7 @@ static URET uffs_BufFlush_Exist_With_BlockRecover(
 								// U_FALSE: fail to recover, erase new block
 	int flash_op_new;			// flash operation (write) result for new block
 	int flash_op_old;			// flash operation (read) result for old block
+	int flash_op_last;			// result of the last page left programming
 	u16 data_sum = 0xFFFF;
 
 	UBOOL useCloneBuf;
@@ -656,6 +792,9 @@ retry:
 //	uffs_Perror(UFFS_MSG_NOISY, "Flush buffers with Block Recover, from %d to %d", 
 //					bc->block, newBc->block);
 
+	// load next page while the previous one is programming
+	uffs_FlashWritePipeline(dev, newBlock, U_TRUE);
+
 	for (i = 0; i < dev->attr->pages_per_block; i++) {
 		tag = GET_TAG(newBc, i);
 		TAG_DIRTY_BIT(tag) = TAG_DIRTY;
@@ -794,11 +933,18 @@ retry:
 
 	} //end of for
 
+	flash_op_last = uffs_FlashWritePipeline(dev, newBlock, U_FALSE);
+	if (UFFS_FLASH_HAVE_ERR(flash_op_last) && !UFFS_FLASH_HAVE_ERR(flash_op_new))
+		flash_op_new = flash_op_last;
+
 	if (i == dev->attr->pages_per_block)
 		succRecover = U_TRUE;
 	else {
 		// expire last page info cache in case the 'tag' is not written.
 		uffs_BlockInfoExpire(dev, newBc, i);
+		// with pipelined writes, the failed page may be the one before
+		if (i > 0 && UFFS_FLASH_HAVE_ERR(flash_op_new))
+			uffs_BlockInfoExpire(dev, newBc, i - 1);
 	}
 
 	if (UFFS_FLASH_IS_BAD_BLOCK(flash_op_new)) {
@@ -853,23 +999,21 @@ retry:
 		// swap the old block node and new block node.
 		// it's important that we 'swap' the block and keep the node unchanged
 		// so that allowing someone hold the node pointer unawared.
+		uffs_TreeSetNodeBlock(dev, type, node, newBlock);
 		switch (type) {
 		case UFFS_TYPE_DIR:
 			node->u.dir.parent = parent;
 			node->u.dir.serial = serial;
-			node->u.dir.block = newBlock;
 			node->u.dir.checksum = data_sum;
 			break;
 		case UFFS_TYPE_FILE:
 			node->u.file.parent = parent;
 			node->u.file.serial = serial;
-			node->u.file.block = newBlock;
 			node->u.file.checksum = data_sum;
 			break;
 		case UFFS_TYPE_DATA:
 			node->u.data.parent = parent;
 			node->u.data.serial = serial;
-			node->u.data.block = newBlock;
 			break;
 		default:
 			uffs_Perror(UFFS_MSG_SERIOUS, "UNKNOW TYPE");
@@ -967,6 +1111,15 @@ ext:
 }
 
 
+/** take a buffer written to flash off the dirty list */
+static void _BufWritten(uffs_Device *dev, uffs_Buf *buf)
+{
+	if (buf && _BreakFromDirty(dev, buf) == U_SUCC) {
+		buf->mark = UFFS_BUF_VALID;
+		_MoveNodeToHead(dev, buf);
+	}
+}
+
 /** 
  * \brief flush buffer to a block with enough free pages 
  *  
@@ -983,6 +1136,7 @@ URET
 {
 	u16 page;
 	uffs_Buf *buf;
+	uffs_Buf *prev = NULL;	// written, but the result may not be known yet
 	uffs_Tags *tag;
 	URET ret = U_FAIL;
 	int x;
@@ -991,9 +1145,12 @@ URET
 //					"Flush buffers with Enough Free Page to block %d",
 //					bc->block);
 
+	// load next page while the previous one is programming
+	uffs_FlashWritePipeline(dev, bc->block, U_TRUE);
+
 	for (page = 1;	// page 0 won't be a free page, so we start from 1.
 			page < dev->attr->pages_per_block &&
-			dev->buf.dirtyGroup[slot].count > 0;		//still has dirty pages?
+			dev->buf.dirtyGroup[slot].count > (prev ? 1 : 0);		//still has dirty pages?
 			page++) {
 
 		// locate to the free page (make sure the page is a erased page, so an unclean page won't sneak in)
@@ -1005,7 +1162,7 @@ URET
 		if (!uffs_Assert(page < dev->attr->pages_per_block, "no free page? buf flush not finished."))
 			break;
 
-		buf = _FindMinimunPageIdFromDirtyList(dev->buf.dirtyGroup[slot].dirty);
+		buf = _FindMinimunPageIdFromDirtyList(dev->buf.dirtyGroup[slot].dirty, prev);
 		if (buf == NULL) {
 			uffs_Perror(UFFS_MSG_SERIOUS,
 						"count > 0, but no dirty pages in list ?");
@@ -1037,12 +1194,26 @@ URET
 			goto ext;
 		}
 		else {
-			if(_BreakFromDirty(dev, buf) == U_SUCC) {
-				buf->mark = UFFS_BUF_VALID;
-				_MoveNodeToHead(dev, buf);
-			}
+			// this write also confirms the previous page, which may have been
+			// left programming. Until then it stays dirty.
+			_BufWritten(dev, prev);
+			prev = buf;
 		}
 	} //end of for
+
+	// the last page may still be programming
+	x = uffs_FlashWritePipeline(dev, bc->block, U_FALSE);
+	if (x == UFFS_FLASH_IO_ERR) {
+		uffs_Perror(UFFS_MSG_NORMAL, "I/O error <2>?");
+		goto ext;
+	}
+	else if (x == UFFS_FLASH_BAD_BLK) {
+		uffs_Perror(UFFS_MSG_NORMAL, "Bad blcok found, start block recover ...");
+
+		ret = uffs_BufFlush_Exist_With_BlockRecover(dev, slot, node, bc, U_TRUE);
+		goto ext;
+	}
+	_BufWritten(dev, prev);
 	
 	if (dev->buf.dirtyGroup[slot].dirty != NULL ||
 			dev->buf.dirtyGroup[slot].count != 0) {
@@ -1053,6 +1224,7 @@ URET
 	}
 
 ext:
+	uffs_FlashWritePipeline(dev, bc->block, U_FALSE);
 	return ret;
 }
 
@@ -1373,7 +1545,7 @@ uffs_Buf * uffs_BufGet(struct uffs_DeviceSt *dev,
 	p = uffs_BufFind(dev, parent, serial, page_id);
 
 	if (p) {
-		p->ref_count++;
+		_BufRef(dev, p);
 		_MoveNodeToHead(dev, p);
 	}
 
@@ -1414,11 +1586,9 @@ uffs_Buf *uffs_BufNew(struct uffs_DeviceSt *dev,
 
 	buf->mark = UFFS_BUF_EMPTY;
 	buf->type = type;
-	buf->parent = parent;
-	buf->serial = serial;
-	buf->page_id = page_id;
+	_BufSetId(dev, buf, parent, serial, page_id);
 	buf->data_len = 0;
-	buf->ref_count++;
+	_BufRef(dev, buf);
 	memset(buf->data, 0xff, dev->com.pg_data_size);
 
 	_MoveNodeToHead(dev, buf);
@@ -1470,7 +1640,7 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 
 	buf = uffs_BufFind(dev, parent, serial, page_id);
 	if (buf) {
-		buf->ref_count++;
+		_BufRef(dev, buf);
 		return buf;
 	}
 
@@ -1523,9 +1693,7 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 
 	buf->mark = UFFS_BUF_EMPTY;
 	buf->type = type;
-	buf->parent = parent;
-	buf->serial = serial;
-	buf->page_id = page_id;
+	_BufSetId(dev, buf, parent, serial, page_id);
 
 	ret = uffs_FlashReadPage(dev, block, page, buf, oflag & UO_NOECC ? U_TRUE : U_FALSE);
 
@@ -1545,7 +1713,7 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 
 	buf->data_len = TAG_DATA_LEN(GET_TAG(bc, page));
 	buf->mark = UFFS_BUF_VALID;
-	buf->ref_count++;
+	_BufRef(dev, buf);
 
 	_MoveNodeToHead(dev, buf);
 	
@@ -1553,6 +1721,117 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 
 }
 
+#if CONFIG_READ_AHEAD_PAGES > 0
+/** 
+ * \brief load pages to page buffers ahead of a sequential reader
+ * \param[in] dev uffs device
+ * \param[in] type dir, file or data
+ * \param[in] node node of the block
+ * \param[in] page_id the first page to be loaded
+ * \param[in] count max pages to be loaded
+ * \return number of pages loaded
+ * \note stops at a cached page or a page which does not follow the previous one
+ *		 on flash. Only clean buffers are reused, nothing is flushed for read-ahead,
+ *		 pages failed to load are left to #uffs_BufGetEx.
+ */
+int uffs_BufReadAhead(struct uffs_DeviceSt *dev,
+						u8 type, TreeNode *node, u16 page_id, int count)
+{
+	uffs_Buf *bufs[CONFIG_READ_AHEAD_PAGES];
+	u8 *headers[CONFIG_READ_AHEAD_PAGES];
+	int rets[CONFIG_READ_AHEAD_PAGES];
+	u16 data_len[CONFIG_READ_AHEAD_PAGES];
+	u16 parent, serial, block, page, first = 0;
+	uffs_BlockInfo *bc;
+	uffs_Buf *buf;
+	int i, n, ret, loaded = 0;
+
+	if (!UFFS_FLASH_CAN_READ_SEQ(dev))
+		return 0;
+
+	switch (type) {
+	case UFFS_TYPE_DIR:
+		parent = node->u.dir.parent;
+		serial = node->u.dir.serial;
+		block = node->u.dir.block;
+		break;
+	case UFFS_TYPE_FILE:
+		parent = node->u.file.parent;
+		serial = node->u.file.serial;
+		block = node->u.file.block;
+		break;
+	case UFFS_TYPE_DATA:
+		parent = node->u.data.parent;
+		serial = node->u.data.serial;
+		block = node->u.data.block;
+		break;
+	default:
+		uffs_Perror(UFFS_MSG_SERIOUS, "unknown type");
+		return 0;
+	}
+
+	if (count > CONFIG_READ_AHEAD_PAGES)
+		count = CONFIG_READ_AHEAD_PAGES;
+	if (page_id + count > dev->attr->pages_per_block)
+		count = dev->attr->pages_per_block - page_id;
+
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL)
+		return 0;
+
+	for (n = 0; n < count; n++) {
+		if (uffs_BufFind(dev, parent, serial, page_id + n) != NULL)
+			break;
+
+		page = uffs_FindPageInBlockWithPageId(dev, bc, page_id + n);
+		if (page == UFFS_INVALID_PAGE)
+			break;
+		page = uffs_FindBestPageInBlock(dev, bc, page);
+		if (page == UFFS_INVALID_PAGE || (n > 0 && page != first + n))
+			break;
+		if (n == 0)
+			first = page;
+
+		data_len[n] = TAG_DATA_LEN(GET_TAG(bc, page));
+		if (data_len[n] == 0 || data_len[n] > dev->com.pg_data_size)
+			break;
+
+		buf = _FindFreeBuf(dev);
+		if (buf == NULL)
+			break;
+
+		_BufRef(dev, buf);	// hold it while loading
+		buf->mark = UFFS_BUF_EMPTY;
+		buf->type = type;
+		_BufSetId(dev, buf, parent, serial, page_id + n);
+
+		bufs[n] = buf;
+		headers[n] = buf->header;
+	}
+
+	uffs_BlockInfoPut(dev, bc);
+
+	if (n == 0)
+		return 0;
+
+	ret = uffs_FlashReadPageSeq(dev, block, first, n, headers, rets);
+
+	for (i = 0; i < n; i++) {
+		buf = bufs[i];
+		if (!UFFS_FLASH_HAVE_ERR(ret) && !UFFS_FLASH_HAVE_ERR(rets[i])) {
+			uffs_BadBlockAddByFlashResult(dev, block, rets[i]);
+			buf->data_len = data_len[i];
+			buf->mark = UFFS_BUF_VALID;
+			_MoveNodeToHead(dev, buf);
+			loaded++;
+		}
+		uffs_BufPut(dev, buf);
+	}
+
+	return loaded;
+}
+#endif
+
 /** 
  * \brief Put back a page buffer, make reference count decrease by one
  * \param[in] dev uffs device
@@ -1573,7 +1852,8 @@ URET uffs_BufPut(uffs_Device *dev, uffs_Buf *buf)
 		ret = uffs_BufFreeClone(dev, buf);
 	}
 	else {
-		buf->ref_count--;
+		if (--buf->ref_count == 0 && buf->mark != UFFS_BUF_DIRTY)
+			_LinkToFreeListHead(dev, buf);
 		ret = U_SUCC;
 	}
 
@@ -1760,6 +2040,12 @@ URET uffs_BufWrite(struct uffs_DeviceSt *dev,
 	else
 		memset(buf->data + ofs, 0, len);	// if data == NULL, then fill all '\0'.
 
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+	// header page of DIR/FILE changed (create, rename, time update)
+	if (buf->page_id == 0 && buf->type != UFFS_TYPE_DATA)
+		uffs_DcacheInvalidate(dev, buf->serial);
+#endif
+
 	if (ofs + len > buf->data_len) 
 		buf->data_len = ofs + len;
 	
@@ -0,0 +1,872 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+/**
+ * \file uffs_ckpt.c
+ * \brief tree checkpoint: save the block tree to reserved blocks
+ *        on unmount/flush, restore it on the next mount without scanning.
+ *
+ * The last #UFFS_CKPT_BLOCKS blocks of the partition are reserved and used
+ * in turn. A checkpoint is written as a header followed by one record per
+ * tree node, the following pages are the journal: before a block is
+ * programmed, erased or marked bad for the first time after the checkpoint
+ * was taken, a journal page listing all such blocks so far is programmed.
+ * On mount, the tree is restored from the checkpoint and only the blocks in
+ * the last journal page are scanned again.
+ *
+ * When the journal is full, the last page of the block is programmed as the
+ * 'overflow' mark, and the tree will be built by scanning all blocks.
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_os.h"
+#include "uffs/uffs_pool.h"
+#include "uffs/uffs_flash.h"
+#include "uffs/uffs_buf.h"
+#include "uffs/uffs_crc.h"
+#include "uffs/uffs_badblock.h"
+#include "uffs/uffs_ckpt.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#define PFX "ckpt: "
+
+#ifdef CONFIG_TREE_CHECKPOINT
+
+#define TPOOL(dev) &(dev->mem.tree_pool)
+
+#define UFFS_CKPT_MAGIC		0x504b4355		/* "UCKP" */
+#define UFFS_CKPT_JNL_MAGIC	0x4c4e4a55		/* "UJNL" */
+#define UFFS_CKPT_VERSION	1
+
+/** the last page of checkpoint block is the journal 'overflow' mark */
+#define CKPT_MARK_PAGE(dev)	((dev)->attr->pages_per_block - 1)
+
+/** node regions, in the order they are stored */
+#define CKPT_REGION_DIR		0
+#define CKPT_REGION_FILE	1
+#define CKPT_REGION_DATA	2
+#define CKPT_REGION_ERASED	3
+#define CKPT_REGION_BAD		4
+#define CKPT_REGIONS		5
+
+/** checkpoint header, at the beginning of the first page */
+struct uffs_CkptHeaderSt {
+	u32 magic;
+	u16 version;
+	u16 pages;						//!< pages used by this checkpoint, header page included
+	u32 seq;						//!< sequence number, the newest checkpoint wins
+	u16 par_start;					//!< partition of the tree
+	u16 par_end;
+	u16 pages_per_block;
+	u16 max_serial;
+	u16 count[CKPT_REGIONS];		//!< number of node records of each region
+	u16 data_crc;					//!< crc16 of all node records
+	u16 header_crc;					//!< crc16 of this header, up to (not include) header_crc
+};
+
+/** one tree node in checkpoint */
+struct uffs_CkptNodeSt {
+	u16 block;
+	u16 parent;
+	u16 serial;
+	u16 sum;						//!< name sum for DIR/FILE, 'need_check' for erased block
+	u32 len;						//!< file length for FILE, data length for DATA
+};
+
+/** journal page header, followed by block numbers */
+struct uffs_CkptJournalSt {
+	u32 magic;
+	u32 seq;						//!< sequence number of the checkpoint
+	u16 count;						//!< number of blocks
+	u16 crc;						//!< crc16 of block numbers
+};
+
+#define JNL_BLOCKS(ckpt)	((u16 *)((ckpt)->jnl_buf + sizeof(struct uffs_CkptJournalSt)))
+
+/** page stream over one checkpoint block */
+struct uffs_CkptIoSt {
+	uffs_Device *dev;
+	u16 block;						//!< physical block
+	u16 page;						//!< current page
+	int ofs;						//!< offset in current page
+	u8 *buf;						//!< page buffer
+	u16 crc;						//!< running crc16 of node records
+	UBOOL write;					//!< U_TRUE: write to flash, U_FALSE: only calculate crc
+};
+
+static UBOOL _IsAllFF(const u8 *p, int len)
+{
+	while (len-- > 0) {
+		if (*p++ != 0xFF)
+			return U_FALSE;
+	}
+	return U_TRUE;
+}
+
+static int _CkptPagesNeeded(uffs_Device *dev, int nodes)
+{
+	int size = sizeof(struct uffs_CkptHeaderSt) + nodes * sizeof(struct uffs_CkptNodeSt);
+
+	return (size + dev->attr->page_data_size - 1) / dev->attr->page_data_size;
+}
+
+static URET _CkptWritePage(struct uffs_CkptIoSt *io)
+{
+	uffs_Device *dev = io->dev;
+	int ret;
+
+	if (io->page >= CKPT_MARK_PAGE(dev))
+		return U_FAIL;	// the last page is reserved for the overflow mark
+
+	ret = dev->ops->WritePage(dev, io->block, io->page, io->buf, dev->com.pg_size, NULL, 0);
+	if (ret != UFFS_FLASH_NO_ERR) {
+		uffs_Perror(UFFS_MSG_NORMAL, "write checkpoint block %d page %d fail (%d)",
+					io->block, io->page, ret);
+		return U_FAIL;
+	}
+	io->page++;
+	io->ofs = 0;
+	memset(io->buf, 0xFF, dev->com.pg_size);
+
+	return U_SUCC;
+}
+
+static URET _CkptReadPage(struct uffs_CkptIoSt *io, u16 page)
+{
+	uffs_Device *dev = io->dev;
+	int ret;
+
+	ret = dev->ops->ReadPage(dev, io->block, page, io->buf, dev->com.pg_size, NULL, NULL, 0);
+	if (UFFS_FLASH_HAVE_ERR(ret)) {
+		uffs_Perror(UFFS_MSG_NORMAL, "read checkpoint block %d page %d fail (%d)",
+					io->block, page, ret);
+		return U_FAIL;
+	}
+	io->page = page;
+	io->ofs = 0;
+
+	return U_SUCC;
+}
+
+static URET _CkptPut(struct uffs_CkptIoSt *io, const void *data, int len)
+{
+	const u8 *p = (const u8 *)data;
+	int n;
+
+	io->crc = uffs_crc16update(data, len, io->crc);
+	if (io->write == U_FALSE)
+		return U_SUCC;
+
+	while (len > 0) {
+		n = io->dev->com.pg_size - io->ofs;
+		if (n > len)
+			n = len;
+		memcpy(io->buf + io->ofs, p, n);
+		io->ofs += n;
+		p += n;
+		len -= n;
+		if (io->ofs == io->dev->com.pg_size) {
+			if (_CkptWritePage(io) != U_SUCC)
+				return U_FAIL;
+		}
+	}
+
+	return U_SUCC;
+}
+
+static URET _CkptGet(struct uffs_CkptIoSt *io, void *data, int len)
+{
+	u8 *p = (u8 *)data;
+	void *start = data;
+	int total = len;
+	int n;
+
+	while (len > 0) {
+		if (io->ofs == io->dev->com.pg_size) {
+			if (_CkptReadPage(io, io->page + 1) != U_SUCC)
+				return U_FAIL;
+		}
+		n = io->dev->com.pg_size - io->ofs;
+		if (n > len)
+			n = len;
+		memcpy(p, io->buf + io->ofs, n);
+		io->ofs += n;
+		p += n;
+		len -= n;
+	}
+	io->crc = uffs_crc16update(start, total, io->crc);
+
+	return U_SUCC;
+}
+
+static URET _CkptPutNode(struct uffs_CkptIoSt *io, u16 block, u16 parent, u16 serial, u16 sum, u32 len)
+{
+	struct uffs_CkptNodeSt rec;
+
+	rec.block = block;
+	rec.parent = parent;
+	rec.serial = serial;
+	rec.sum = sum;
+	rec.len = len;
+
+	return _CkptPut(io, &rec, sizeof(rec));
+}
+
+/** put all tree nodes into stream, count nodes of each region if count != NULL */
+static URET _CkptPutTree(struct uffs_CkptIoSt *io, u16 *count)
+{
+	uffs_Device *dev = io->dev;
+	struct uffs_TreeSt *tree = &(dev->tree);
+	TreeNode *node;
+	u16 x;
+	int i;
+	URET ret = U_SUCC;
+
+	for (i = 0; ret == U_SUCC && i < DIR_NODE_ENTRY_LEN; i++) {
+		for (x = tree->dir_entry[i]; ret == U_SUCC && x != EMPTY_NODE; x = node->hash_next) {
+			node = FROM_IDX(x, TPOOL(dev));
+			ret = _CkptPutNode(io, node->u.dir.block, node->u.dir.parent,
+								node->u.dir.serial, node->u.dir.checksum, 0);
+			if (count)
+				count[CKPT_REGION_DIR]++;
+		}
+	}
+	for (i = 0; ret == U_SUCC && i < FILE_NODE_ENTRY_LEN; i++) {
+		for (x = tree->file_entry[i]; ret == U_SUCC && x != EMPTY_NODE; x = node->hash_next) {
+			node = FROM_IDX(x, TPOOL(dev));
+			ret = _CkptPutNode(io, node->u.file.block, node->u.file.parent,
+								node->u.file.serial, node->u.file.checksum, node->u.file.len);
+			if (count)
+				count[CKPT_REGION_FILE]++;
+		}
+	}
+	for (i = 0; ret == U_SUCC && i < DATA_NODE_ENTRY_LEN; i++) {
+		for (x = tree->data_entry[i]; ret == U_SUCC && x != EMPTY_NODE; x = node->hash_next) {
+			node = FROM_IDX(x, TPOOL(dev));
+			ret = _CkptPutNode(io, node->u.data.block, node->u.data.parent,
+								node->u.data.serial, 0, node->u.data.len);
+			if (count)
+				count[CKPT_REGION_DATA]++;
+		}
+	}
+	for (node = tree->erased; ret == U_SUCC && node; node = node->u.list.next) {
+		ret = _CkptPutNode(io, node->u.list.block, 0, 0, node->u.list.u.need_check, 0);
+		if (count)
+			count[CKPT_REGION_ERASED]++;
+	}
+	for (node = tree->bad; ret == U_SUCC && node; node = node->u.list.next) {
+		ret = _CkptPutNode(io, node->u.list.block, 0, 0, 0, 0);
+		if (count)
+			count[CKPT_REGION_BAD]++;
+	}
+
+	return ret;
+}
+
+/** restore one node from record */
+static URET _CkptLoadNode(uffs_Device *dev, int region, struct uffs_CkptNodeSt *rec)
+{
+	TreeNode *node;
+
+	if (rec->block < dev->par.start || rec->block > dev->par.end) {
+		uffs_Perror(UFFS_MSG_NORMAL, "block %d out of partition", rec->block);
+		return U_FAIL;
+	}
+
+	node = (TreeNode *)uffs_PoolGet(TPOOL(dev));
+	if (node == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "insufficient tree node!");
+		return U_FAIL;
+	}
+
+	switch (region) {
+	case CKPT_REGION_DIR:
+		node->u.dir.block = rec->block;
+		node->u.dir.checksum = rec->sum;
+		node->u.dir.parent = rec->parent;
+		node->u.dir.serial = rec->serial;
+		uffs_InsertNodeToTree(dev, UFFS_TYPE_DIR, node);
+		break;
+	case CKPT_REGION_FILE:
+		node->u.file.block = rec->block;
+		node->u.file.checksum = rec->sum;
+		node->u.file.parent = rec->parent;
+		node->u.file.serial = rec->serial;
+		node->u.file.len = rec->len;
+		uffs_InsertNodeToTree(dev, UFFS_TYPE_FILE, node);
+		break;
+	case CKPT_REGION_DATA:
+		node->u.data.block = rec->block;
+		node->u.data.parent = rec->parent;
+		node->u.data.serial = rec->serial;
+		node->u.data.len = rec->len;
+		uffs_InsertNodeToTree(dev, UFFS_TYPE_DATA, node);
+		break;
+	case CKPT_REGION_ERASED:
+		node->u.list.block = rec->block;
+		uffs_TreeInsertToErasedListTailEx(dev, node, rec->sum ? 1 : 0);
+		break;
+	case CKPT_REGION_BAD:
+		node->u.list.block = rec->block;
+		uffs_TreeInsertToBadBlockList(dev, node);
+		break;
+	}
+
+	return U_SUCC;
+}
+
+/**
+ * read checkpoint header from page 0 of block, io->buf holds page 0 on success.
+ * foreign is set to U_TRUE if the block is neither erased nor a checkpoint block.
+ */
+static URET _CkptReadHeader(struct uffs_CkptIoSt *io, struct uffs_CkptHeaderSt *hdr, UBOOL *foreign)
+{
+	uffs_Device *dev = io->dev;
+
+	*foreign = U_FALSE;
+	if (_CkptReadPage(io, 0) != U_SUCC)
+		return U_FAIL;
+
+	memcpy(hdr, io->buf, sizeof(struct uffs_CkptHeaderSt));
+	if (hdr->magic != UFFS_CKPT_MAGIC) {
+		*foreign = _IsAllFF(io->buf, dev->com.pg_size) ? U_FALSE : U_TRUE;
+		return U_FAIL;
+	}
+
+	if (hdr->header_crc != uffs_crc16sum(hdr, offsetof(struct uffs_CkptHeaderSt, header_crc)) ||
+		hdr->version != UFFS_CKPT_VERSION ||
+		hdr->par_start != dev->par.start ||
+		hdr->par_end != dev->par.end ||
+		hdr->pages_per_block != dev->attr->pages_per_block ||
+		hdr->pages == 0 ||
+		hdr->pages >= CKPT_MARK_PAGE(dev)) {
+		return U_FAIL;
+	}
+
+	io->ofs = sizeof(struct uffs_CkptHeaderSt);
+
+	return U_SUCC;
+}
+
+/** check the journal 'overflow' mark */
+static UBOOL _CkptIsOverflow(uffs_Device *dev, u16 block)
+{
+	u8 mark[4];
+	int ret;
+
+	ret = dev->ops->ReadPage(dev, block, CKPT_MARK_PAGE(dev), mark, sizeof(mark), NULL, NULL, 0);
+	if (UFFS_FLASH_HAVE_ERR(ret))
+		return U_TRUE;
+
+	return _IsAllFF(mark, sizeof(mark)) ? U_FALSE : U_TRUE;
+}
+
+/** program the 'overflow' mark, so that the checkpoint in block won't be taken */
+static URET _CkptKill(uffs_Device *dev, u16 block)
+{
+	u8 mark[4];
+	int ret;
+
+	memset(mark, 0, sizeof(mark));
+	ret = dev->ops->WritePage(dev, block, CKPT_MARK_PAGE(dev), mark, sizeof(mark), NULL, 0);
+	if (ret != UFFS_FLASH_NO_ERR) {
+		// can't program the mark ? erase the checkpoint block then.
+		uffs_Perror(UFFS_MSG_NORMAL, "mark checkpoint block %d fail, erase it", block);
+		if (dev->ops->EraseBlock(dev, block) != UFFS_FLASH_NO_ERR) {
+			uffs_Perror(UFFS_MSG_SERIOUS,
+						"can't invalidate checkpoint block %d, tree checkpoint disabled!", block);
+			return U_FAIL;
+		}
+	}
+
+	return U_SUCC;
+}
+
+static void _CkptJournalClear(uffs_Device *dev)
+{
+	dev->ckpt.jnl_count = 0;
+	dev->ckpt.jnl_page = dev->ckpt.pages;
+}
+
+/** restore journal from checkpoint block, the last valid journal page has all modified blocks */
+static void _CkptJournalLoad(struct uffs_CkptIoSt *io)
+{
+	uffs_Device *dev = io->dev;
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	struct uffs_CkptJournalSt jnl;
+	const u8 *list;
+	u16 page, block;
+	int i;
+
+	for (page = ckpt->pages; page < CKPT_MARK_PAGE(dev); page++) {
+		if (_CkptReadPage(io, page) != U_SUCC) {
+			ckpt->jnl_page = page + 1;	// torn journal page ? skip it.
+			continue;
+		}
+		memcpy(&jnl, io->buf, sizeof(jnl));
+		if (_IsAllFF((u8 *)&jnl, sizeof(jnl)))
+			break;	// end of journal
+
+		ckpt->jnl_page = page + 1;
+		list = io->buf + sizeof(jnl);
+		if (jnl.magic != UFFS_CKPT_JNL_MAGIC ||
+			jnl.seq != ckpt->seq ||
+			jnl.count > ckpt->jnl_max ||
+			jnl.crc != uffs_crc16sum(list, jnl.count * sizeof(u16))) {
+			// torn journal page, the block being added was not touched yet.
+			continue;
+		}
+
+		ckpt->jnl_count = 0;
+		for (i = 0; i < jnl.count; i++) {
+			memcpy(&block, list + i * sizeof(u16), sizeof(u16));
+			if (block >= dev->par.start && block <= dev->par.end)
+				JNL_BLOCKS(ckpt)[ckpt->jnl_count++] = block;
+		}
+	}
+}
+
+/** write current journal to the next journal page */
+static URET _CkptJournalWrite(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	struct uffs_CkptJournalSt *jnl = (struct uffs_CkptJournalSt *)ckpt->jnl_buf;
+	int size = sizeof(struct uffs_CkptJournalSt) + ckpt->jnl_count * sizeof(u16);
+	int ret;
+
+	jnl->magic = UFFS_CKPT_JNL_MAGIC;
+	jnl->seq = ckpt->seq;
+	jnl->count = ckpt->jnl_count;
+	jnl->crc = uffs_crc16sum(JNL_BLOCKS(ckpt), ckpt->jnl_count * sizeof(u16));
+
+	while (ckpt->jnl_page < CKPT_MARK_PAGE(dev)) {
+		ret = dev->ops->WritePage(dev, ckpt->active, ckpt->jnl_page++, ckpt->jnl_buf, size, NULL, 0);
+		if (ret == UFFS_FLASH_NO_ERR)
+			return U_SUCC;
+		uffs_Perror(UFFS_MSG_NORMAL, "write journal block %d page %d fail (%d)",
+					ckpt->active, ckpt->jnl_page - 1, ret);
+	}
+
+	return U_FAIL;
+}
+
+/**
+ * \brief reserve the last #UFFS_CKPT_BLOCKS blocks of partition for checkpoint.
+ * \param[in] dev uffs device
+ * \note must be called before uffs_TreeInit(), dev->par.end is changed.
+ */
+URET uffs_CkptInit(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	int size;
+
+	ckpt->start = UFFS_INVALID_BLOCK;
+	ckpt->active = UFFS_INVALID_BLOCK;
+	ckpt->pages = 0;
+	ckpt->seq = 0;
+	ckpt->jnl_page = 0;
+	ckpt->jnl_count = 0;
+	ckpt->state = UFFS_CKPT_STATE_DISABLED;
+
+	if (dev->ops->ReadPage == NULL || dev->ops->WritePage == NULL) {
+		uffs_Perror(UFFS_MSG_NORMAL,
+					"flash driver doesn't provide ReadPage/WritePage, tree checkpoint disabled.");
+		return U_FAIL;
+	}
+
+	if (dev->par.end - dev->par.start + 1 < UFFS_CKPT_BLOCKS + MINIMUN_ERASED_BLOCK + 1) {
+		uffs_Perror(UFFS_MSG_NORMAL, "partition too small, tree checkpoint disabled.");
+		return U_FAIL;
+	}
+
+	ckpt->start = dev->par.end - UFFS_CKPT_BLOCKS + 1;
+	dev->par.end -= UFFS_CKPT_BLOCKS;
+
+	// need at least one page for journal
+	if (_CkptPagesNeeded(dev, dev->par.end - dev->par.start + 1) >= CKPT_MARK_PAGE(dev)) {
+		uffs_Perror(UFFS_MSG_NORMAL,
+					"tree checkpoint doesn't fit in one block, disabled.");
+		return U_FAIL;
+	}
+
+	size = sizeof(struct uffs_CkptJournalSt) + (dev->par.end - dev->par.start + 1) * sizeof(u16);
+	if (size > dev->attr->page_data_size)
+		size = dev->attr->page_data_size;
+	ckpt->jnl_max = (size - sizeof(struct uffs_CkptJournalSt)) / sizeof(u16);
+
+	if (ckpt->jnl_buf == NULL && dev->mem.malloc)
+		ckpt->jnl_buf = (u8 *)dev->mem.malloc(dev, size);
+	if (ckpt->jnl_buf == NULL) {
+		uffs_Perror(UFFS_MSG_NORMAL, "alloc journal buffer fail, tree checkpoint disabled.");
+		return U_FAIL;
+	}
+
+	ckpt->state = UFFS_CKPT_STATE_NONE;
+
+	return U_SUCC;
+}
+
+/**
+ * \brief release journal buffer.
+ * \param[in] dev uffs device
+ */
+void uffs_CkptRelease(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+
+	if (ckpt->jnl_buf && dev->mem.free) {
+		dev->mem.free(dev, ckpt->jnl_buf);
+		ckpt->jnl_buf = NULL;
+	}
+}
+
+/**
+ * \brief restore tree from the newest valid checkpoint.
+ * \param[in] dev uffs device
+ * \return U_SUCC if the tree is restored,
+ *         U_FAIL if no valid checkpoint, the tree is left empty.
+ */
+URET uffs_CkptLoad(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	struct uffs_CkptHeaderSt hdr;
+	struct uffs_CkptNodeSt rec;
+	struct uffs_CkptIoSt io;
+	uffs_Buf *buf;
+	UBOOL is_foreign, foreign = U_FALSE;
+	u16 block, best = UFFS_INVALID_BLOCK;
+	u32 best_seq = 0;
+	int region, i, total;
+	u32 valid = 0;
+	URET ret = U_FAIL;
+
+	if (ckpt->state == UFFS_CKPT_STATE_DISABLED)
+		return U_FAIL;
+
+	ckpt->state = UFFS_CKPT_STATE_NONE;
+	ckpt->active = UFFS_INVALID_BLOCK;
+	ckpt->jnl_count = 0;
+
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL)
+		return U_FAIL;
+
+	memset(&io, 0, sizeof(io));
+	io.dev = dev;
+	io.buf = buf->header;
+
+	for (block = ckpt->start; block < ckpt->start + UFFS_CKPT_BLOCKS; block++) {
+		io.block = block;
+		if (_CkptReadHeader(&io, &hdr, &is_foreign) != U_SUCC) {
+			if (is_foreign)
+				foreign = U_TRUE;
+			continue;
+		}
+		if (hdr.seq > ckpt->seq)
+			ckpt->seq = hdr.seq;
+		if (_CkptIsOverflow(dev, block) == U_FALSE) {
+			valid |= 1 << (block - ckpt->start);
+			if (best == UFFS_INVALID_BLOCK || hdr.seq > best_seq) {
+				best = block;
+				best_seq = hdr.seq;
+			}
+		}
+	}
+
+	if (best == UFFS_INVALID_BLOCK) {
+		if (foreign) {
+			uffs_Perror(UFFS_MSG_NORMAL,
+						"checkpoint blocks hold other data, format to enable tree checkpoint.");
+			ckpt->state = UFFS_CKPT_STATE_DISABLED;
+		}
+		goto ext;
+	}
+
+	io.block = best;
+	if (_CkptReadHeader(&io, &hdr, &is_foreign) != U_SUCC)
+		goto discard;
+
+	total = 0;
+	for (region = 0; region < CKPT_REGIONS; region++)
+		total += hdr.count[region];
+	if (total != dev->par.end - dev->par.start + 1) {
+		uffs_Perror(UFFS_MSG_NORMAL, "checkpoint has %d nodes, expect %d",
+					total, dev->par.end - dev->par.start + 1);
+		goto discard;
+	}
+
+	io.crc = 0xFFFF;
+	for (region = 0; region < CKPT_REGIONS; region++) {
+		for (i = 0; i < hdr.count[region]; i++) {
+			if (_CkptGet(&io, &rec, sizeof(rec)) != U_SUCC ||
+				_CkptLoadNode(dev, region, &rec) != U_SUCC)
+				goto fail;
+		}
+	}
+
+	if (io.crc != hdr.data_crc) {
+		uffs_Perror(UFFS_MSG_NORMAL, "checkpoint crc mismatch");
+		goto fail;
+	}
+
+	dev->tree.max_serial = hdr.max_serial;
+	ckpt->seq = hdr.seq;
+	ckpt->active = best;
+	ckpt->pages = hdr.pages;
+	_CkptJournalClear(dev);
+	_CkptJournalLoad(&io);
+	ckpt->state = UFFS_CKPT_STATE_CLEAN;
+
+	// power lost when saving the checkpoint ? there is only one checkpoint can be taken.
+	for (block = ckpt->start; block < ckpt->start + UFFS_CKPT_BLOCKS; block++) {
+		if (block != best && (valid & (1 << (block - ckpt->start)))) {
+			if (_CkptKill(dev, block) != U_SUCC) {
+				_CkptKill(dev, best);
+				ckpt->state = UFFS_CKPT_STATE_DISABLED;
+			}
+		}
+	}
+
+	uffs_Perror(UFFS_MSG_NORMAL,
+				"tree restored from checkpoint (seq %d): DIR %d, FILE %d, DATA %d, journal %d",
+				hdr.seq, hdr.count[CKPT_REGION_DIR],
+				hdr.count[CKPT_REGION_FILE], hdr.count[CKPT_REGION_DATA],
+				ckpt->jnl_count);
+	ret = U_SUCC;
+	goto ext;
+
+fail:
+	// drop the half restored tree, it will be built by scanning.
+	uffs_TreeInit(dev);
+discard:
+	// the tree is going to be changed, don't leave a checkpoint which might be taken next time.
+	for (block = ckpt->start; block < ckpt->start + UFFS_CKPT_BLOCKS; block++) {
+		if ((valid & (1 << (block - ckpt->start))) && _CkptKill(dev, block) != U_SUCC)
+			ckpt->state = UFFS_CKPT_STATE_DISABLED;
+	}
+ext:
+	uffs_BufFreeClone(dev, buf);
+	return ret;
+}
+
+/**
+ * \brief write tree to a new checkpoint.
+ * \param[in] dev uffs device
+ * \note all dirty page buffers must be flushed before calling this.
+ */
+URET uffs_CkptSave(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	struct uffs_CkptHeaderSt hdr;
+	struct uffs_CkptIoSt io;
+	uffs_Buf *buf;
+	u16 block;
+	int slot, i, total;
+	URET ret = U_FAIL;
+
+	if (ckpt->state == UFFS_CKPT_STATE_CLEAN && ckpt->jnl_count == 0)
+		return U_SUCC;	// nothing changed since last checkpoint
+
+	if (ckpt->state == UFFS_CKPT_STATE_DISABLED)
+		return U_FAIL;
+
+	// only take checkpoint when the tree is stable
+	if (HAVE_BADBLOCK(dev) || dev->tree.suspend != NULL)
+		return U_FAIL;
+
+	for (slot = 0; slot < dev->cfg.dirty_groups; slot++) {
+		if (dev->buf.dirtyGroup[slot].count > 0)
+			return U_FAIL;
+	}
+
+	memset(&hdr, 0xFF, sizeof(hdr));
+	memset(&io, 0, sizeof(io));
+	io.dev = dev;
+	io.crc = 0xFFFF;
+	io.write = U_FALSE;
+	memset(hdr.count, 0, sizeof(hdr.count));
+	_CkptPutTree(&io, hdr.count);
+
+	total = 0;
+	for (i = 0; i < CKPT_REGIONS; i++)
+		total += hdr.count[i];
+	if (total != dev->par.end - dev->par.start + 1) {
+		uffs_Perror(UFFS_MSG_NORMAL, "tree has %d nodes, expect %d, skip checkpoint",
+					total, dev->par.end - dev->par.start + 1);
+		return U_FAIL;
+	}
+
+	hdr.magic = UFFS_CKPT_MAGIC;
+	hdr.version = UFFS_CKPT_VERSION;
+	hdr.pages = _CkptPagesNeeded(dev, total);
+	hdr.seq = ckpt->seq + 1;
+	hdr.par_start = dev->par.start;
+	hdr.par_end = dev->par.end;
+	hdr.pages_per_block = dev->attr->pages_per_block;
+	hdr.max_serial = dev->tree.max_serial;
+	hdr.data_crc = io.crc;
+	hdr.header_crc = uffs_crc16sum(&hdr, offsetof(struct uffs_CkptHeaderSt, header_crc));
+
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL)
+		return U_FAIL;
+
+	// use the block next to the last one, keep wearing even.
+	if (ckpt->active == UFFS_INVALID_BLOCK)
+		block = ckpt->start + (hdr.seq % UFFS_CKPT_BLOCKS);
+	else
+		block = ckpt->start + ((ckpt->active - ckpt->start + 1) % UFFS_CKPT_BLOCKS);
+
+	if (dev->ops->EraseBlock(dev, block) != UFFS_FLASH_NO_ERR) {
+		uffs_Perror(UFFS_MSG_NORMAL, "erase checkpoint block %d fail", block);
+		goto ext;
+	}
+
+	io.block = block;
+	io.page = 0;
+	io.buf = buf->header;
+	io.crc = 0xFFFF;
+	io.write = U_TRUE;
+	memset(io.buf, 0xFF, dev->com.pg_size);
+	memcpy(io.buf, &hdr, sizeof(hdr));
+	io.ofs = sizeof(hdr);
+
+	if (_CkptPutTree(&io, NULL) != U_SUCC)
+		goto ext;
+	if (io.ofs > 0 && _CkptWritePage(&io) != U_SUCC)
+		goto ext;
+
+	if (!uffs_Assert(io.page == hdr.pages && io.crc == hdr.data_crc,
+					"checkpoint changed while writing ? pages %d/%d", io.page, hdr.pages))
+		goto ext;
+
+	// the old checkpoint with its journal is still valid until now.
+	if (ckpt->active != UFFS_INVALID_BLOCK && _CkptKill(dev, ckpt->active) != U_SUCC) {
+		_CkptKill(dev, block);
+		ckpt->state = UFFS_CKPT_STATE_DISABLED;
+		goto ext;
+	}
+
+	ckpt->seq = hdr.seq;
+	ckpt->active = block;
+	ckpt->pages = hdr.pages;
+	_CkptJournalClear(dev);
+	ckpt->state = UFFS_CKPT_STATE_CLEAN;
+	ret = U_SUCC;
+
+ext:
+	uffs_BufFreeClone(dev, buf);
+	return ret;
+}
+
+/**
+ * \brief record block in journal, the block is going to be changed.
+ * \param[in] dev uffs device
+ * \param[in] block block to be programmed/erased/marked bad
+ */
+void uffs_CkptJournalAdd(uffs_Device *dev, int block)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	u16 *list = JNL_BLOCKS(ckpt);
+	int i;
+
+	if (ckpt->state != UFFS_CKPT_STATE_CLEAN)
+		return;
+
+	for (i = 0; i < ckpt->jnl_count; i++) {
+		if (list[i] == block)
+			return;		// already in journal
+	}
+
+	if (ckpt->jnl_count < ckpt->jnl_max) {
+		list[ckpt->jnl_count++] = block;
+		if (_CkptJournalWrite(dev) == U_SUCC)
+			return;
+	}
+
+	// journal is full, the checkpoint can't be used any more.
+	uffs_Perror(UFFS_MSG_NORMAL, "journal full, drop checkpoint");
+	ckpt->state = UFFS_CKPT_STATE_NONE;
+	ckpt->jnl_count = 0;
+	if (_CkptKill(dev, ckpt->active) != U_SUCC)
+		ckpt->state = UFFS_CKPT_STATE_DISABLED;
+	ckpt->active = UFFS_INVALID_BLOCK;
+}
+
+/**
+ * \brief get blocks changed after the checkpoint was taken.
+ * \param[in] dev uffs device
+ * \param[out] blocks block list
+ * \return number of blocks in list
+ */
+int uffs_CkptJournalBlocks(uffs_Device *dev, const u16 **blocks)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+
+	if (ckpt->jnl_buf == NULL) {
+		*blocks = NULL;
+		return 0;
+	}
+	*blocks = JNL_BLOCKS(ckpt);
+
+	return ckpt->jnl_count;
+}
+
+/**
+ * \brief erase checkpoint blocks.
+ * \param[in] dev uffs device
+ */
+URET uffs_CkptFormat(uffs_Device *dev)
+{
+	struct uffs_CkptSt *ckpt = &(dev->ckpt);
+	u16 block;
+	URET ret = U_SUCC;
+
+	if (ckpt->start == UFFS_INVALID_BLOCK)
+		return U_FAIL;	// no block reserved
+
+	for (block = ckpt->start; block < ckpt->start + UFFS_CKPT_BLOCKS; block++) {
+		if (dev->ops->EraseBlock(dev, block) != UFFS_FLASH_NO_ERR)
+			ret = U_FAIL;
+	}
+
+	ckpt->active = UFFS_INVALID_BLOCK;
+	ckpt->jnl_count = 0;
+	ckpt->state = (ret == U_SUCC ? UFFS_CKPT_STATE_NONE : UFFS_CKPT_STATE_DISABLED);
+
+	return ret;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+/**
+ * \file uffs_dcache.c
+ * \brief dentry cache: name, parent and attributes of DIR/FILE objects
+ *        kept in RAM, so that path lookup and readdir don't load the
+ *        header page of each object to a page buffer.
+ *
+ * Entries are direct mapped by serial and filled on first touch, when the
+ * header page had to be loaded anyway. An entry is dropped when the header
+ * page of the object is written (create, rename, attribute/time update) or
+ * the object is deleted.
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_dcache.h"
+
+#include <string.h>
+
+#define PFX "dcac: "
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+
+#define DCACHE_SLOT(dev, serial) \
+	(&((dev)->dcache.entries[(serial) % CONFIG_DENTRY_CACHE_ENTRIES]))
+
+/**
+ * \brief allocate dentry cache entries.
+ * \param[in] dev uffs device
+ * \return U_FAIL if entries can't be allocated, the cache is disabled.
+ */
+URET uffs_DcacheInit(uffs_Device *dev)
+{
+	struct uffs_DentryCacheSt *dc = &(dev->dcache);
+
+	dc->hit = 0;
+	dc->miss = 0;
+
+	if (dc->entries == NULL && dev->mem.malloc)
+		dc->entries = (struct uffs_DentrySt *)
+			dev->mem.malloc(dev, sizeof(struct uffs_DentrySt) * CONFIG_DENTRY_CACHE_ENTRIES);
+	if (dc->entries == NULL) {
+		uffs_Perror(UFFS_MSG_NORMAL, "alloc dentry cache fail, disabled.");
+		return U_FAIL;
+	}
+
+	uffs_DcacheInvalidateAll(dev);
+
+	return U_SUCC;
+}
+
+/**
+ * \brief release dentry cache entries.
+ * \param[in] dev uffs device
+ */
+void uffs_DcacheRelease(uffs_Device *dev)
+{
+	struct uffs_DentryCacheSt *dc = &(dev->dcache);
+
+	if (dc->entries && dev->mem.free) {
+		dev->mem.free(dev, dc->entries);
+		dc->entries = NULL;
+	}
+}
+
+void uffs_DcacheInvalidateAll(uffs_Device *dev)
+{
+	int i;
+
+	if (dev->dcache.entries == NULL)
+		return;
+
+	for (i = 0; i < CONFIG_DENTRY_CACHE_ENTRIES; i++)
+		dev->dcache.entries[i].serial = INVALID_UFFS_SERIAL;
+}
+
+/**
+ * \brief find cached entry of object.
+ * \param[in] dev uffs device
+ * \param[in] type #UFFS_TYPE_DIR or #UFFS_TYPE_FILE
+ * \param[in] serial object serial
+ * \param[in] parent parent serial the object is expected to be in
+ * \return the entry, or NULL if the object is not cached
+ */
+const struct uffs_DentrySt * uffs_DcacheFind(uffs_Device *dev, int type, u16 serial, u16 parent)
+{
+	struct uffs_DentrySt *d;
+
+	if (dev->dcache.entries == NULL)
+		return NULL;
+
+	d = DCACHE_SLOT(dev, serial);
+	if (d->serial == serial && d->type == type && d->parent == parent) {
+		dev->dcache.hit++;
+		return d;
+	}
+
+	dev->dcache.miss++;
+
+	return NULL;
+}
+
+void uffs_DcachePut(uffs_Device *dev, int type, u16 serial, u16 parent, const uffs_FileInfo *fi)
+{
+	struct uffs_DentrySt *d;
+
+	if (dev->dcache.entries == NULL || serial == INVALID_UFFS_SERIAL)
+		return;
+
+	d = DCACHE_SLOT(dev, serial);
+
+	if (fi->name_len > CONFIG_DENTRY_CACHE_NAME_LEN) {
+		// too long to be cached, don't leave a stale entry of this object
+		if (d->serial == serial)
+			d->serial = INVALID_UFFS_SERIAL;
+		return;
+	}
+
+	d->serial = serial;
+	d->parent = parent;
+	d->type = (u8)type;
+	d->name_len = (u8)fi->name_len;
+	d->attr = fi->attr;
+	d->create_time = fi->create_time;
+	d->last_modify = fi->last_modify;
+	d->access = fi->access;
+	memcpy(d->name, fi->name, fi->name_len);
+}
+
+void uffs_DcacheInvalidate(uffs_Device *dev, u16 serial)
+{
+	struct uffs_DentrySt *d;
+
+	if (dev->dcache.entries == NULL)
+		return;
+
+	d = DCACHE_SLOT(dev, serial);
+	if (d->serial == serial)
+		d->serial = INVALID_UFFS_SERIAL;
+}
+
+void uffs_DcacheLoadInfo(const struct uffs_DentrySt *d, uffs_FileInfo *fi)
+{
+	memset(fi, 0, sizeof(uffs_FileInfo));
+	fi->attr = d->attr;
+	fi->create_time = d->create_time;
+	fi->last_modify = d->last_modify;
+	fi->access = d->access;
+	fi->name_len = d->name_len;
+	memcpy(fi->name, d->name, d->name_len);
+}
+
+#endif
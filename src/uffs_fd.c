@@ -669,7 +669,32 @@ void uffs_flush_all(const char *mount_point) {
   dev = uffs_GetDeviceFromMountPoint(mount_point);
   if (dev) {
     uffs_BufFlushAll(dev);
+#ifdef CONFIG_TREE_CHECKPOINT
+    uffs_CkptSave(dev);
+#endif
     uffs_PutDevice(dev);
   }
   uffs_GlobalFsLockUnlock();
 }
+
+#ifdef CONFIG_LAZY_MOUNT
+/**
+ * check the data blocks left by lazy mount, could be called from a background
+ * task after mount. return 0 on success, -1 on fail.
+ */
+int uffs_lazy_scan(const char *mount_point) {
+  uffs_Device *dev = NULL;
+  int ret = -1;
+
+  uffs_GlobalFsLockLock();
+  dev = uffs_GetDeviceFromMountPoint(mount_point);
+  if (dev) {
+    if (uffs_TreeResolveAll(dev) == U_SUCC)
+      ret = 0;
+    uffs_PutDevice(dev);
+  }
+  uffs_GlobalFsLockUnlock();
+
+  return ret;
+}
+#endif
@@ -51,35 +51,68 @@ static void ResetFindInfo(uffs_FindInfo *f)
 	f->pos = 0;
 }
 
-static URET _LoadObjectInfo(uffs_Device *dev,
+/** load uffs_FileInfo of object from dentry cache or header page */
+static URET _LoadHeaderInfo(uffs_Device *dev,
 							TreeNode *node,
-							uffs_ObjectInfo *info,
-							int type,
-							int *err)
+							uffs_FileInfo *fi,
+							int type)
 {
 	uffs_Buf *buf;
 
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+	const struct uffs_DentrySt *d;
+	u16 serial = (type == UFFS_TYPE_DIR ? node->u.dir.serial : node->u.file.serial);
+	u16 parent = (type == UFFS_TYPE_DIR ? node->u.dir.parent : node->u.file.parent);
+
+	d = uffs_DcacheFind(dev, type, serial, parent);
+	if (d) {
+		uffs_DcacheLoadInfo(d, fi);
+		return U_SUCC;
+	}
+#endif
+
 	buf = uffs_BufGetEx(dev, (u8)type, node, 0, 0);
+	if (buf == NULL)
+		return U_FAIL;
 
-	if (buf == NULL) {
+	memcpy(fi, buf->data, sizeof(uffs_FileInfo));
+	uffs_BufPut(dev, buf);
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+	uffs_DcachePut(dev, type, serial, parent, fi);
+#endif
+
+	return U_SUCC;
+}
+
+static URET _LoadObjectInfo(uffs_Device *dev,
+							TreeNode *node,
+							uffs_ObjectInfo *info,
+							int type,
+							int *err)
+{
+	if (_LoadHeaderInfo(dev, node, &(info->info), type) != U_SUCC) {
 		if (err)
 			*err = UENOMEM;
 		return U_FAIL;
 	}
 
-	memcpy(&(info->info), buf->data, sizeof(uffs_FileInfo));
-
 	if (type == UFFS_TYPE_DIR) {
 		info->len = 0;
 		info->serial = node->u.dir.serial;
 	}
 	else {
+#ifdef CONFIG_LAZY_MOUNT
+		if (uffs_TreeResolveFile(dev, node) == U_FAIL) {
+			if (err)
+				*err = UEIOERR;
+			return U_FAIL;
+		}
+#endif
 		info->len = node->u.file.len;
 		info->serial = node->u.file.serial;
 	}
 
-	uffs_BufPut(dev, buf);
-
 	return U_SUCC;
 }
 
@@ -193,30 +226,12 @@ static URET do_FindObject(uffs_FindInfo *f, uffs_ObjectInfo *info, u16 x)
 					ret = _LoadObjectInfo(dev, node, info, UFFS_TYPE_DIR, NULL);
 				goto ext;
 			}
-			x = node->hash_next;
-		}
-
-		f->hash++; //come to next hash entry
-
-		for (; f->hash < DIR_NODE_ENTRY_LEN; f->hash++) {
-			x = dev->tree.dir_entry[f->hash];
-			while (x != EMPTY_NODE) {
-				node = FROM_IDX(x, TPOOL(dev));
-				if (node->u.dir.parent == f->serial) {
-					f->work = node;
-					f->pos++;
-					if (info)
-						ret = _LoadObjectInfo(dev, node, info, UFFS_TYPE_DIR, NULL);
-					goto ext;
-				}
-				x = node->hash_next;
-			}
+			x = node->child_next;
 		}
 
 		//no subdirs, then lookup files ..
 		f->step++;
-		f->hash = 0;
-		x = dev->tree.file_entry[f->hash];
+		x = dev->tree.file_child[GET_CHILD_HASH(f->serial)];
 	}
 
 	if (f->step == 1) {
@@ -230,24 +245,7 @@ static URET do_FindObject(uffs_FindInfo *f, uffs_ObjectInfo *info, u16 x)
 					ret = _LoadObjectInfo(dev, node, info, UFFS_TYPE_FILE, NULL);
 				goto ext;
 			}
-			x = node->hash_next;
-		}
-
-		f->hash++; //come to next hash entry
-
-		for (; f->hash < FILE_NODE_ENTRY_LEN; f->hash++) {
-			x = dev->tree.file_entry[f->hash];
-			while (x != EMPTY_NODE) {
-				node = FROM_IDX(x, TPOOL(dev));
-				if (node->u.file.parent == f->serial) {
-					f->work = node;
-					f->pos++;
-					if (info) 
-						ret = _LoadObjectInfo(dev, node, info, UFFS_TYPE_FILE, NULL);
-					goto ext;
-				}
-				x = node->hash_next;
-			}
+			x = node->child_next;
 		}
 
 		//no any files, stopped.
@@ -278,7 +276,7 @@ URET uffs_FindObjectFirst(uffs_ObjectInfo * info, uffs_FindInfo * f)
 
 	uffs_DeviceLock(dev);
 	ResetFindInfo(f);
-	ret = do_FindObject(f, info, dev->tree.dir_entry[0]);
+	ret = do_FindObject(f, info, dev->tree.dir_child[GET_CHILD_HASH(f->serial)]);
 	uffs_DeviceUnLock(dev);
 
 	return ret;
@@ -307,7 +305,7 @@ URET uffs_FindObjectNext(uffs_ObjectInfo *info, uffs_FindInfo * f)
 		return uffs_FindObjectFirst(info, f);
 
 	uffs_DeviceLock(dev);
-	ret = do_FindObject(f, info, f->work->hash_next);
+	ret = do_FindObject(f, info, f->work->child_next);
 	uffs_DeviceUnLock(dev);
 
 	return ret;
@@ -185,6 +185,25 @@ static int CalculateSpareDataSize(uffs_Device *dev)
 	return n + 1;		// plus one seal byte.
 }
 
+static int CalculateSpareTagOffset(uffs_Device *dev)
+{
+	const u8 *p;
+	int tag_size = TAG_STORE_SIZE;
+	int offs = dev->mem.spare_data_size - 1;	// seal byte
+
+	p = dev->attr->data_layout;
+	if (p) {
+		while (*p != 0xFF && tag_size > 0) {
+			if (p[0] < offs)
+				offs = p[0];
+			tag_size -= (p[1] > tag_size ? tag_size : p[1]);
+			p += 2;
+		}
+	}
+
+	return offs;
+}
+
 
 /**
  * Initialize UFFS flash interface
@@ -289,6 +308,7 @@ URET uffs_FlashInterfaceInit(uffs_Device *dev)
 	}
 
 	dev->mem.spare_data_size = CalculateSpareDataSize(dev);
+	dev->mem.spare_tag_offs = CalculateSpareTagOffset(dev);
 	uffs_Perror(UFFS_MSG_NORMAL, "UFFS consume spare data size %d", dev->mem.spare_data_size);
 
 	if (dev->mem.spare_data_size > dev->attr->spare_size) {
@@ -364,6 +384,29 @@ void uffs_FlashUnloadSpare(uffs_Device *dev,
 	}
 }
 
+/** do tag ECC correction if the tag is sealed, return the updated flash status */
+static int FlashTagEccCorrect(uffs_Device *dev, uffs_Tags *tag, int ret)
+{
+	int ret_tmp;
+
+	if (!TAG_IS_SEALED(tag))	// not sealed ? don't try tag ECC correction
+		return ret;
+
+	if (dev->attr->ecc_opt != UFFS_ECC_NONE) {
+		ret_tmp = TagEccCorrect(&tag->s);
+		ret_tmp = (ret_tmp < 0 ? UFFS_FLASH_ECC_FAIL :
+				(ret_tmp > 0 ? UFFS_FLASH_ECC_OK : UFFS_FLASH_NO_ERR));
+
+		if (UFFS_FLASH_HAVE_ERR(ret_tmp) || ret_tmp == UFFS_FLASH_ECC_OK) {
+			// overwrite ret with ret_tmp only when tag ECC failed or corrected bit flip(s),
+			// so that if flash driver has the capability of ECC, the result will propagete to upper level.
+			ret = ret_tmp;
+		}
+	}
+
+	return ret;
+}
+
 /**
  * Read tag from page spare
  *
@@ -386,7 +429,6 @@ int uffs_FlashReadPageTag(uffs_Device *dev,
 	uffs_FlashOps *ops = dev->ops;
 	u8 * spare_buf;
 	int ret = UFFS_FLASH_UNKNOWN_ERR;
-	int ret_tmp;
 
 	spare_buf = (u8 *) uffs_PoolGet(SPOOL(dev));
 	if (spare_buf == NULL)
@@ -400,8 +442,17 @@ int uffs_FlashReadPageTag(uffs_Device *dev,
 		ret = (ret == UFFS_FLASH_NOT_SEALED ? UFFS_FLASH_NO_ERR : ret);	// hide 'not sealed' at this level
 	}
 	else {
-		ret = ops->ReadPage(dev, block, page, NULL, 0, NULL,
+		if (UFFS_FLASH_CAN_READ_SPARE(dev)) {
+			// only tag and seal byte, bytes ahead of tag are not used here
+			int offs = dev->mem.spare_tag_offs;
+			memset(spare_buf, 0xFF, offs);
+			ret = ops->ReadPageSpare(dev, block, page, offs,
+									spare_buf + offs, dev->mem.spare_data_size - offs);
+		}
+		else {
+			ret = ops->ReadPage(dev, block, page, NULL, 0, NULL,
 									spare_buf, dev->mem.spare_data_size);
+		}
 
 		if (tag) {
 			tag->seal_byte = SEAL_BYTE(dev, spare_buf);
@@ -415,23 +466,8 @@ int uffs_FlashReadPageTag(uffs_Device *dev,
 	if (UFFS_FLASH_HAVE_ERR(ret))
 		goto ext;
 
-	if (tag) {
-		if (!TAG_IS_SEALED(tag))	// not sealed ? don't try tag ECC correction
-			goto ext;
-
-		// do tag ecc correction
-		if (dev->attr->ecc_opt != UFFS_ECC_NONE) {
-			ret_tmp = TagEccCorrect(&tag->s);
-			ret_tmp = (ret_tmp < 0 ? UFFS_FLASH_ECC_FAIL :
-					(ret_tmp > 0 ? UFFS_FLASH_ECC_OK : UFFS_FLASH_NO_ERR));
-
-			if (UFFS_FLASH_HAVE_ERR(ret_tmp) || ret_tmp == UFFS_FLASH_ECC_OK) {
-				// overwrite ret with ret_tmp only when tag ECC failed or corrected bit flip(s),
-				// so that if flash driver has the capability of ECC, the result will propagete to upper level.
-				ret = ret_tmp;
-			}
-		}
-	}
+	if (tag)
+		ret = FlashTagEccCorrect(dev, tag, ret);
 
 ext:
 	if (spare_buf)
@@ -451,12 +487,13 @@ ext:
 }
 
 /**
- * Read page data to buf (do ECC error correction if needed)
+ * Read a whole page to memory (do ECC error correction if needed)
  * \param[in] dev uffs device
  * \param[in] block flash block num
  * \param[in] page flash page num of the block
- * \param[out] buf holding the read out data
+ * \param[out] header holding the read out page, mini header followed by data
  * \param[in] skip_ecc skip ecc when reading data from flash
+ * \param[out] tag if not NULL, tag of the page from the same read (not with skip_ecc)
  *
  * \return	#UFFS_FLASH_NO_ERR: success and/or has no flip bits
  *			#UFFS_FLASH_ECC_OK: spare data has flip bits and corrected by ecc
@@ -468,7 +505,8 @@ ext:
  *
  * \note if skip_ecc is U_TRUE, skip CRC as well.
  */
-int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBOOL skip_ecc)
+static int FlashReadPageData(uffs_Device *dev, int block, int page,
+							 u8 *header, UBOOL skip_ecc, uffs_Tags *tag)
 {
 	uffs_FlashOps *ops = dev->ops;
 	struct uffs_StorageAttrSt *attr = dev->attr;
@@ -489,26 +527,36 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 
 	if (ops->ReadPageWithLayout) {
 		if (skip_ecc)
-			ret = ops->ReadPageWithLayout(dev, block, page, buf->header, size, NULL, NULL, NULL);
+			ret = ops->ReadPageWithLayout(dev, block, page, header, size, NULL, NULL, NULL);
 		else
-			ret = ops->ReadPageWithLayout(dev, block, page, buf->header, size, ecc_buf, NULL, ecc_store);
+			ret = ops->ReadPageWithLayout(dev, block, page, header, size, ecc_buf, tag ? &tag->s : NULL, ecc_store);
 	}
 	else {
 		if (skip_ecc)
-			ret = ops->ReadPage(dev, block, page, buf->header, size, NULL, NULL, 0);
+			ret = ops->ReadPage(dev, block, page, header, size, NULL, NULL, 0);
 		else
-			ret = ops->ReadPage(dev, block, page, buf->header, size, ecc_buf, spare, dev->mem.spare_data_size);
+			ret = ops->ReadPage(dev, block, page, header, size, ecc_buf, spare, dev->mem.spare_data_size);
 	}
 
 	if (UFFS_FLASH_HAVE_ERR(ret))
 		goto ext;
 
+	if (tag && !skip_ecc) {
+		if (ops->ReadPageWithLayout) {
+			tag->seal_byte = (ret == UFFS_FLASH_NOT_SEALED ? 0xFF : 0);
+		}
+		else {
+			tag->seal_byte = SEAL_BYTE(dev, spare);
+			uffs_FlashUnloadSpare(dev, spare, &tag->s, NULL);
+		}
+	}
+
 	ret = (ret == UFFS_FLASH_NOT_SEALED ? UFFS_FLASH_NO_ERR : ret);	// hide 'not sealed' at this level
 
 
 #ifdef CONFIG_ENABLE_PAGE_DATA_CRC
 	if (!skip_ecc) {
-		crc_ok = (HEADER(buf)->crc == uffs_crc16sum(buf->data, size - sizeof(struct uffs_MiniHeaderSt)) ? U_TRUE : U_FALSE);
+		crc_ok = (((struct uffs_MiniHeaderSt *)header)->crc == uffs_crc16sum(header + sizeof(struct uffs_MiniHeaderSt), size - sizeof(struct uffs_MiniHeaderSt)) ? U_TRUE : U_FALSE);
 
 		if (crc_ok)
 			goto ext;	// CRC is matched, no need to do ECC correction.
@@ -525,7 +573,7 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 
 	// make ECC for UFFS_ECC_SOFT
 	if (attr->ecc_opt == UFFS_ECC_SOFT && !skip_ecc)
-		uffs_EccMake(buf->header, size, ecc_buf);
+		uffs_EccMake(header, size, ecc_buf);
 
 	// unload ecc_store if driver doesn't do the layout
 	if (ops->ReadPageWithLayout == NULL) {
@@ -536,7 +584,7 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 	// check page data ecc
 	if (!skip_ecc && (dev->attr->ecc_opt == UFFS_ECC_SOFT || dev->attr->ecc_opt == UFFS_ECC_HW)) {
 
-		ret2 = uffs_EccCorrect(buf->header, size, ecc_store, ecc_buf);
+		ret2 = uffs_EccCorrect(header, size, ecc_store, ecc_buf);
 		ret2 = (ret2 < 0 ? UFFS_FLASH_ECC_FAIL :
 				(ret2 > 0 ? UFFS_FLASH_ECC_OK : UFFS_FLASH_NO_ERR));
 
@@ -552,7 +600,7 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 #ifdef CONFIG_ENABLE_PAGE_DATA_CRC
 	if (!skip_ecc && !UFFS_FLASH_HAVE_ERR(ret)) {
 		// Everything seems ok, do CRC check again.
-		if (HEADER(buf)->crc != uffs_crc16sum(buf->data, size - sizeof(struct uffs_MiniHeaderSt))) {
+		if (((struct uffs_MiniHeaderSt *)header)->crc != uffs_crc16sum(header + sizeof(struct uffs_MiniHeaderSt), size - sizeof(struct uffs_MiniHeaderSt))) {
 			ret = UFFS_FLASH_CRC_ERR;
 			goto ext;
 		}
@@ -589,6 +637,76 @@ ext:
 	return ret;
 }
 
+/**
+ * Read a whole page to memory (do ECC error correction if needed)
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page flash page num of the block
+ * \param[out] header holding the read out page, mini header followed by data
+ * \param[in] skip_ecc skip ecc when reading data from flash
+ *
+ * \return same as #FlashReadPageData
+ */
+int uffs_FlashReadPageData(uffs_Device *dev, int block, int page, u8 *header, UBOOL skip_ecc)
+{
+	return FlashReadPageData(dev, block, page, header, skip_ecc, NULL);
+}
+
+/**
+ * Read page data to buf (do ECC error correction if needed)
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page flash page num of the block
+ * \param[out] buf holding the read out data
+ * \param[in] skip_ecc skip ecc when reading data from flash
+ *
+ * \return same as #uffs_FlashReadPageData
+ */
+int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBOOL skip_ecc)
+{
+	return uffs_FlashReadPageData(dev, block, page, buf->header, skip_ecc);
+}
+
+/**
+ * Read whole pages of consecutive pages to memory in one sequence
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page the first flash page num of the block
+ * \param[in] count number of pages
+ * \param[out] header holding the read out pages, header[i] for page (page + i)
+ * \param[out] ret result of each page, same as #uffs_FlashReadPageData
+ *
+ * \return	#UFFS_FLASH_NO_ERR: all pages are read, check ret[] for each page
+ *			#UFFS_FLASH_IO_ERR: I/O error
+ *			#UFFS_FLASH_UNKNOWN_ERR: not supported by flash driver
+ */
+int uffs_FlashReadPageSeq(uffs_Device *dev, int block, int page, int count, u8 **header, int *ret)
+{
+	int x, i;
+
+	if (!UFFS_FLASH_CAN_READ_SEQ(dev))
+		return UFFS_FLASH_UNKNOWN_ERR;
+
+	x = dev->ops->ReadPageSeq(dev, block, page, count, header, dev->com.pg_size, ret);
+	if (UFFS_FLASH_HAVE_ERR(x)) {
+		uffs_Perror(UFFS_MSG_NORMAL, "Read block %d page %d ~ %d I/O error", block, page, page + count - 1);
+		return x;
+	}
+
+	for (i = 0; i < count; i++) {
+#ifdef CONFIG_ENABLE_PAGE_DATA_CRC
+		if (!UFFS_FLASH_HAVE_ERR(ret[i]) &&
+			((struct uffs_MiniHeaderSt *)header[i])->crc !=
+				uffs_crc16sum(header[i] + sizeof(struct uffs_MiniHeaderSt), dev->com.pg_size - sizeof(struct uffs_MiniHeaderSt)))
+			ret[i] = UFFS_FLASH_CRC_ERR;
+#endif
+		if (UFFS_FLASH_HAVE_ERR(ret[i]))
+			uffs_Perror(UFFS_MSG_NORMAL, "Read block %d page %d failed (%d)", block, page + i, ret[i]);
+	}
+
+	return UFFS_FLASH_NO_ERR;
+}
+
 /**
  * make spare from tag and ecc
  *
@@ -638,6 +756,103 @@ void uffs_FlashMakeSpare(uffs_Device *dev,
 	uffs_Assert(SEAL_BYTE(dev, spare) == 0, "Make spare fail!");
 }
 
+#ifdef CONFIG_PAGE_WRITE_VERIFY
+/** read mini header and tag of a page in one read, page data is not transferred */
+static int FlashReadPageHeader(uffs_Device *dev, int block, int page, u8 *header, uffs_Tags *tag)
+{
+	uffs_FlashOps *ops = dev->ops;
+	int size = dev->com.header_size;
+	u8 *spare;
+	int ret;
+
+	if (ops->ReadPageWithLayout) {
+		ret = ops->ReadPageWithLayout(dev, block, page, header, size, NULL, &tag->s, NULL);
+		tag->seal_byte = (ret == UFFS_FLASH_NOT_SEALED ? 0xFF : 0);
+		ret = (ret == UFFS_FLASH_NOT_SEALED ? UFFS_FLASH_NO_ERR : ret);
+	}
+	else {
+		spare = (u8 *) uffs_PoolGet(SPOOL(dev));
+		if (spare == NULL)
+			return UFFS_FLASH_UNKNOWN_ERR;
+
+		ret = ops->ReadPage(dev, block, page, header, size, NULL, spare, dev->mem.spare_data_size);
+		tag->seal_byte = SEAL_BYTE(dev, spare);
+		if (!UFFS_FLASH_HAVE_ERR(ret))
+			uffs_FlashUnloadSpare(dev, spare, &tag->s, NULL);
+
+		uffs_PoolPut(SPOOL(dev), spare);
+	}
+
+	return ret;
+}
+
+/**
+ * read back the page just written, compare it with the mini header,
+ * data and tag written.
+ *
+ * \return	#UFFS_FLASH_BAD_BLK: page or tag mismatch, or can't be read back
+ *			#UFFS_FLASH_IO_ERR: I/O error
+ *			otherwise the result of the read back
+ *
+ * \note CONFIG_PAGE_WRITE_VERIFY_LEVEL decides whether the data is read back,
+ *		 CONFIG_PAGE_WRITE_VERIFY_INTERVAL how often.
+ */
+static int FlashVerifyPage(uffs_Device *dev, int block, int page,
+						   const u8 *header, const u8 *data, uffs_Tags *tag)
+{
+	u8 chk_header[sizeof(struct uffs_MiniHeaderSt)];
+	uffs_Tags chk_tag;
+	int ret;
+#if CONFIG_PAGE_WRITE_VERIFY_LEVEL == UFFS_VERIFY_FULL
+	uffs_Buf *verify_buf;
+#endif
+
+	if (page % CONFIG_PAGE_WRITE_VERIFY_INTERVAL != 0)
+		return UFFS_FLASH_NO_ERR;		// not sampled, program status only
+
+#if CONFIG_PAGE_WRITE_VERIFY_LEVEL == UFFS_VERIFY_FULL
+	verify_buf = uffs_BufClone(dev, NULL);
+	if (verify_buf) {
+		// page and tag from one read
+		ret = FlashReadPageData(dev, block, page, verify_buf->header, U_FALSE, &chk_tag);
+		if (!UFFS_FLASH_HAVE_ERR(ret)) {
+			memcpy(chk_header, verify_buf->header, dev->com.header_size);
+			if (memcmp(data, verify_buf->data, dev->com.pg_data_size) != 0)
+				ret = UFFS_FLASH_BAD_BLK;
+		}
+		uffs_BufFreeClone(dev, verify_buf);
+	}
+	else {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Insufficient buf, clone buf failed.");
+		ret = FlashReadPageHeader(dev, block, page, chk_header, &chk_tag);
+	}
+#else
+	ret = FlashReadPageHeader(dev, block, page, chk_header, &chk_tag);
+#endif
+
+	if (ret == UFFS_FLASH_IO_ERR)
+		return ret;
+
+	if (UFFS_FLASH_HAVE_ERR(ret) ||
+		memcmp(header, chk_header, dev->com.header_size) != 0) {
+		uffs_Perror(UFFS_MSG_NORMAL,
+					"Page write verify failed (block %d page %d)",
+					block, page);
+		return UFFS_FLASH_BAD_BLK;
+	}
+
+	ret = FlashTagEccCorrect(dev, &chk_tag, ret);
+	if (UFFS_FLASH_HAVE_ERR(ret) ||
+		memcmp(&tag->s, &chk_tag.s, sizeof(uffs_TagStore)) != 0) {
+		uffs_Perror(UFFS_MSG_NORMAL, "Page tag write verify failed (block %d page %d)",
+					block, page);
+		return UFFS_FLASH_BAD_BLK;
+	}
+
+	return ret;
+}
+#endif
+
 /**
  * write the whole page, include data and tag
  *
@@ -663,11 +878,11 @@ int uffs_FlashWritePageCombine(uffs_Device *dev,
 	struct uffs_MiniHeaderSt *header;
 	int ret = UFFS_FLASH_UNKNOWN_ERR;
 	UBOOL is_bad = U_FALSE;
-	uffs_Buf *verify_buf;
-#ifdef CONFIG_PAGE_WRITE_VERIFY
-	uffs_Tags chk_tag;
-#endif
 	
+#ifdef CONFIG_TREE_CHECKPOINT
+	uffs_CkptJournalAdd(dev, block);
+#endif
+
 	spare = (u8 *) uffs_PoolGet(SPOOL(dev));
 	if (spare == NULL)
 		goto ext;
@@ -724,40 +939,87 @@ int uffs_FlashWritePageCombine(uffs_Device *dev,
 		goto ext;
 
 #ifdef CONFIG_PAGE_WRITE_VERIFY
-	verify_buf = uffs_BufClone(dev, NULL);
-	if (verify_buf) {
-		ret = uffs_FlashReadPage(dev, block, page, verify_buf, U_FALSE);
-		if (!UFFS_FLASH_HAVE_ERR(ret)) {
-			if (memcmp(buf->header, verify_buf->header, size) != 0) {
-				uffs_Perror(UFFS_MSG_NORMAL,
-							"Page write verify failed (block %d page %d)",
-							block, page);
-				ret = UFFS_FLASH_BAD_BLK;
-			}
-		}
+	ret = FlashVerifyPage(dev, block, page, buf->header, buf->data, tag);
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret))
+		is_bad = U_TRUE;
+#endif
+ext:
+	if (is_bad)
+		ret = UFFS_FLASH_BAD_BLK;
 
-		if (UFFS_FLASH_IS_BAD_BLOCK(ret))
-			is_bad = U_TRUE;
+	if (spare)
+		uffs_PoolPut(SPOOL(dev), spare);
 
-		uffs_BufFreeClone(dev, verify_buf);
-	}
-	else {
-		uffs_Perror(UFFS_MSG_SERIOUS, "Insufficient buf, clone buf failed.");
-	}
+	return ret;
+}
+
+/**
+ * write a full page of data straight from memory, the mini header
+ * and spare are made by UFFS.
+ *
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page flash page num of the block
+ * \param[in] data page data, dev->com.pg_data_size bytes
+ * \param[in] tag tag to be written to spare
+ *
+ * \return same as #uffs_FlashWritePageCombine,
+ *			#UFFS_FLASH_UNKNOWN_ERR if driver can't write page directly.
+ *
+ * \note see #UFFS_FLASH_CAN_WRITE_DIRECT
+ */
+int uffs_FlashWritePageDirect(uffs_Device *dev, int block, int page, const u8 *data, uffs_Tags *tag)
+{
+	uffs_FlashOps *ops = dev->ops;
+	int size = dev->com.pg_data_size;
+	struct uffs_MiniHeaderSt header;
+	u8 *spare;
+	int ret = UFFS_FLASH_UNKNOWN_ERR;
+	UBOOL is_bad = U_FALSE;
+
+	if (!UFFS_FLASH_CAN_WRITE_DIRECT(dev))
+		return UFFS_FLASH_UNKNOWN_ERR;
+
+#ifdef CONFIG_TREE_CHECKPOINT
+	uffs_CkptJournalAdd(dev, block);
+#endif
+
+	spare = (u8 *) uffs_PoolGet(SPOOL(dev));
+	if (spare == NULL)
+		goto ext;
+
+	// setup header
+	memset(&header, 0xFF, sizeof(struct uffs_MiniHeaderSt));
+	header.status = 0;
+#ifdef CONFIG_ENABLE_PAGE_DATA_CRC
+	header.crc = uffs_crc16sum(data, size);
+#endif
+
+	// setup tag
+	TAG_DIRTY_BIT(tag) = TAG_DIRTY;		//!< set dirty bit
+	TAG_VALID_BIT(tag) = TAG_VALID;		//!< set valid bit
+	SEAL_TAG(tag);						//!< seal tag (the real seal byte will be set in uffs_FlashMakeSpare())
+
+	if (dev->attr->ecc_opt != UFFS_ECC_NONE)
+		TagMakeEcc(&tag->s);
+	else
+		tag->s.tag_ecc = TAG_ECC_DEFAULT;
+
+	uffs_FlashMakeSpare(dev, &tag->s, NULL, spare);
+
+	ret = ops->WritePageDirect(dev, block, page, (u8 *)&header, sizeof(struct uffs_MiniHeaderSt),
+								data, size, spare, dev->mem.spare_data_size);
+
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret))
+		is_bad = U_TRUE;
 
-	ret = uffs_FlashReadPageTag(dev, block, page, &chk_tag);
 	if (UFFS_FLASH_HAVE_ERR(ret))
 		goto ext;
-	
-	if (memcmp(&tag->s, &chk_tag.s, sizeof(uffs_TagStore)) != 0) {
-		uffs_Perror(UFFS_MSG_NORMAL, "Page tag write verify failed (block %d page %d)",
-					block, page);
-		ret = UFFS_FLASH_BAD_BLK;
-	}
 
+#ifdef CONFIG_PAGE_WRITE_VERIFY
+	ret = FlashVerifyPage(dev, block, page, (u8 *)&header, data, tag);
 	if (UFFS_FLASH_IS_BAD_BLOCK(ret))
 		is_bad = U_TRUE;
-	
 #endif
 ext:
 	if (is_bad)
@@ -769,6 +1031,41 @@ ext:
 	return ret;
 }
 
+/**
+ * Start or stop pipelining page writes to a block
+ * by calling uffs_FlashOpsSt::WritePipeline().
+ *
+ * \param[in] dev uffs device
+ * \param[in] block the block to be written, when starting
+ * \param[in] on U_TRUE to start, U_FALSE to stop
+ *
+ * \return	#UFFS_FLASH_NO_ERR: success
+ *			#UFFS_FLASH_IO_ERR: I/O error
+ *			#UFFS_FLASH_BAD_BLK: the last page written failed (when stopping)
+ *
+ * \note does nothing if every page written is read back to verify.
+ */
+int uffs_FlashWritePipeline(uffs_Device *dev, int block, UBOOL on)
+{
+	if (dev->ops->WritePipeline == NULL)
+		return UFFS_FLASH_NO_ERR;
+
+#if defined(CONFIG_PAGE_WRITE_VERIFY) && CONFIG_PAGE_WRITE_VERIFY_INTERVAL == 1
+	// every page is read back right after write, nothing to overlap
+	(void)block;
+	(void)on;
+	return UFFS_FLASH_NO_ERR;
+#else
+#ifdef CONFIG_TREE_CHECKPOINT
+	// journal the block now, the journal page must not be left programming
+	if (on)
+		uffs_CkptJournalAdd(dev, block);
+#endif
+
+	return dev->ops->WritePipeline(dev, on);
+#endif
+}
+
 /** Mark this block as bad block */
 URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 {
@@ -777,6 +1074,10 @@ URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 
 	uffs_Perror(UFFS_MSG_NORMAL, "Mark bad block: %d", block);
 
+#ifdef CONFIG_TREE_CHECKPOINT
+	uffs_CkptJournalAdd(dev, block);
+#endif
+
 	// Remove it from pending list if it's in there
 	uffs_BadBlockPendingRemove(dev, block);
 
@@ -801,6 +1102,21 @@ URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 	return ret == UFFS_FLASH_NO_ERR ? U_SUCC : U_FAIL;
 }
 
+/** read bad block status byte of a page, return 0xFF if it can't be read */
+static u8 FlashReadStatusByte(uffs_Device *dev, int block, int page)
+{
+	u8 status = 0xFF;
+	int ret;
+
+	ret = dev->ops->ReadPageSpare(dev, block, page, dev->attr->block_status_offs, &status, 1);
+	if (ret == UFFS_FLASH_BAD_BLK)
+		status = 0;
+	else if (UFFS_FLASH_HAVE_ERR(ret))
+		status = 0xFF;
+
+	return status;
+}
+
 /** Is this block a bad block ? */
 UBOOL uffs_FlashIsBadBlock(uffs_Device *dev, int block)
 {
@@ -811,6 +1127,11 @@ UBOOL uffs_FlashIsBadBlock(uffs_Device *dev, int block)
 		/* if flash driver provide 'IsBadBlock' function, call it */
 		ret = (ops->IsBadBlock(dev, block) == 0 ? U_FALSE : U_TRUE);
 	}
+	else if (UFFS_FLASH_CAN_READ_SPARE(dev)) {
+		/* read the bad block status byte only, of the first and the second page */
+		ret = (FlashReadStatusByte(dev, block, 0) != 0xFF ||
+				FlashReadStatusByte(dev, block, 1) != 0xFF ? U_TRUE : U_FALSE);
+	}
 	else {
 		/* otherwise we call ReadPage[WithLayout]() to get bad block status byte */
 		/* check the first page */
@@ -841,6 +1162,86 @@ UBOOL uffs_FlashIsBadBlock(uffs_Device *dev, int block)
 	return ret;
 }
 
+/**
+ * Read bad block status, page 0 tag and page 0 mini header of a block
+ * in one batch by calling uffs_FlashOpsSt::ScanBlockMeta().
+ * If driver provides IsBadBlock(), the status bytes of page 1 are not read.
+ *
+ * \param[in] dev uffs device
+ * \param[in] bc block info, page 0 tag is loaded to it on success
+ * \param[out] header mini header of page 0
+ *
+ * \return	#UFFS_FLASH_NO_ERR: success
+ *			#UFFS_FLASH_ECC_OK: page 0 tag has flip bits and corrected by ecc
+ *			#UFFS_FLASH_BAD_BLK: this is a bad block
+ *			#UFFS_FLASH_UNKNOWN_ERR: driver does not support batch scanning,
+ *				or the spare is not in the UFFS layout
+ *			other flash errors, caller should fall back to read page by page.
+ */
+int uffs_FlashScanBlockMeta(uffs_Device *dev, uffs_BlockInfo *bc,
+							struct uffs_MiniHeaderSt *header)
+{
+	static const u32 pages[] = {0, 1};	// bad block status byte is on page 0 and 1
+	struct uffs_MiniHeaderSt headers[2];
+	uffs_PageSpare *spare;
+	int size = dev->mem.spare_data_size;
+	int s = dev->attr->block_status_offs;
+	int count = 2;
+	u8 *spare_buf;
+	int ret, i;
+
+	if (dev->ops->ScanBlockMeta == NULL ||
+		dev->attr->layout_opt != UFFS_LAYOUT_UFFS ||
+		size * 2 > UFFS_MAX_SPARE_SIZE)
+		return UFFS_FLASH_UNKNOWN_ERR;
+
+	if (dev->ops->IsBadBlock) {
+		// driver keeps bad block table, only page 0 is needed.
+		if (dev->ops->IsBadBlock(dev, bc->block) != 0)
+			return UFFS_FLASH_BAD_BLK;
+		count = 1;
+	}
+
+	spare_buf = (u8 *) uffs_PoolGet(SPOOL(dev));
+	if (spare_buf == NULL)
+		return UFFS_FLASH_UNKNOWN_ERR;
+
+	ret = dev->ops->ScanBlockMeta(dev, bc->block, pages, count,
+								(u8 *)headers, sizeof(struct uffs_MiniHeaderSt),
+								spare_buf, size);
+
+	dev->st.spare_read_count += count;
+	dev->st.page_header_read_count++;
+
+	if (UFFS_FLASH_HAVE_ERR(ret))
+		goto ext;
+
+	for (i = 0; i < count; i++) {
+		if (spare_buf[i * size + s] != 0xFF) {
+			ret = UFFS_FLASH_BAD_BLK;
+			goto ext;
+		}
+	}
+
+	spare = &(bc->spares[0]);
+	spare->tag.seal_byte = SEAL_BYTE(dev, spare_buf);
+	uffs_FlashUnloadSpare(dev, spare_buf, &(spare->tag.s), NULL);
+	ret = FlashTagEccCorrect(dev, &(spare->tag), ret);
+	if (UFFS_FLASH_HAVE_ERR(ret))
+		goto ext;
+
+	if (spare->expired) {
+		spare->expired = 0;
+		bc->expired_count--;
+	}
+	memcpy(header, &headers[0], sizeof(struct uffs_MiniHeaderSt));
+
+ext:
+	uffs_PoolPut(SPOOL(dev), spare_buf);
+
+	return ret;
+}
+
 /**
  * Erase flash block
  * \param[in] dev uffs device
@@ -852,6 +1253,10 @@ int uffs_FlashEraseBlock(uffs_Device *dev, int block)
 	int ret;
 	uffs_BlockInfo *bc;
 
+#ifdef CONFIG_TREE_CHECKPOINT
+	uffs_CkptJournalAdd(dev, block);
+#endif
+
 	// this block is about to be erased, so remove it from pending list if it's added before
 	uffs_BadBlockPendingRemove(dev, block);
 
@@ -73,6 +73,9 @@ typedef enum {
 
 static void do_ReleaseObjectResource(uffs_Object *obj);
 static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt);
+#ifdef CONFIG_FILE_EXTENTS
+static void do_ReleaseExtents(uffs_Object *obj);
+#endif
 
 static int _object_data[(sizeof(struct uffs_ObjectSt) * MAX_OBJECT_HANDLE) /
                         sizeof(int)];
@@ -326,6 +329,12 @@ URET uffs_CreateObjectEx(uffs_Object *obj, uffs_Device *dev, int dir,
     if (obj->node) {
       /* file already exist, truncate it to zero length */
       obj->serial = GET_OBJ_NODE_SERIAL(obj);
+#ifdef CONFIG_LAZY_MOUNT
+      if (uffs_TreeResolveFile(obj->dev, obj->node) == U_FAIL) {
+        obj->err = UEIOERR;
+        goto ext_1;
+      }
+#endif
       obj->open_succ = U_TRUE; // set open_succ to U_TRUE before
                                // call do_TruncateObject()
       if (do_TruncateObject(obj, 0, eDRY_RUN) == U_SUCC)
@@ -496,6 +505,16 @@ URET uffs_OpenObjectEx(uffs_Object *obj, uffs_Device *dev, int dir,
   }
 
   obj->serial = GET_OBJ_NODE_SERIAL(obj);
+
+#ifdef CONFIG_LAZY_MOUNT
+  // the file length is not known until the data blocks are checked
+  if (obj->type == UFFS_TYPE_FILE &&
+      uffs_TreeResolveFile(obj->dev, obj->node) == U_FAIL) {
+    obj->err = UEIOERR;
+    goto ext_1;
+  }
+#endif
+
   obj->open_succ = U_TRUE;
 
   if (obj->oflag & UO_TRUNC)
@@ -592,6 +611,9 @@ static void do_ReleaseObjectResource(uffs_Object *obj) {
       if (obj->dev_lock_count > 0) {
         uffs_ObjectDevUnLock(obj);
       }
+#ifdef CONFIG_FILE_EXTENTS
+      do_ReleaseExtents(obj);
+#endif
       uffs_PutDevice(obj->dev);
       obj->dev = NULL;
       obj->open_succ = U_FALSE;
@@ -748,6 +770,163 @@ static u32 GetStartOfDataBlock(uffs_Object *obj, u16 fdn) {
   }
 }
 
+#ifdef CONFIG_FILE_EXTENTS
+#define EXTENT_TABLE_MIN 16
+
+static void do_ReleaseExtents(uffs_Object *obj) {
+  if (obj->extents && obj->dev->mem.free)
+    obj->dev->mem.free(obj->dev, obj->extents);
+  obj->extents = NULL;
+  obj->extent_cap = 0;
+}
+
+/**
+ * make room for fdn in the extent table, the table grows by doubling.
+ * \return U_FAIL if memory is not available, the table is kept as is.
+ */
+static URET do_GrowExtents(uffs_Object *obj, u16 fdn) {
+  uffs_Device *dev = obj->dev;
+  u32 cap = obj->extent_cap ? obj->extent_cap : EXTENT_TABLE_MIN;
+  u16 *ext;
+
+  // without free() the old table would be lost on every grow
+  if (dev->mem.malloc == NULL || dev->mem.free == NULL)
+    return U_FAIL;
+
+  while (cap <= fdn)
+    cap <<= 1;
+  if (cap > MAX_UFFS_FDN + 1)
+    cap = MAX_UFFS_FDN + 1;
+
+  ext = (u16 *)dev->mem.malloc(dev, cap * sizeof(u16));
+  if (ext == NULL)
+    return U_FAIL;
+
+  memset(ext, 0xFF, cap * sizeof(u16)); // EMPTY_NODE
+  if (obj->extents) {
+    memcpy(ext, obj->extents, obj->extent_cap * sizeof(u16));
+    dev->mem.free(dev, obj->extents);
+  }
+  obj->extents = ext;
+  obj->extent_cap = (u16)cap;
+
+  return U_SUCC;
+}
+#endif
+
+/**
+ * find the data node of block fdn (> 0) of an openned file.
+ *
+ * With CONFIG_FILE_EXTENTS, nodes found in the tree are kept in the object's
+ * extent table. The table is dropped whenever a DATA node leaves the tree
+ * (truncate, delete, block replaced on mount), nodes moved to a new block by
+ * recover keep their index and stay valid.
+ */
+static TreeNode *do_FindDataNode(uffs_Object *obj, u16 fdn) {
+  uffs_Device *dev = obj->dev;
+  u16 serial = obj->node->u.file.serial;
+  TreeNode *node;
+
+#ifdef CONFIG_FILE_EXTENTS
+  if (obj->extent_gen != dev->tree.data_gen) {
+    if (obj->extents)
+      memset(obj->extents, 0xFF, obj->extent_cap * sizeof(u16));
+    obj->extent_gen = dev->tree.data_gen;
+  }
+
+  if (fdn < obj->extent_cap && obj->extents[fdn] != EMPTY_NODE) {
+    node = FROM_IDX(obj->extents[fdn], &(dev->mem.tree_pool));
+    if (node->u.data.parent == serial && node->u.data.serial == fdn)
+      return node;
+  }
+#endif
+
+  node = uffs_TreeFindDataNode(dev, serial, fdn);
+
+#ifdef CONFIG_FILE_EXTENTS
+  if (node && (fdn < obj->extent_cap || do_GrowExtents(obj, fdn) == U_SUCC))
+    obj->extents[fdn] = TO_IDX(node, &(dev->mem.tree_pool));
+#endif
+
+  return node;
+}
+
+#ifdef CONFIG_DIRECT_WRITE
+/**
+ * program a whole page appended to the file straight from the caller's
+ * buffer, to the next free page of the block.
+ *
+ * \return U_SUCC if the page is written, U_FAIL if the page has to be
+ *         written through page buffers (no free page, flash error ...).
+ */
+static URET do_WritePageDirect(uffs_Object *obj, TreeNode *node, u8 type,
+                               u16 parent, u16 serial, u16 page_id,
+                               const u8 *data) {
+  uffs_Device *dev = obj->dev;
+  uffs_BlockInfo *bc;
+  uffs_Tags *tag;
+  u16 block, page;
+  URET ret = U_FAIL;
+  int x;
+
+  if (!UFFS_FLASH_CAN_WRITE_DIRECT(dev))
+    return U_FAIL;
+
+  // a cached page with the same id would shadow the new page
+  if (uffs_BufFind(dev, parent, serial, page_id) != NULL)
+    return U_FAIL;
+
+  // pages of this block staged before must go to flash first
+  if (uffs_BufFindGroupSlot(dev, parent, serial) >= 0 &&
+      uffs_BufFlushGroup(dev, parent, serial) != U_SUCC)
+    return U_FAIL;
+
+  // flush might move the data to a new block, get the block after it
+  block = (type == UFFS_TYPE_FILE ? node->u.file.block : node->u.data.block);
+  bc = uffs_BlockInfoGet(dev, block);
+  if (bc == NULL)
+    return U_FAIL;
+
+  if (uffs_BlockInfoLoad(dev, bc, UFFS_ALL_PAGES) != U_SUCC)
+    goto ext;
+
+  // page 0 won't be a free page, so we start from 1.
+  for (page = 1; page < dev->attr->pages_per_block; page++) {
+    if (uffs_IsPageErased(dev, bc, page))
+      break;
+  }
+  if (page == dev->attr->pages_per_block)
+    goto ext; // no free page, let buffer flush do the block recover
+
+  tag = GET_TAG(bc, page);
+  TAG_DIRTY_BIT(tag) = TAG_DIRTY;
+  TAG_VALID_BIT(tag) = TAG_VALID;
+  TAG_BLOCK_TS(tag) = uffs_GetBlockTimeStamp(dev, bc);
+  TAG_DATA_LEN(tag) = dev->com.pg_data_size;
+  TAG_TYPE(tag) = type;
+  TAG_PARENT(tag) = parent;
+  TAG_SERIAL(tag) = serial;
+  TAG_PAGE_ID(tag) = page_id;
+  SEAL_TAG(tag);
+
+  x = uffs_FlashWritePageDirect(dev, block, page, data, tag);
+  if (UFFS_FLASH_HAVE_ERR(x)) {
+    uffs_Perror(UFFS_MSG_NORMAL,
+                "direct write block %d page %d fail (%d), use page buffer",
+                block, page, x);
+    uffs_BlockInfoExpire(dev, bc, page);
+    uffs_BadBlockAddByFlashResult(dev, block, x);
+  } else {
+    ret = U_SUCC;
+  }
+
+ext:
+  uffs_BlockInfoPut(dev, bc);
+
+  return ret;
+}
+#endif
+
 static int do_WriteNewBlock(uffs_Object *obj, const void *data, u32 len,
                             u16 parent, u16 serial) {
   uffs_Device *dev = obj->dev;
@@ -757,6 +936,14 @@ static int do_WriteNewBlock(uffs_Object *obj, const void *data, u32 len,
   uffs_Buf *buf;
   URET ret;
 
+#ifdef CONFIG_DIRECT_WRITE
+  // stage only the first page to create the block, the following
+  // whole pages are programmed directly by do_WriteInternalBlock()
+  if (data != NULL && UFFS_FLASH_CAN_WRITE_DIRECT(dev) &&
+      len > dev->com.pg_data_size)
+    len = dev->com.pg_data_size;
+#endif
+
   for (page_id = 0; page_id < dev->attr->pages_per_block; page_id++) {
     size = (len - wroteSize) > dev->com.pg_data_size ? dev->com.pg_data_size
                                                      : len - wroteSize;
@@ -827,6 +1014,18 @@ static int do_WriteInternalBlock(uffs_Object *obj, TreeNode *node, u16 fdn,
                ? (dev->com.pg_data_size - pageOfs)
                : (len - wroteSize);
 
+#ifdef CONFIG_DIRECT_WRITE
+    if (data != NULL && pageOfs == 0 && size == dev->com.pg_data_size &&
+        (blockOfs + block_start) == obj->node->u.file.len &&
+        do_WritePageDirect(obj, node, type, parent, serial, page_id,
+                           (const u8 *)data + wroteSize) == U_SUCC) {
+      wroteSize += size;
+      blockOfs += size;
+      obj->node->u.file.len = block_start + blockOfs;
+      continue;
+    }
+#endif
+
     if ((obj->node->u.file.len % dev->com.pg_data_size) == 0 &&
         (blockOfs + block_start) == obj->node->u.file.len) {
 
@@ -920,7 +1119,7 @@ static int do_WriteObject(uffs_Object *obj, const void *data, int len) {
       if (fdn == 0)
         dnode = obj->node;
       else
-        dnode = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+        dnode = do_FindDataNode(obj, fdn);
 
       if (dnode == NULL) {
         uffs_Perror(UFFS_MSG_SERIOUS, "can't find data node in tree ?");
@@ -1020,6 +1219,67 @@ ext:
   return wrote;
 }
 
+/**
+ * read a whole page of data straight to the caller's buffer,
+ * bypassing page buffers.
+ *
+ * The mini header is loaded to the header_size bytes before \a data,
+ * these bytes belong to the caller and are restored after reading.
+ *
+ * \return U_SUCC if the page is read, U_FAIL if the page has to be read
+ *         through page buffers (cached, not a full page or flash error).
+ */
+static URET do_ReadPageDirect(uffs_Object *obj, u8 type, TreeNode *dnode,
+                              u16 page_id, u8 *data) {
+  uffs_Device *dev = obj->dev;
+  u8 save[sizeof(struct uffs_MiniHeaderSt)];
+  u8 *header = data - dev->com.header_size;
+  u16 parent, serial, block, page;
+  uffs_BlockInfo *bc;
+  URET ret = U_FAIL;
+  int x;
+
+  if (type == UFFS_TYPE_FILE) {
+    parent = dnode->u.file.parent;
+    serial = dnode->u.file.serial;
+    block = dnode->u.file.block;
+  } else {
+    parent = dnode->u.data.parent;
+    serial = dnode->u.data.serial;
+    block = dnode->u.data.block;
+  }
+
+  // cached page might be newer than the one on flash
+  if (uffs_BufFind(dev, parent, serial, page_id) != NULL)
+    return U_FAIL;
+
+  bc = uffs_BlockInfoGet(dev, block);
+  if (bc == NULL)
+    return U_FAIL;
+
+  page = uffs_FindPageInBlockWithPageId(dev, bc, page_id);
+  if (page != UFFS_INVALID_PAGE)
+    page = uffs_FindBestPageInBlock(dev, bc, page);
+
+  if (page != UFFS_INVALID_PAGE &&
+      TAG_DATA_LEN(GET_TAG(bc, page)) == dev->com.pg_data_size) {
+    memcpy(save, header, sizeof(save));
+    x = uffs_FlashReadPageData(dev, block, page, header,
+                               obj->oflag & UO_NOECC ? U_TRUE : U_FALSE);
+    memcpy(header, save, sizeof(save));
+
+    // on error, let the page buffer path read it again and handle it
+    if (!UFFS_FLASH_HAVE_ERR(x)) {
+      uffs_BadBlockAddByFlashResult(dev, block, x);
+      ret = U_SUCC;
+    }
+  }
+
+  uffs_BlockInfoPut(dev, bc);
+
+  return ret;
+}
+
 /**
  * read data from obj
  *
@@ -1042,6 +1302,9 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
   u16 page_id;
   u8 type;
   u32 pageOfs;
+#if CONFIG_READ_AHEAD_PAGES > 0
+  UBOOL sequential;
+#endif
 
   if (obj == NULL)
     return 0;
@@ -1070,6 +1333,10 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
 
   uffs_ObjectDevLock(obj);
 
+#if CONFIG_READ_AHEAD_PAGES > 0
+  sequential = (obj->pos == obj->ra_pos ? U_TRUE : U_FALSE);
+#endif
+
   while (remain > 0) {
     read_start = obj->pos + len - remain;
     if (read_start >= fnode->u.file.len) {
@@ -1083,7 +1350,7 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
       type = UFFS_TYPE_FILE;
     } else {
       type = UFFS_TYPE_DATA;
-      dnode = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+      dnode = do_FindDataNode(obj, fdn);
       if (dnode == NULL) {
         uffs_Perror(UFFS_MSG_SERIOUS, "can't get data node in entry!");
         obj->err = UEUNKNOWN_ERR;
@@ -1102,6 +1369,25 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
       page_id++;
     }
 
+    pageOfs = read_start % dev->com.pg_data_size;
+    if (pageOfs == 0 && remain >= dev->com.pg_data_size &&
+        len - remain >= dev->com.header_size &&
+        read_start + dev->com.pg_data_size <= fnode->u.file.len) {
+      // whole page wanted, read it without going through page buffers
+      if (do_ReadPageDirect(obj, type, dnode, (u16)page_id,
+                            (u8 *)data + len - remain) == U_SUCC) {
+        remain -= dev->com.pg_data_size;
+        continue;
+      }
+    }
+
+#if CONFIG_READ_AHEAD_PAGES > 0
+    // sequential reader missed the cache, load the following pages as well
+    if (sequential)
+      uffs_BufReadAhead(dev, type, dnode, (u16)page_id,
+                        CONFIG_READ_AHEAD_PAGES);
+#endif
+
     buf = uffs_BufGetEx(dev, type, dnode, (u16)page_id, obj->oflag);
     if (buf == NULL) {
       uffs_Perror(UFFS_MSG_SERIOUS, "can't get buffer when read obj.");
@@ -1109,7 +1395,6 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
       break;
     }
 
-    pageOfs = read_start % dev->com.pg_data_size;
     if (pageOfs >= buf->data_len) {
       // uffs_Perror(UFFS_MSG_NOISY, "read data out of page range ?");
       uffs_BufPut(dev, buf);
@@ -1125,6 +1410,9 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len) {
   }
 
   obj->pos += (len - remain);
+#if CONFIG_READ_AHEAD_PAGES > 0
+  obj->ra_pos = obj->pos;
+#endif
 
   if (HAVE_BADBLOCK(dev))
     uffs_BadBlockRecover(dev);
@@ -1249,7 +1537,7 @@ static URET do_TruncateInternalWithBlockRecover(uffs_Object *obj, u16 fdn,
     serial = node->u.file.serial;
     block = node->u.file.block;
   } else {
-    node = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+    node = do_FindDataNode(obj, fdn);
     if (node == NULL) {
       obj->err = UEIOERR;
       uffs_Perror(UFFS_MSG_SERIOUS, "can't find data node when truncate obj");
@@ -1422,7 +1710,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain,
 
       block_start = GetStartOfDataBlock(obj, fdn);
       if (remain <= block_start && fdn > 0) {
-        node = uffs_TreeFindDataNode(dev, obj->serial, fdn);
+        node = do_FindDataNode(obj, fdn);
         if (node == NULL) {
           uffs_Perror(UFFS_MSG_SERIOUS,
                       "can't find data node when trancate obj.");
@@ -1626,6 +1914,9 @@ URET uffs_DeleteObject(const char *name, int *err) {
                      : 0);
 
   uffs_BreakFromEntry(dev, obj->type, node);
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+  uffs_DcacheInvalidate(dev, obj->serial);
+#endif
   node->u.list.block = block;
   uffs_TreeEraseNode(dev, node);
 
@@ -1719,6 +2010,9 @@ URET uffs_MoveObjectEx(uffs_Object *obj, int new_parent, const char *new_name,
     fi.last_modify = uffs_GetCurDateTime();
 
     buf->parent = new_parent; // !! need to manually change the 'parent' !!
+    uffs_BufRehash(dev, buf);
+    // move the node before the block recover writes the new parent to it
+    uffs_TreeSetNodeParent(dev, obj->type, node, new_parent);
     uffs_BufWrite(dev, buf, &fi, 0, sizeof(uffs_FileInfo));
     uffs_BufPut(dev, buf);
 
@@ -1733,13 +2027,11 @@ URET uffs_MoveObjectEx(uffs_Object *obj, int new_parent, const char *new_name,
   }
 
   // update the check sum and new parent of tree node
-  if (obj->type == UFFS_TYPE_DIR) {
+  if (obj->type == UFFS_TYPE_DIR)
     obj->node->u.dir.checksum = obj->sum;
-    obj->node->u.dir.parent = new_parent;
-  } else {
+  else
     obj->node->u.file.checksum = obj->sum;
-    obj->node->u.file.parent = new_parent;
-  }
+  uffs_TreeSetNodeParent(dev, obj->type, obj->node, new_parent);
 
 ext_1:
   uffs_ObjectDevUnLock(obj);
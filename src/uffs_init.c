@@ -112,6 +112,10 @@ URET uffs_InitDevice(uffs_Device *dev) {
     goto fail;
   }
 
+#ifdef CONFIG_TREE_CHECKPOINT
+  uffs_CkptInit(dev);
+#endif
+
   uffs_Perror(UFFS_MSG_NOISY, "init page buf");
   ret = uffs_BufInit(dev, dev->cfg.page_buffers, dev->cfg.dirty_pages);
   if (ret != U_SUCC) {
@@ -128,6 +132,10 @@ URET uffs_InitDevice(uffs_Device *dev) {
     goto fail;
   }
 
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+  uffs_DcacheInit(dev);
+#endif
+
   ret = uffs_BuildTree(dev);
   if (ret != U_SUCC) {
     goto fail;
@@ -144,6 +152,12 @@ fail:
 URET uffs_ReleaseDevice(uffs_Device *dev) {
   URET ret;
 
+#ifdef CONFIG_TREE_CHECKPOINT
+  // save the tree, so that the next mount doesn't need to scan all blocks
+  uffs_BufFlushAll(dev);
+  uffs_CkptSave(dev);
+#endif
+
   ret = uffs_BlockInfoReleaseCache(dev);
   if (ret != U_SUCC) {
     uffs_Perror(UFFS_MSG_SERIOUS, "fail to release block info.");
@@ -162,6 +176,14 @@ URET uffs_ReleaseDevice(uffs_Device *dev) {
     goto ext;
   }
 
+#ifdef CONFIG_TREE_CHECKPOINT
+  uffs_CkptRelease(dev);
+#endif
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+  uffs_DcacheRelease(dev);
+#endif
+
   ret = uffs_FlashInterfaceRelease(dev);
   if (ret != U_SUCC) {
     uffs_Perror(UFFS_MSG_SERIOUS, "fail to release tree buffers!");
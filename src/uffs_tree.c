@@ -54,6 +54,12 @@ static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node);
 static void uffs_InsertToDataEntry(uffs_Device *dev, TreeNode *node);
 
 static TreeNode * uffs_TreeGetErasedNodeNoCheck(uffs_Device *dev);
+static TreeNode * _TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial);
+
+#ifdef CONFIG_LAZY_MOUNT
+static URET _ScanAndFixUnCleanPage(uffs_Device *dev, uffs_BlockInfo *bc);
+static URET _TreeCheckLazyData(uffs_Device *dev, TreeNode *node, UBOOL *erased);
+#endif
 
 
 struct BlockTypeStatSt {
@@ -62,6 +68,69 @@ struct BlockTypeStatSt {
 	int data;
 };
 
+/* block map entry: search region code (0: no owner) and node index */
+#define BLOCK_MAP_IDX_MASK		0x1fff
+#define BLOCK_MAP_REGION_SHIFT	13
+
+/** SEARCH_REGION_XXX bit to region code 1..5 */
+static u16 _BlockMapCode(int region)
+{
+	u16 code = 1;
+
+	while ((1 << (code - 1)) < region)
+		code++;
+
+	return code;
+}
+
+/** record [node] in [region] as the owner of [block] */
+static void _BlockMapSet(uffs_Device *dev, u16 block, TreeNode *node, int region)
+{
+	u16 *map = dev->tree.block_map;
+
+	if (map == NULL || block < dev->par.start || block > dev->par.end)
+		return;
+
+	map[block - dev->par.start] = (_BlockMapCode(region) << BLOCK_MAP_REGION_SHIFT) |
+									TO_IDX(node, TPOOL(dev));
+}
+
+/** [node] leaves its region, clear [block] if it's still owned by [node] */
+static void _BlockMapClear(uffs_Device *dev, u16 block, TreeNode *node)
+{
+	u16 *map = dev->tree.block_map;
+	u16 x;
+
+	if (map == NULL || block < dev->par.start || block > dev->par.end)
+		return;
+
+	x = map[block - dev->par.start];
+	if (x != 0 && (x & BLOCK_MAP_IDX_MASK) == TO_IDX(node, TPOOL(dev)))
+		map[block - dev->par.start] = 0;
+}
+
+/** find owner of [block] within [*region], *region is set to the region found */
+static TreeNode * _BlockMapFind(uffs_Device *dev, u16 block, int *region)
+{
+	u16 x;
+	int found;
+
+	if (block < dev->par.start || block > dev->par.end)
+		return NULL;
+
+	x = dev->tree.block_map[block - dev->par.start];
+	if (x == 0)
+		return NULL;
+
+	found = 1 << ((x >> BLOCK_MAP_REGION_SHIFT) - 1);
+	if ((*region & found) == 0)
+		return NULL;
+
+	*region = found;
+
+	return FROM_IDX(x & BLOCK_MAP_IDX_MASK, TPOOL(dev));
+}
+
 /** 
  * \brief initialize tree buffers
  * \param[in] dev uffs device
@@ -115,6 +184,20 @@ URET uffs_TreeInit(uffs_Device *dev)
 		dev->tree.data_entry[i] = EMPTY_NODE;
 	}
 
+	for (i = 0; i < CHILD_NODE_ENTRY_LEN; i++) {
+		dev->tree.dir_child[i] = EMPTY_NODE;
+		dev->tree.file_child[i] = EMPTY_NODE;
+	}
+
+	// block map is optional, blocks are searched through the lists without it
+	if (dev->tree.block_map == NULL && dev->mem.malloc && num <= BLOCK_MAP_IDX_MASK + 1)
+		dev->tree.block_map = (u16 *)dev->mem.malloc(dev, num * sizeof(u16));
+	if (dev->tree.block_map)
+		memset(dev->tree.block_map, 0, num * sizeof(u16));
+
+	memset(dev->tree.fsn_map, 0, sizeof(dev->tree.fsn_map));
+	FSN_MAP_SET(&(dev->tree), ROOT_DIR_SERIAL);
+
 	dev->tree.max_serial = ROOT_DIR_SERIAL;
 	
 	return U_SUCC;
@@ -136,6 +219,11 @@ URET uffs_TreeRelease(uffs_Device *dev)
 	uffs_PoolRelease(pool);
 	memset(pool, 0, sizeof(uffs_Pool));
 
+	if (dev->tree.block_map && dev->mem.free) {
+		dev->mem.free(dev, dev->tree.block_map);
+		dev->tree.block_map = NULL;
+	}
+
 	return U_SUCC;
 }
 
@@ -262,7 +350,7 @@ TreeNode * uffs_FindFromTree(uffs_Device *dev,
 	case UFFS_TYPE_FILE:
 		return uffs_TreeFindFileNode(dev, serial);
 	case UFFS_TYPE_DATA:
-		return uffs_TreeFindDataNode(dev, parent, serial);
+		return _TreeFindDataNode(dev, parent, serial);
 	}
 	uffs_Perror(UFFS_MSG_SERIOUS,
 				"unkown type, can't find node");
@@ -274,7 +362,8 @@ TreeNode * uffs_FindFromTree(uffs_Device *dev,
 static URET _BuildValidTreeNode(uffs_Device *dev,
 								TreeNode *node,		//!< empty node
 								uffs_BlockInfo *bc,
-								struct BlockTypeStatSt *st)
+								struct BlockTypeStatSt *st,
+								UBOOL lazy)			//!< unclean page check was skipped
 {
 	uffs_Tags *tag;
 	TreeNode *node_alt;
@@ -325,6 +414,25 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 	// (node which has the same serial number) in tree ?
 	node_alt = uffs_FindFromTree(dev, type, parent, serial); 
 
+#ifdef CONFIG_LAZY_MOUNT
+	if (node_alt != NULL && type == UFFS_TYPE_DATA) {
+		// an unclean block could be newer than the good one,
+		// so both blocks have to be checked before compare the timestamp.
+		if (lazy) {
+			if (_ScanAndFixUnCleanPage(dev, bc) == U_FAIL)
+				return U_FAIL;
+			if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_TRUE)
+				return U_SUCC;
+			lazy = U_FALSE;
+		}
+		if (node_alt->u.data.len == UFFS_LAZY_LEN) {
+			if (_TreeCheckLazyData(dev, node_alt, NULL) == U_FAIL)
+				return U_FAIL;
+			node_alt = uffs_FindFromTree(dev, type, parent, serial);
+		}
+	}
+#endif
+
 	if (node_alt != NULL) {
 		//find a alternate node ! need to check the timestamp !
 
@@ -446,7 +554,10 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 		node->u.data.block = bc->block;
 		node->u.data.parent = TAG_PARENT(tag);
 		node->u.data.serial = TAG_SERIAL(tag);
-		node->u.data.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA); 
+		if (lazy)
+			node->u.data.len = UFFS_LAZY_LEN;
+		else
+			node->u.data.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA); 
 		st->data++;
 		break;
 	}
@@ -536,17 +647,149 @@ static URET _ScanAndFixUnCleanPage(uffs_Device *dev, uffs_BlockInfo *bc)
 }
 
 
+#ifdef CONFIG_LAZY_MOUNT
+/** 
+ * finish the unclean page check skipped by lazy mount, and calculate the data length.
+ * \param[out] erased set to U_TRUE if the block is erased and node is not a data node anymore
+ * \return U_FAIL on I/O error
+ */
+static URET _TreeCheckLazyData(uffs_Device *dev, TreeNode *node, UBOOL *erased)
+{
+	uffs_BlockInfo *bc;
+	uffs_PendingBlock *pending;
+	u16 block = node->u.data.block;
+	URET ret;
+
+	if (erased)
+		*erased = U_FALSE;
+
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL)
+		return U_FAIL;
+
+	ret = _ScanAndFixUnCleanPage(dev, bc);
+	if (ret == U_SUCC) {
+		pending = uffs_BadBlockPendingNodeGet(dev, block);
+		if (pending && (pending->mark == UFFS_PENDING_BLK_CLEANUP ||
+						pending->mark == UFFS_PENDING_BLK_MARKBAD)) {
+			uffs_BreakFromEntry(dev, UFFS_TYPE_DATA, node);
+			uffs_TreeProcessPendingBadBlock(dev, node, block);
+			if (erased)
+				*erased = U_TRUE;
+		}
+		else {
+			node->u.data.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA);
+		}
+	}
+	uffs_BlockInfoPut(dev, bc);
+
+	return ret;
+}
+#endif
+
+/** scan one block, classify it and put the node to the right place of tree */
+static URET _BuildTreeScanBlock(uffs_Device *dev, int block,
+								TreeNode *node,		//!< empty node
+								struct BlockTypeStatSt *st,
+								UBOOL lazy)			//!< leave DATA block check to the first access
+{
+	uffs_BlockInfo *bc;
+	struct uffs_MiniHeaderSt header;
+	UBOOL header_loaded;
+	URET ret = U_SUCC;
+	int flash_ret;
+
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "fail to get block info");
+		return U_FAIL;
+	}
+
+	// read block status, page 0 tag and mini header in one batch if driver can do it,
+	// otherwise fall back to read them one by one.
+	flash_ret = uffs_FlashScanBlockMeta(dev, bc, &header);
+	header_loaded = (UFFS_FLASH_HAVE_ERR(flash_ret) ? U_FALSE : U_TRUE);
+	if (header_loaded)
+		uffs_BadBlockAddByFlashResult(dev, block, flash_ret);
+
+	// First, need to check bad block mark (known bad block)
+	if (flash_ret == UFFS_FLASH_BAD_BLK ||
+		(header_loaded == U_FALSE && uffs_FlashIsBadBlock(dev, block) == U_TRUE)) {
+		node->u.list.block = block;
+		uffs_TreeInsertToBadBlockList(dev, node);
+		uffs_Perror(UFFS_MSG_NORMAL, "found bad block %d", block);
+	}
+	else if (uffs_IsPageErased(dev, bc, 0) == U_TRUE) { //@ read one spare: 0
+		// page 0 tag shows it's an erased block, we need to check the mini header status to make sure it is clean.
+		if (header_loaded == U_FALSE &&
+			uffs_LoadMiniHeader(dev, block, 0, &header) == U_FAIL) {
+			uffs_Perror(UFFS_MSG_SERIOUS,
+						"I/O error when reading mini header !"
+						"block %d page %d",
+						block, 0);
+			ret = U_FAIL;
+			goto ext;
+		}
+
+		flash_ret = UFFS_FLASH_NO_ERR;
+		if (header.status != 0xFF) {
+			// page 0 tag is clean but page data is dirty ???
+			// this block should be erased immediately !
+			uffs_Perror(UFFS_MSG_NORMAL,
+						"first page in block %d is unclean, will be erased now!", bc->block);
+			flash_ret = uffs_FlashEraseBlock(dev, block);
+		}
+		node->u.list.block = block;
+		if (UFFS_FLASH_IS_BAD_BLOCK(flash_ret)) {
+			uffs_Perror(UFFS_MSG_NORMAL,
+						"New bad block (%d) discovered.", block);
+			uffs_BadBlockProcessNode(dev, node);
+		}
+		else {
+			// page 0 is clean does not means all pages in this block are clean,
+			// need to check this block later before use it.
+			uffs_TreeInsertToErasedListTailEx(dev, node, 1);
+		}
+	}
+	else {
+		// make sure it's not a non-recoverable bad block ...
+		if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_FALSE) {
+
+#ifdef CONFIG_LAZY_MOUNT
+			// page 0 tag is loaded already, only DATA block can be resolved later.
+			if (lazy && TAG_IS_GOOD(GET_TAG(bc, 0)) &&
+				TAG_TYPE(GET_TAG(bc, 0)) == UFFS_TYPE_DATA) {
+				ret = _BuildValidTreeNode(dev, node, bc, st, U_TRUE);
+				goto ext;
+			}
+#endif
+
+			// this block have valid data page(s).
+			ret = _ScanAndFixUnCleanPage(dev, bc);
+			if (ret == U_FAIL)
+				goto ext;
+
+			// _ScanAndFixUnCleanPage() might add new pending block, we need to process it first.
+			if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_FALSE) {
+				ret = _BuildValidTreeNode(dev, node, bc, st, U_FALSE);
+			}
+		}
+	}
+
+ext:
+	uffs_BlockInfoPut(dev, bc);
+
+	return ret;
+}
+
 static URET _BuildTreeStepOne(uffs_Device *dev)
 {
 	int block;
-	uffs_BlockInfo *bc = NULL;
 	TreeNode *node;
 	struct uffs_TreeSt *tree;
 	uffs_Pool *pool;
-	struct uffs_MiniHeaderSt header;
 	URET ret = U_SUCC;
 	struct BlockTypeStatSt st = {0, 0, 0};
-	int flash_ret;
 	
 	tree = &(dev->tree);
 	pool = TPOOL(dev);
@@ -561,12 +804,6 @@ static URET _BuildTreeStepOne(uffs_Device *dev)
 
 //	printf("s:%d e:%d\n", dev->par.start, dev->par.end);
 	for (block = dev->par.start; block <= dev->par.end; block++) {
-		bc = uffs_BlockInfoGet(dev, block);
-		if (bc == NULL) {
-			uffs_Perror(UFFS_MSG_SERIOUS, "step one:fail to get block info");
-			ret = U_FAIL;
-			break;
-		}
 		node = (TreeNode *)uffs_PoolGet(pool);
 		if (node == NULL) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "insufficient tree node!");
@@ -574,66 +811,17 @@ static URET _BuildTreeStepOne(uffs_Device *dev)
 			break;
 		}
 
-		// First, need to check bad block mark (known bad block)
-		if (uffs_FlashIsBadBlock(dev, block) == U_TRUE) {
-			node->u.list.block = block;
-			uffs_TreeInsertToBadBlockList(dev, node);
-			uffs_Perror(UFFS_MSG_NORMAL, "found bad block %d", block);
-		}
-		else if (uffs_IsPageErased(dev, bc, 0) == U_TRUE) { //@ read one spare: 0
-			// page 0 tag shows it's an erased block, we need to check the mini header status to make sure it is clean.
-			if (uffs_LoadMiniHeader(dev, block, 0, &header) == U_FAIL) {
-				uffs_Perror(UFFS_MSG_SERIOUS,
-							"I/O error when reading mini header !"
-							"block %d page %d",
-							block, 0);
-				ret = U_FAIL;
-				break;
-			}
-
-			flash_ret = UFFS_FLASH_NO_ERR;
-			if (header.status != 0xFF) {
-				// page 0 tag is clean but page data is dirty ???
-				// this block should be erased immediately !
-				uffs_Perror(UFFS_MSG_NORMAL,
-							"first page in block %d is unclean, will be erased now!", bc->block);
-				flash_ret = uffs_FlashEraseBlock(dev, block);
-			}
-			node->u.list.block = block;
-			if (UFFS_FLASH_IS_BAD_BLOCK(flash_ret)) {
-				uffs_Perror(UFFS_MSG_NORMAL,
-							"New bad block (%d) discovered.", block);
-				uffs_BadBlockProcessNode(dev, node);
-			}
-			else {
-				// page 0 is clean does not means all pages in this block are clean,
-				// need to check this block later before use it.
-				uffs_TreeInsertToErasedListTailEx(dev, node, 1);
-			}
-		}
-		else {
-			// make sure it's not a non-recoverable bad block ...
-			if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_FALSE) {
-
-				// this block have valid data page(s).
-				ret = _ScanAndFixUnCleanPage(dev, bc);
-				if (ret == U_FAIL)
-					break;
-
-				// _ScanAndFixUnCleanPage() might add new pending block, we need to process it first.
-                if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_FALSE) {
-					ret = _BuildValidTreeNode(dev, node, bc, &st);
-					if (ret == U_FAIL)
-						break;
-				}
-			}
+#ifdef CONFIG_LAZY_MOUNT
+		ret = _BuildTreeScanBlock(dev, block, node, &st, U_TRUE);
+#else
+		ret = _BuildTreeScanBlock(dev, block, node, &st, U_FALSE);
+#endif
+		if (ret == U_FAIL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "step one: fail to scan block %d", block);
+			break;
 		}
-		uffs_BlockInfoPut(dev, bc);
 	} //end of for
 
-	if(ret == U_FAIL) 
-		uffs_BlockInfoPut(dev, bc);
-
 	uffs_Perror(UFFS_MSG_NORMAL,
 				"DIR %d, FILE %d, DATA %d", st.dir, st.file, st.data);
 
@@ -693,6 +881,7 @@ void uffs_TreeSuspendAdd(uffs_Device *dev, TreeNode *node)
 	if (dev->tree.suspend)
 		dev->tree.suspend->u.list.prev = node;
 	dev->tree.suspend = node;
+	FSN_MAP_SET(&(dev->tree), node->u.list.u.serial);
 }
 
 /** search suspend list */
@@ -718,25 +907,23 @@ void uffs_TreeRemoveSuspendNode(uffs_Device *dev, TreeNode *node)
 		node->u.list.next->u.list.prev = node->u.list.prev;
 	if (node == dev->tree.suspend)
 		dev->tree.suspend = NULL;
+	FSN_MAP_CLR(&(dev->tree), node->u.list.u.serial);
 }
 
 TreeNode * uffs_TreeFindFileNodeWithParent(uffs_Device *dev, u16 parent)
 {
-	int hash;
 	u16 x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
-	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
-		x = tree->file_entry[hash];
-		while (x != EMPTY_NODE) {
-			node = FROM_IDX(x, TPOOL(dev));
-			if (node->u.file.parent == parent) {
-				return node;
-			}
-			else {
-				x = node->hash_next;
-			}
+	x = tree->file_child[GET_CHILD_HASH(parent)];
+	while (x != EMPTY_NODE) {
+		node = FROM_IDX(x, TPOOL(dev));
+		if (node->u.file.parent == parent) {
+			return node;
+		}
+		else {
+			x = node->child_next;
 		}
 	}
 
@@ -766,21 +953,18 @@ TreeNode * uffs_TreeFindDirNode(uffs_Device *dev, u16 serial)
 
 TreeNode * uffs_TreeFindDirNodeWithParent(uffs_Device *dev, u16 parent)
 {
-	int hash;
 	u16 x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
-	for (hash = 0; hash < DIR_NODE_ENTRY_LEN; hash++) {
-		x = tree->dir_entry[hash];
-		while (x != EMPTY_NODE) {
-			node = FROM_IDX(x, TPOOL(dev));
-			if (node->u.dir.parent == parent) {
-				return node;
-			}
-			else {
-				x = node->hash_next;
-			}
+	x = tree->dir_child[GET_CHILD_HASH(parent)];
+	while (x != EMPTY_NODE) {
+		node = FROM_IDX(x, TPOOL(dev));
+		if (node->u.dir.parent == parent) {
+			return node;
+		}
+		else {
+			x = node->child_next;
 		}
 	}
 	
@@ -792,31 +976,28 @@ TreeNode * uffs_TreeFindFileNodeByName(uffs_Device *dev,
 										u32 len,
 										u16 sum, u16 parent)
 {
-	int i;
 	u16 x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	
-	for (i = 0; i < FILE_NODE_ENTRY_LEN; i++) {
-		x = tree->file_entry[i];
-		while (x != EMPTY_NODE) {
-			node = FROM_IDX(x, TPOOL(dev));
-			if (node->u.file.checksum == sum && node->u.file.parent == parent) {
-				//read file name from flash, and compare...
-				if (uffs_TreeCompareFileName(dev, name, len, sum, 
-												node, UFFS_TYPE_FILE) == U_TRUE) {
-					//Got it!
-					return node;
-				}
+	x = tree->file_child[GET_CHILD_HASH(parent)];
+	while (x != EMPTY_NODE) {
+		node = FROM_IDX(x, TPOOL(dev));
+		if (node->u.file.checksum == sum && node->u.file.parent == parent) {
+			//read file name from flash, and compare...
+			if (uffs_TreeCompareFileName(dev, name, len, sum, 
+											node, UFFS_TYPE_FILE) == U_TRUE) {
+				//Got it!
+				return node;
 			}
-			x = node->hash_next;
 		}
+		x = node->child_next;
 	}
 
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
+static TreeNode * _TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
 {
 	int hash;
 	TreeNode *node;
@@ -838,12 +1019,38 @@ TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
 	return NULL;
 }
 
+TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
+{
+	TreeNode *node;
+#ifdef CONFIG_LAZY_MOUNT
+	TreeNode *file;
+#endif
+
+	node = _TreeFindDataNode(dev, parent, serial);
+
+#ifdef CONFIG_LAZY_MOUNT
+	if (node && node->u.data.len == UFFS_LAZY_LEN) {
+		// first access to the file since lazy mount
+		file = uffs_TreeFindFileNode(dev, parent);
+		if (file)
+			uffs_TreeResolveFile(dev, file);
+		node = _TreeFindDataNode(dev, parent, serial);
+	}
+#endif
+
+	return node;
+}
+
 TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, u16 block)
 {
 	int hash;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	u16 x;
+	int region = SEARCH_REGION_DIR;
+
+	if (tree->block_map)
+		return _BlockMapFind(dev, block, &region);
 
 	for (hash = 0; hash < DIR_NODE_ENTRY_LEN; hash++) {
 		x = tree->dir_entry[hash];
@@ -861,6 +1068,11 @@ TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, u16 block)
 TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, u16 block)
 {
 	TreeNode *node;
+	int region = SEARCH_REGION_ERASED;
+
+	if (dev->tree.block_map)
+		return _BlockMapFind(dev, block, &region);
+
 	node = dev->tree.erased;
 
 	while (node) {
@@ -875,6 +1087,11 @@ TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, u16 block)
 TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, u16 block)
 {
 	TreeNode *node;
+	int region = SEARCH_REGION_BAD;
+
+	if (dev->tree.block_map)
+		return _BlockMapFind(dev, block, &region);
+
 	node = dev->tree.bad;
 
 	while (node) {
@@ -892,6 +1109,10 @@ TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, u16 block)
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	u16 x;
+	int region = SEARCH_REGION_FILE;
+
+	if (tree->block_map)
+		return _BlockMapFind(dev, block, &region);
 
 	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
 		x = tree->file_entry[hash];
@@ -912,6 +1133,10 @@ TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, u16 block)
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	u16 x;
+	int region = SEARCH_REGION_DATA;
+
+	if (tree->block_map)
+		return _BlockMapFind(dev, block, &region);
 
 	for (hash = 0; hash < DATA_NODE_ENTRY_LEN; hash++) {
 		x = tree->data_entry[hash];
@@ -930,6 +1155,9 @@ TreeNode * uffs_TreeFindNodeByBlock(uffs_Device *dev, u16 block, int *region)
 {
 	TreeNode *node = NULL;
 
+	if (dev->tree.block_map)
+		return _BlockMapFind(dev, block, region);
+
 	if (*region & SEARCH_REGION_DATA) {
 		node = uffs_TreeFindDataNodeByBlock(dev, block);
 		if (node) {
@@ -973,26 +1201,23 @@ TreeNode * uffs_TreeFindDirNodeByName(uffs_Device *dev,
 									  const char *name, u32 len,
 									  u16 sum, u16 parent)
 {
-	int i;
 	u16 x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	
-	for (i = 0; i < DIR_NODE_ENTRY_LEN; i++) {
-		x = tree->dir_entry[i];
-		while (x != EMPTY_NODE) {
-			node = FROM_IDX(x, TPOOL(dev));
-			if (node->u.dir.checksum == sum &&
-					node->u.dir.parent == parent) {
-				//read file name from flash, and compare...
-				if (uffs_TreeCompareFileName(dev, name, len, sum,
-											node, UFFS_TYPE_DIR) == U_TRUE) {
-					//Got it!
-					return node;
-				}
+	x = tree->dir_child[GET_CHILD_HASH(parent)];
+	while (x != EMPTY_NODE) {
+		node = FROM_IDX(x, TPOOL(dev));
+		if (node->u.dir.checksum == sum &&
+				node->u.dir.parent == parent) {
+			//read file name from flash, and compare...
+			if (uffs_TreeCompareFileName(dev, name, len, sum,
+										node, UFFS_TYPE_DIR) == U_TRUE) {
+				//Got it!
+				return node;
 			}
-			x = node->hash_next;
 		}
+		x = node->child_next;
 	}
 
 	return NULL;
@@ -1020,12 +1245,31 @@ UBOOL uffs_TreeCompareFileName(uffs_Device *dev,
 	uffs_Buf *buf;
 	u16 data_sum;
 
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+	const struct uffs_DentrySt *d;
+	u16 serial = (type == UFFS_TYPE_DIR ? node->u.dir.serial : node->u.file.serial);
+	u16 parent = (type == UFFS_TYPE_DIR ? node->u.dir.parent : node->u.file.parent);
+
+	d = uffs_DcacheFind(dev, type, serial, parent);
+	if (d) {
+		if (d->name_len == len &&
+			uffs_CompareFileName(d->name, d->name_len, name) == U_TRUE)
+			matched = U_TRUE;
+		return matched;
+	}
+#endif
+
 	buf = uffs_BufGetEx(dev, type, node, 0, 0);
 	if (buf == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "can't get buf !\n ");
 		goto ext;
 	}
 	fi = (uffs_FileInfo *)(buf->data);
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+	uffs_DcachePut(dev, type, serial, parent, fi);
+#endif
+
 	data_sum = uffs_MakeSum16(fi->name, fi->name_len);
 
 	if (data_sum != sum) {
@@ -1047,6 +1291,28 @@ ext:
 }
 
 
+/** erase a data block which does not belong to any file */
+static void _BuildTreeEraseOrphan(uffs_Device *dev, TreeNode *work)
+{
+	u16 blockSave;
+	int ret;
+
+	uffs_Perror(UFFS_MSG_NORMAL,
+		"find a orphan data block:%d, "
+		"parent:%d, serial:%d, will be erased!",
+		work->u.data.block,
+		work->u.data.parent, work->u.data.serial);
+
+	uffs_BreakFromEntry(dev, UFFS_TYPE_DATA, work);
+	blockSave = work->u.data.block;
+	work->u.list.block = blockSave;
+	ret = uffs_FlashEraseBlock(dev, blockSave);
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret))
+		uffs_BadBlockProcessNode(dev, work);
+	else
+		uffs_TreeInsertToErasedListTail(dev, work);
+}
+
 /* calculate file length, etc */
 static URET _BuildTreeStepThree(uffs_Device *dev)
 {
@@ -1056,8 +1322,6 @@ static URET _BuildTreeStepThree(uffs_Device *dev)
 	TreeNode *node;
 	struct uffs_TreeSt *tree;
 	uffs_Pool *pool;
-	u16 blockSave;
-	int ret;
 
 	TreeNode *cache = NULL;
 	u16 cacheSerial = INVALID_UFFS_SERIAL;
@@ -1083,22 +1347,15 @@ static URET _BuildTreeStepThree(uffs_Device *dev)
 				x = work->hash_next;
 				//this data block does not belong to any file ?
 				//should be erased.
-				uffs_Perror(UFFS_MSG_NORMAL,
-					"find a orphan data block:%d, "
-					"parent:%d, serial:%d, will be erased!",
-					work->u.data.block,
-					work->u.data.parent, work->u.data.serial);
-
-				uffs_BreakFromEntry(dev, UFFS_TYPE_DATA, work);
-				blockSave = work->u.data.block;
-				work->u.list.block = blockSave;
-				ret = uffs_FlashEraseBlock(dev, blockSave);
-				if (UFFS_FLASH_IS_BAD_BLOCK(ret))
-					uffs_BadBlockProcessNode(dev, work);
-				else
-					uffs_TreeInsertToErasedListTail(dev, work);
+				_BuildTreeEraseOrphan(dev, work);
 			}
 			else {
+#ifdef CONFIG_LAZY_MOUNT
+				// data block not checked yet, file length will be resolved on first access
+				if (work->u.data.len == UFFS_LAZY_LEN || node->u.file.len == UFFS_LAZY_LEN)
+					node->u.file.len = UFFS_LAZY_LEN;
+				else
+#endif
 				node->u.file.len += work->u.data.len;
 				x = work->hash_next;
 			}
@@ -1108,6 +1365,232 @@ static URET _BuildTreeStepThree(uffs_Device *dev)
 	return U_SUCC;
 }
 
+#ifdef CONFIG_TREE_CHECKPOINT
+static void _TreeRemoveFromErasedList(uffs_Device *dev, TreeNode *node)
+{
+	struct uffs_TreeSt *tree = &(dev->tree);
+	TreeNode *prev = (node == tree->erased ? NULL : node->u.list.prev);
+	TreeNode *next = node->u.list.next;
+
+	if (prev)
+		prev->u.list.next = next;
+	else
+		tree->erased = next;
+
+	if (next)
+		next->u.list.prev = prev;
+	else
+		tree->erased_tail = prev;
+
+	tree->erased_count--;
+	_BlockMapClear(dev, node->u.list.block, node);
+}
+
+/** calculate file length from storage, erase the data blocks if file is gone */
+static URET _BuildTreeFixFile(uffs_Device *dev, u16 serial)
+{
+	TreeNode *file, *work;
+	uffs_BlockInfo *bc;
+	int i;
+	u16 x;
+
+	file = uffs_TreeFindFileNode(dev, serial);
+	if (file) {
+		bc = uffs_BlockInfoGet(dev, file->u.file.block);
+		if (bc == NULL)
+			return U_FAIL;
+		file->u.file.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_FILE);
+		uffs_BlockInfoPut(dev, bc);
+	}
+
+	for (i = 0; i < DATA_NODE_ENTRY_LEN; i++) {
+		x = dev->tree.data_entry[i];
+		while (x != EMPTY_NODE) {
+			work = FROM_IDX(x, TPOOL(dev));
+			x = work->hash_next;
+			if (work->u.data.parent != serial)
+				continue;
+
+			if (file == NULL) {
+				_BuildTreeEraseOrphan(dev, work);
+			}
+			else {
+#ifdef CONFIG_LAZY_MOUNT
+				if (work->u.data.len == UFFS_LAZY_LEN) {
+					UBOOL erased;
+
+					if (_TreeCheckLazyData(dev, work, &erased) == U_FAIL)
+						return U_FAIL;
+					if (erased == U_FALSE)
+						file->u.file.len += work->u.data.len;
+					continue;
+				}
+#endif
+				bc = uffs_BlockInfoGet(dev, work->u.data.block);
+				if (bc == NULL)
+					return U_FAIL;
+				work->u.data.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA);
+				uffs_BlockInfoPut(dev, bc);
+				file->u.file.len += work->u.data.len;
+			}
+		}
+	}
+
+	return U_SUCC;
+}
+
+#define MARK_FILE(map, serial) \
+	do { if ((serial) <= MAX_UFFS_FSN) (map)[(serial) >> 3] |= 1 << ((serial) & 7); } while (0)
+
+/** scan the blocks changed after the checkpoint was taken */
+static URET _BuildTreeReplayJournal(uffs_Device *dev)
+{
+	const u16 *blocks;
+	TreeNode *node;
+	int count, i, region;
+	u16 serial;
+	u8 files[(MAX_UFFS_FSN + 1 + 7) / 8];
+	struct BlockTypeStatSt st = {0, 0, 0};
+	URET ret;
+
+	count = uffs_CkptJournalBlocks(dev, &blocks);
+	if (count == 0)
+		return U_SUCC;
+
+	uffs_Perror(UFFS_MSG_NORMAL, "replay journal, %d blocks", count);
+	memset(files, 0, sizeof(files));
+
+	for (i = 0; i < count; i++) {
+		region = SEARCH_REGION_DIR | SEARCH_REGION_FILE | SEARCH_REGION_DATA |
+					SEARCH_REGION_ERASED | SEARCH_REGION_BAD;
+		node = uffs_TreeFindNodeByBlock(dev, blocks[i], &region);
+		if (node == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "block %d is not in tree ?", blocks[i]);
+			return U_FAIL;
+		}
+
+		switch (region) {
+		case SEARCH_REGION_BAD:
+			continue;	// bad block is always bad
+		case SEARCH_REGION_ERASED:
+			_TreeRemoveFromErasedList(dev, node);
+			break;
+		case SEARCH_REGION_DIR:
+			uffs_BreakFromEntry(dev, UFFS_TYPE_DIR, node);
+			break;
+		case SEARCH_REGION_FILE:
+			MARK_FILE(files, node->u.file.serial);
+			uffs_BreakFromEntry(dev, UFFS_TYPE_FILE, node);
+			break;
+		case SEARCH_REGION_DATA:
+			MARK_FILE(files, node->u.data.parent);
+			uffs_BreakFromEntry(dev, UFFS_TYPE_DATA, node);
+			break;
+		}
+
+		ret = _BuildTreeScanBlock(dev, blocks[i], node, &st, U_FALSE);
+		if (ret != U_SUCC)
+			return ret;
+	}
+
+	// files may have new data blocks, or be deleted
+	for (i = 0; i < count; i++) {
+		region = SEARCH_REGION_FILE | SEARCH_REGION_DATA;
+		node = uffs_TreeFindNodeByBlock(dev, blocks[i], &region);
+		if (node && region == SEARCH_REGION_FILE)
+			MARK_FILE(files, node->u.file.serial);
+		else if (node && region == SEARCH_REGION_DATA)
+			MARK_FILE(files, node->u.data.parent);
+	}
+
+	for (serial = 0; serial <= MAX_UFFS_FSN; serial++) {
+		if (files[serial >> 3] & (1 << (serial & 7))) {
+			ret = _BuildTreeFixFile(dev, serial);
+			if (ret != U_SUCC)
+				return ret;
+		}
+	}
+
+	return U_SUCC;
+}
+#endif
+
+#ifdef CONFIG_LAZY_MOUNT
+/** 
+ * \brief resolve the file length and check the data blocks skipped by lazy mount
+ * \param[in] dev uffs device
+ * \param[in] node file node
+ */
+URET uffs_TreeResolveFile(uffs_Device *dev, TreeNode *node)
+{
+	TreeNode *work;
+	uffs_BlockInfo *bc;
+	UBOOL erased;
+	u32 len;
+	u16 x;
+	int i;
+
+	if (node->u.file.len != UFFS_LAZY_LEN)
+		return U_SUCC;
+
+	bc = uffs_BlockInfoGet(dev, node->u.file.block);
+	if (bc == NULL)
+		return U_FAIL;
+	len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_FILE);
+	uffs_BlockInfoPut(dev, bc);
+
+	for (i = 0; i < DATA_NODE_ENTRY_LEN; i++) {
+		x = dev->tree.data_entry[i];
+		while (x != EMPTY_NODE) {
+			work = FROM_IDX(x, TPOOL(dev));
+			x = work->hash_next;
+			if (work->u.data.parent != node->u.file.serial)
+				continue;
+
+			if (work->u.data.len == UFFS_LAZY_LEN) {
+				if (_TreeCheckLazyData(dev, work, &erased) == U_FAIL) {
+					uffs_Perror(UFFS_MSG_SERIOUS, "fail to check data block %d", work->u.data.block);
+					return U_FAIL;
+				}
+				if (erased == U_TRUE)
+					continue;
+			}
+			len += work->u.data.len;
+		}
+	}
+
+	node->u.file.len = len;
+
+	return U_SUCC;
+}
+
+/** 
+ * \brief resolve all files left by lazy mount
+ * \param[in] dev uffs device
+ */
+URET uffs_TreeResolveAll(uffs_Device *dev)
+{
+	TreeNode *node;
+	u16 x;
+	int i;
+
+	for (i = 0; i < FILE_NODE_ENTRY_LEN; i++) {
+		x = dev->tree.file_entry[i];
+		while (x != EMPTY_NODE) {
+			node = FROM_IDX(x, TPOOL(dev));
+			x = node->hash_next;
+			if (uffs_TreeResolveFile(dev, node) == U_FAIL)
+				return U_FAIL;
+		}
+	}
+
+	if (HAVE_BADBLOCK(dev))
+		uffs_BadBlockRecover(dev);
+
+	return U_SUCC;
+}
+#endif
+
 /** 
  * \brief build tree structure from flash
  * \param[in] dev uffs device
@@ -1116,6 +1599,20 @@ URET uffs_BuildTree(uffs_Device *dev)
 {
 	URET ret;
 
+#ifdef CONFIG_TREE_CHECKPOINT
+	/* restore the tree from checkpoint, only the blocks changed
+		after the checkpoint was taken need to be scanned again */
+	if (uffs_CkptLoad(dev) == U_SUCC) {
+		if (_BuildTreeReplayJournal(dev) == U_SUCC) {
+			if (HAVE_BADBLOCK(dev))
+				uffs_BadBlockRecover(dev);
+			return _BuildTreeStepTwo(dev);
+		}
+		uffs_Perror(UFFS_MSG_NORMAL, "replay journal fail, scan all blocks.");
+		uffs_TreeInit(dev);
+	}
+#endif
+
 	/***** step one: scan all page spares, classify DIR/FILE/DATA nodes,
 		check bad blocks/uncompleted(conflicted) blocks as well *****/
 
@@ -1163,21 +1660,15 @@ URET uffs_BuildTree(uffs_Device *dev)
  */
 u16 uffs_FindFreeFsnSerial(uffs_Device *dev)
 {
-	u16 i;
-	TreeNode *node;
-
-	//TODO!! Do we need a faster serial number generating method?
-	//		 it depends on how often creating files or directories
-
-	for (i = ROOT_DIR_SERIAL + 1; i < MAX_UFFS_FSN; i++) {
-		node = uffs_TreeFindDirNode(dev, i);
-		if (node == NULL) {
-			node = uffs_TreeFindFileNode(dev, i);
-			if (node == NULL) {
-				node = uffs_TreeFindSuspendNode(dev, i);
-				if (node == NULL)
-					return i;
-			}
+	const u8 *map = dev->tree.fsn_map;
+	u16 i, serial;
+
+	// the lowest free serial, root serial is always marked in use
+	for (i = 0; i < sizeof(dev->tree.fsn_map); i++) {
+		if (map[i] != 0xff) {
+			for (serial = i << 3; map[i] & (1 << (serial & 7)); serial++)
+				;
+			return serial < MAX_UFFS_FSN ? serial : INVALID_UFFS_SERIAL;
 		}
 	}
 
@@ -1194,6 +1685,7 @@ static TreeNode * uffs_TreeGetErasedNodeNoCheck(uffs_Device *dev)
 		if(dev->tree.erased == NULL) 
 			dev->tree.erased_tail = NULL;
 		dev->tree.erased_count--;
+		_BlockMapClear(dev, node->u.list.block, node);
 	}
 	
 	return node;
@@ -1275,6 +1767,27 @@ static void _InsertToEntry(uffs_Device *dev, u16 *entry,
 }
 
 
+static void _InsertToChild(uffs_Device *dev, u16 *entry, TreeNode *node)
+{
+	node->child_next = *entry;
+	node->child_prev = EMPTY_NODE;
+	if (*entry != EMPTY_NODE) {
+		FROM_IDX(*entry, TPOOL(dev))->child_prev = TO_IDX(node, TPOOL(dev));
+	}
+	*entry = TO_IDX(node, TPOOL(dev));
+}
+
+static void _BreakFromChild(uffs_Device *dev, u16 *entry, TreeNode *node)
+{
+	if (node->child_prev != EMPTY_NODE)
+		FROM_IDX(node->child_prev, TPOOL(dev))->child_next = node->child_next;
+	if (node->child_next != EMPTY_NODE)
+		FROM_IDX(node->child_next, TPOOL(dev))->child_prev = node->child_prev;
+
+	if (*entry == TO_IDX(node, TPOOL(dev)))
+		*entry = node->child_next;
+}
+
 /** 
  * break the node from entry
  */
@@ -1288,14 +1801,21 @@ void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node)
 	case UFFS_TYPE_DIR:
 		hash = GET_DIR_HASH(node->u.dir.serial);
 		entry = &(dev->tree.dir_entry[hash]);
+		_BreakFromChild(dev, &(dev->tree.dir_child[GET_CHILD_HASH(node->u.dir.parent)]), node);
+		FSN_MAP_CLR(&(dev->tree), node->u.dir.serial);
 		break;
 	case UFFS_TYPE_FILE:
 		hash = GET_FILE_HASH(node->u.file.serial);
 		entry = &(dev->tree.file_entry[hash]);
+		_BreakFromChild(dev, &(dev->tree.file_child[GET_CHILD_HASH(node->u.file.parent)]), node);
+		FSN_MAP_CLR(&(dev->tree), node->u.file.serial);
 		break;
 	case UFFS_TYPE_DATA:
 		hash = GET_DATA_HASH(node->u.data.parent, node->u.data.serial);
 		entry = &(dev->tree.data_entry[hash]);
+#ifdef CONFIG_FILE_EXTENTS
+		dev->tree.data_gen++;
+#endif
 		break;
 	default:
 		uffs_Perror(UFFS_MSG_SERIOUS, "unknown type when break...");
@@ -1314,6 +1834,8 @@ void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node)
 	if (*entry == TO_IDX(node, &(dev->mem.tree_pool))) {
 		*entry = node->hash_next;
 	}
+
+	_BlockMapClear(dev, _GetBlockFromNode(type, node), node);
 }
 
 static void uffs_InsertToFileEntry(uffs_Device *dev, TreeNode *node)
@@ -1321,6 +1843,9 @@ static void uffs_InsertToFileEntry(uffs_Device *dev, TreeNode *node)
 	_InsertToEntry(dev, dev->tree.file_entry,
 					GET_FILE_HASH(node->u.file.serial),
 					node);
+	_InsertToChild(dev, &(dev->tree.file_child[GET_CHILD_HASH(node->u.file.parent)]), node);
+	FSN_MAP_SET(&(dev->tree), node->u.file.serial);
+	_BlockMapSet(dev, node->u.file.block, node, SEARCH_REGION_FILE);
 }
 
 static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node)
@@ -1328,6 +1853,9 @@ static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node)
 	_InsertToEntry(dev, dev->tree.dir_entry,
 					GET_DIR_HASH(node->u.dir.serial),
 					node);
+	_InsertToChild(dev, &(dev->tree.dir_child[GET_CHILD_HASH(node->u.dir.parent)]), node);
+	FSN_MAP_SET(&(dev->tree), node->u.dir.serial);
+	_BlockMapSet(dev, node->u.dir.block, node, SEARCH_REGION_DIR);
 }
 
 static void uffs_InsertToDataEntry(uffs_Device *dev, TreeNode *node)
@@ -1335,6 +1863,7 @@ static void uffs_InsertToDataEntry(uffs_Device *dev, TreeNode *node)
 	_InsertToEntry(dev, dev->tree.data_entry,
 					GET_DATA_HASH(node->u.data.parent, node->u.data.serial),
 					node);
+	_BlockMapSet(dev, node->u.data.block, node, SEARCH_REGION_DATA);
 }
 
 void uffs_InsertToErasedListHead(uffs_Device *dev, TreeNode *node)
@@ -1354,6 +1883,7 @@ void uffs_InsertToErasedListHead(uffs_Device *dev, TreeNode *node)
 		tree->erased_tail = node;
 	}
 	tree->erased_count++;
+	_BlockMapSet(dev, node->u.list.block, node, SEARCH_REGION_ERASED);
 }
 
 /**
@@ -1381,6 +1911,7 @@ void uffs_TreeInsertToErasedListTailEx(uffs_Device *dev, TreeNode *node, int nee
 		tree->erased = node;
 	}
 	tree->erased_count++;
+	_BlockMapSet(dev, node->u.list.block, node, SEARCH_REGION_ERASED);
 }
 
 void uffs_TreeInsertToErasedListTail(uffs_Device *dev, TreeNode *node)
@@ -1403,13 +1934,25 @@ void uffs_TreeInsertToBadBlockList(uffs_Device *dev, TreeNode *node)
 
 	tree->bad = node;
 	tree->bad_count++;
+	_BlockMapSet(dev, node->u.list.block, node, SEARCH_REGION_BAD);
 }
 
 /** 
  * set tree node block value
+ * \note if the node is on tree, the block map is updated
+ *		as well (node is on tree when it owns its old block).
  */
-void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, u16 block)
+void uffs_TreeSetNodeBlock(uffs_Device *dev, u8 type, TreeNode *node, u16 block)
 {
+	int region = SEARCH_REGION_DIR | SEARCH_REGION_FILE | SEARCH_REGION_DATA;
+	UBOOL on_tree = U_FALSE;
+
+	if (dev->tree.block_map &&
+		_BlockMapFind(dev, _GetBlockFromNode(type, node), &region) == node) {
+		_BlockMapClear(dev, _GetBlockFromNode(type, node), node);
+		on_tree = U_TRUE;
+	}
+
 	switch (type) {
 	case UFFS_TYPE_FILE:
 		node->u.file.block = block;
@@ -1421,5 +1964,26 @@ void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, u16 block)
 		node->u.data.block = block;
 		break;
 	}
+
+	if (on_tree)
+		_BlockMapSet(dev, block, node, region);
+}
+
+/**
+ * move a DIR/FILE node on tree to new parent
+ * \note the node must be on tree, and this must be done before
+ *		buffers of the object are flushed with the new parent.
+ */
+void uffs_TreeSetNodeParent(uffs_Device *dev, u8 type, TreeNode *node, u16 parent)
+{
+	u16 *child = (type == UFFS_TYPE_DIR ? dev->tree.dir_child : dev->tree.file_child);
+	u16 *p = (type == UFFS_TYPE_DIR ? &(node->u.dir.parent) : &(node->u.file.parent));
+
+	if (*p == parent)
+		return;
+
+	_BreakFromChild(dev, &child[GET_CHILD_HASH(*p)], node);
+	*p = parent;
+	_InsertToChild(dev, &child[GET_CHILD_HASH(parent)], node);
 }
 
@@ -265,6 +265,16 @@ URET uffs_FormatDeviceEx(uffs_Device *dev, UBOOL force, UBOOL lock) {
     }
   }
 
+#ifdef CONFIG_TREE_CHECKPOINT
+  if (ret == U_SUCC)
+    uffs_CkptFormat(dev);
+#endif
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+  if (ret == U_SUCC)
+    uffs_DcacheInvalidateAll(dev);
+#endif
+
   if (ret == U_SUCC && uffs_TreeRelease(dev) == U_FAIL) {
     ret = U_FAIL;
   }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -11,6 +12,7 @@ extern "C" {
 typedef struct spi_device_t *spi_device_handle_t;
 
 #define SPI_TRANS_CS_KEEP_ACTIVE (1 << 0)
+#define SPI_TRANS_MODE_QIO (1 << 1)
 
 #define SPI_TRANS_USE_RXDATA (1 << 2)
 #define SPI_TRANS_USE_TXDATA (1 << 3)
@@ -36,6 +38,14 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
                               spi_transaction_t *trans_desc);
 esp_err_t spi_device_polling_transmit(spi_device_handle_t handle,
                                       spi_transaction_t *trans_desc);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle,
+                                 spi_transaction_t *trans_desc,
+                                 TickType_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait);
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait);
+void spi_device_release_bus(spi_device_handle_t dev);
 
 #ifdef __cplusplus
 }
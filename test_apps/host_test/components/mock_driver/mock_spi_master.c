@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define TAG "MOCK_SPI"
 
@@ -21,6 +22,7 @@ static int mock_total_blocks = 128; // Default safe value
 #define MOCK_PAGES_PER_BLOCK 64
 #define MOCK_TOTAL_BLOCKS mock_total_blocks
 #define MOCK_CACHE_SIZE (MOCK_PAGE_SIZE + MOCK_SPARE_SIZE)
+#define MOCK_QUEUE_SIZE 8
 
 // Commands
 #define CMD_RESET 0xFF
@@ -29,9 +31,14 @@ static int mock_total_blocks = 128; // Default safe value
 #define CMD_READ_ID 0x9F
 #define CMD_PAGE_READ 0x13
 #define CMD_READ_CACHE 0x03
+#define CMD_READ_CACHE_X4 0x6B
+#define CMD_READ_CACHE_SEQ 0x31
+#define CMD_READ_CACHE_END 0x3F
 #define CMD_WRITE_ENABLE 0x06
 #define CMD_PROGRAM_LOAD 0x02
 #define CMD_RANDOM_DATA_INPUT 0x84
+#define CMD_PROGRAM_LOAD_X4 0x32
+#define CMD_RANDOM_DATA_INPUT_X4 0x34
 #define CMD_PROGRAM_EXECUTE 0x10
 #define CMD_BLOCK_ERASE 0xD8
 
@@ -50,8 +57,32 @@ static uint8_t page_cache[MOCK_CACHE_SIZE];
 static uint8_t status_reg = 0;
 static bool write_enabled = false;
 static int data_input_mode = 0; // 0: None, 1: Expecting Data
+static int data_output_mode = 0; // 1: x4 cache read, data phase follows
+static bool quad_data = false;   // Data phase follows on 4 lines
+static uint8_t cfg_reg = 0;      // Configuration register (0xB0)
 static uint16_t current_col_addr = 0;
 uint8_t mock_mfr_id = 0xEF; // Default to Winbond
+uint32_t mock_page_read_count = 0; // PAGE_READ commands issued
+uint32_t mock_read_seq_count = 0;  // Pages moved to cache by 0x31/0x3F
+static uint32_t data_reg_addr = 0; // Page in the data register
+uint32_t mock_busy_us = 0;         // Busy time of array operations
+uint32_t mock_quad_bytes = 0;      // Data bytes transferred on 4 lines
+uint32_t mock_cache_read_count = 0; // READ FROM CACHE commands (x1 or x4)
+uint32_t mock_cache_read_bytes = 0; // Bytes read out of the cache
+uint32_t mock_program_load_count = 0; // PROGRAM LOAD commands (x1 or x4)
+uint32_t mock_unaligned_tx = 0; // Data sent from buffers the driver would
+                                // copy to a DMA buffer (not word aligned)
+uint32_t mock_busy_loads = 0;   // Program loads taken while busy
+uint32_t mock_busy_rejects = 0; // Commands ignored while busy
+int mock_prog_fail_block = -1;  // Programs to this block fail (P_FAIL)
+uint32_t mock_erase_count = 0;  // BLOCK_ERASE commands executed
+static int64_t busy_until = 0;
+
+// Queued transactions are executed at once, results are kept in order
+static spi_transaction_t *trans_queue[MOCK_QUEUE_SIZE];
+static int trans_queue_head = 0;
+static int trans_queue_count = 0;
+static bool bus_acquired = false;
 
 // Helper to init memory if not already done
 static void mock_spi_init_mem(void) {
@@ -95,7 +126,65 @@ void mock_nand_reset(void) {
   status_reg = 0;
   write_enabled = false;
   data_input_mode = 0;
+  data_output_mode = 0;
+  quad_data = false;
+  cfg_reg = 0;
+  mock_quad_bytes = 0;
+  mock_cache_read_count = 0;
+  mock_cache_read_bytes = 0;
+  mock_program_load_count = 0;
+  mock_unaligned_tx = 0;
+  mock_busy_loads = 0;
+  mock_busy_rejects = 0;
+  mock_prog_fail_block = -1;
+  mock_erase_count = 0;
+  trans_queue_head = 0;
+  trans_queue_count = 0;
+  bus_acquired = false;
+  data_reg_addr = 0;
   mock_mfr_id = 0xEF;
+  mock_busy_us = 0;
+  busy_until = 0;
+}
+
+static int64_t mock_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Winbond and Micron have no QE bit, x4 instructions always work. Others
+// need QE set in the configuration register.
+static bool mock_quad_enabled(void) {
+  return mock_mfr_id == 0xEF || mock_mfr_id == 0x2C || (cfg_reg & 0x01);
+}
+
+// Micron takes a program load to the cache while a page is programmed
+static bool mock_cache_program(uint8_t cmd) {
+  return mock_mfr_id == 0x2C &&
+         (cmd == CMD_PROGRAM_LOAD || cmd == CMD_RANDOM_DATA_INPUT ||
+          cmd == CMD_PROGRAM_LOAD_X4 || cmd == CMD_RANDOM_DATA_INPUT_X4);
+}
+
+// The chip reports busy for mock_busy_us after an array operation
+static void mock_set_busy(void) {
+  if (mock_busy_us > 0)
+    busy_until = mock_time_us() + mock_busy_us;
+}
+
+// Copy a page (data + spare) from the array to the cache
+static void load_page_to_cache(uint32_t addr) {
+  uint32_t block = addr / MOCK_PAGES_PER_BLOCK;
+  uint32_t page = addr % MOCK_PAGES_PER_BLOCK;
+
+  if (block < MOCK_TOTAL_BLOCKS && flash_mem[block] &&
+      flash_mem[block][page]) {
+    mock_page_t *p = flash_mem[block][page];
+    memcpy(page_cache, p->data, MOCK_PAGE_SIZE);
+    memcpy(page_cache + MOCK_PAGE_SIZE, p->spare, MOCK_SPARE_SIZE);
+  } else {
+    memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
+  }
 }
 
 static mock_page_t *get_page_alloc(int block, int page) {
@@ -143,9 +232,17 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
   size_t tx_len = trans_desc->length / 8;
   size_t rx_len = trans_desc->rxlength / 8;
 
+  // Like the real driver, keeping CS active needs the bus acquired
+  if ((trans_desc->flags & SPI_TRANS_CS_KEEP_ACTIVE) && !bus_acquired)
+    return ESP_ERR_INVALID_ARG;
+
   if (!tx && !rx)
     return ESP_OK;
 
+  // Commands are short, longer transfers are data the driver sends by DMA
+  if (tx && tx_len > 4 && (((uintptr_t)tx & 3) || (tx_len & 3)))
+    mock_unaligned_tx++;
+
   // DEBUG TRACE
   if (tx && tx_len > 0) {
     if (!data_input_mode)
@@ -156,6 +253,29 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
     ESP_LOGV(TAG, "Transmit (No TX data or Data Phase)");
   }
 
+  // Data phase of an x4 command must be sent on 4 lines, and only then
+  if (!!(trans_desc->flags & SPI_TRANS_MODE_QIO) != quad_data) {
+    ESP_LOGE(TAG, "Unexpected transfer mode, flags 0x%" PRIx32,
+             trans_desc->flags);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (quad_data) {
+    quad_data = false;
+    mock_quad_bytes += tx_len + rx_len;
+  }
+
+  // Handle x4 Data Output Phase
+  if (data_output_mode && !tx && rx && rx_len > 0) {
+    mock_cache_read_bytes += rx_len;
+    if (current_col_addr < MOCK_CACHE_SIZE) {
+      size_t available = MOCK_CACHE_SIZE - current_col_addr;
+      memcpy(rx, page_cache + current_col_addr,
+             rx_len < available ? rx_len : available);
+    }
+    data_output_mode = 0;
+    return ESP_OK;
+  }
+
   // Handle Data Input Phase
   if (data_input_mode && tx && tx_len > 0) {
     size_t available = MOCK_CACHE_SIZE - current_col_addr;
@@ -172,17 +292,43 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
   if (tx && tx_len > 0) {
     uint8_t cmd = tx[0];
 
+    // Only the status can be read while the array is busy
+    if (busy_until > mock_time_us() && cmd != CMD_GET_FEATURE &&
+        cmd != CMD_RESET) {
+      if (!mock_cache_program(cmd)) {
+        ESP_LOGW(TAG, "Cmd 0x%02X ignored, busy", cmd);
+        mock_busy_rejects++;
+        return ESP_OK;
+      }
+      mock_busy_loads++;
+    }
+
     switch (cmd) {
     case CMD_RESET:
-      mock_nand_reset(); // Full reset
+      // Device reset: flash array content survives, like a real chip
+      memset(page_cache, 0xFF, sizeof(page_cache));
+      status_reg = 0;
+      write_enabled = false;
+      data_input_mode = 0;
+      data_output_mode = 0;
+      quad_data = false;
       break;
 
     case CMD_GET_FEATURE: // 0x0F + Addr
       if (tx_len >= 2 && tx[1] == 0xC0 && rx && rx_len > 0) {
         rx[0] = status_reg;
+        if (busy_until > mock_time_us())
+          rx[0] |= (1 << 0); // OIP
+      } else if (tx_len >= 2 && tx[1] == 0xB0 && rx && rx_len > 0) {
+        rx[0] = cfg_reg;
       }
       break;
 
+    case CMD_SET_FEATURE: // 0x1F + Addr + Value
+      if (tx_len >= 3 && tx[1] == 0xB0)
+        cfg_reg = tx[2];
+      break;
+
     case CMD_READ_ID: // 0x9F + Dummy
       if (rx && rx_len >= 2) {
         rx[0] = mock_mfr_id; // dynamic
@@ -199,30 +345,29 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
       if (tx_len >= 4) {
         uint32_t addr = (tx[1] << 16) | (tx[2] << 8) | tx[3];
         ESP_LOGV(TAG, "PAGE_READ Addr 0x%06" PRIx32, addr);
-        uint32_t block = addr / MOCK_PAGES_PER_BLOCK;
-        uint32_t page = addr % MOCK_PAGES_PER_BLOCK;
-
-        if (block < MOCK_TOTAL_BLOCKS) {
-          // Check if block table exists
-          if (flash_mem[block]) {
-            mock_page_t *p = flash_mem[block][page];
-            if (p) {
-              memcpy(page_cache, p->data, MOCK_PAGE_SIZE);
-              memcpy(page_cache + MOCK_PAGE_SIZE, p->spare, MOCK_SPARE_SIZE);
-            } else {
-              memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
-            }
-          } else {
-            memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
-          }
-        } else {
-          memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
-        }
+        mock_page_read_count++;
+        load_page_to_cache(addr);
+        data_reg_addr = addr;
+        mock_set_busy();
       }
       break;
 
+    case CMD_READ_CACHE_SEQ: // 0x31: data register to cache, load next page
+      mock_read_seq_count++;
+      load_page_to_cache(data_reg_addr++);
+      mock_set_busy();
+      break;
+
+    case CMD_READ_CACHE_END: // 0x3F: data register to cache, no next page
+      mock_read_seq_count++;
+      load_page_to_cache(data_reg_addr);
+      mock_set_busy();
+      break;
+
     case CMD_READ_CACHE: // 0x03 + 2 col + 1 dummy
+      mock_cache_read_count++;
       if (tx_len >= 4 && rx && rx_len > 0) {
+        mock_cache_read_bytes += rx_len;
         uint16_t col = (tx[1] << 8) | tx[2];
         if (col < MOCK_CACHE_SIZE) {
           size_t to_read = (rx_len < (MOCK_CACHE_SIZE - col))
@@ -233,19 +378,51 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
       }
       break;
 
-    case CMD_PROGRAM_LOAD: // 0x02 + 2 col
-      if (tx_len >= 3) {
+    case CMD_READ_CACHE_X4: // 0x6B + 2 col + 1 dummy, data on 4 lines
+      mock_cache_read_count++;
+      if (tx_len >= 4 && mock_quad_enabled()) {
+        current_col_addr = (tx[1] << 8) | tx[2];
+        data_output_mode = 1;
+        quad_data = true;
+      }
+      break;
+
+    case CMD_PROGRAM_LOAD_X4: // 0x32 + 2 col, data on 4 lines
+      mock_program_load_count++;
+      if (tx_len >= 3 && mock_quad_enabled()) {
         current_col_addr = (tx[1] << 8) | tx[2];
         memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
         data_input_mode = 1;
+        quad_data = true;
+      }
+      break;
+
+    case CMD_RANDOM_DATA_INPUT_X4: // 0x34 + 2 col, data on 4 lines
+      mock_program_load_count++;
+      if (tx_len >= 3 && mock_quad_enabled()) {
+        current_col_addr = (tx[1] << 8) | tx[2];
+        data_input_mode = 1;
+        quad_data = true;
       }
       break;
 
-    case CMD_RANDOM_DATA_INPUT: // 0x84 + 2 col
+    case CMD_PROGRAM_LOAD: // 0x02 + 2 col (+ data)
+    case CMD_RANDOM_DATA_INPUT: // 0x84 + 2 col (+ data)
+      mock_program_load_count++;
       if (tx_len >= 3) {
         current_col_addr = (tx[1] << 8) | tx[2];
+        if (cmd == CMD_PROGRAM_LOAD)
+          memset(page_cache, 0xFF, MOCK_CACHE_SIZE);
         data_input_mode = 1;
       }
+      if (tx_len > 3 && current_col_addr < MOCK_CACHE_SIZE) {
+        // Data in the same transaction as the command
+        size_t available = MOCK_CACHE_SIZE - current_col_addr;
+        size_t copy_len = tx_len - 3 < available ? tx_len - 3 : available;
+        memcpy(page_cache + current_col_addr, tx + 3, copy_len);
+        current_col_addr += copy_len;
+        data_input_mode = 0;
+      }
       break;
 
     case CMD_PROGRAM_EXECUTE: // 0x10 + 3 addr
@@ -255,7 +432,10 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
         uint32_t block = addr / MOCK_PAGES_PER_BLOCK;
         uint32_t page = addr % MOCK_PAGES_PER_BLOCK;
 
-        if (block < MOCK_TOTAL_BLOCKS) {
+        status_reg &= ~(1 << 3); // P_FAIL is of the last program
+        if (block == (uint32_t)mock_prog_fail_block) {
+          status_reg |= (1 << 3);
+        } else if (block < MOCK_TOTAL_BLOCKS) {
           mock_page_t *p = get_page_alloc(block, page);
           if (p) {
             // NAND programming checks: can only change 1 to 0
@@ -270,14 +450,15 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
             ESP_LOGE(TAG,
                      "Mock Flash Full! Alloc failed for B%" PRIu32 ":P%" PRIu32,
                      block, page);
-            status_reg |= (1 << 2); // Set P_FAIL (Bit 2)
+            status_reg |= (1 << 3); // Set P_FAIL (Bit 3)
           }
         } else {
           ESP_LOGE(TAG, "Access out of bounds: B%" PRIu32, block);
-          status_reg |= (1 << 2); // Set P_FAIL (Bit 2)
+          status_reg |= (1 << 3); // Set P_FAIL (Bit 3)
         }
         write_enabled = false;
         status_reg &= ~(1 << 1);
+        mock_set_busy();
       }
       break;
 
@@ -287,6 +468,7 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
         ESP_LOGV(TAG, "BLOCK_ERASE Addr 0x%06" PRIx32, addr);
 
         uint32_t block = addr / MOCK_PAGES_PER_BLOCK;
+        mock_erase_count++;
         if (block < MOCK_TOTAL_BLOCKS) {
           // Only erase if block table allocated
           if (flash_mem[block]) {
@@ -304,6 +486,7 @@ esp_err_t spi_device_transmit(spi_device_handle_t handle,
         }
         write_enabled = false;
         status_reg &= ~(1 << 1);
+        mock_set_busy();
       }
       break;
 
@@ -319,3 +502,40 @@ esp_err_t spi_device_polling_transmit(spi_device_handle_t handle,
                                       spi_transaction_t *trans_desc) {
   return spi_device_transmit(handle, trans_desc);
 }
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle,
+                                 spi_transaction_t *trans_desc,
+                                 TickType_t ticks_to_wait) {
+  if (trans_queue_count == MOCK_QUEUE_SIZE)
+    return ESP_ERR_TIMEOUT;
+
+  esp_err_t ret = spi_device_transmit(handle, trans_desc);
+  if (ret != ESP_OK)
+    return ret;
+
+  trans_queue[(trans_queue_head + trans_queue_count) % MOCK_QUEUE_SIZE] =
+      trans_desc;
+  trans_queue_count++;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait) {
+  if (trans_queue_count == 0)
+    return ESP_ERR_TIMEOUT;
+
+  *trans_desc = trans_queue[trans_queue_head];
+  trans_queue_head = (trans_queue_head + 1) % MOCK_QUEUE_SIZE;
+  trans_queue_count--;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait) {
+  if (bus_acquired)
+    return ESP_ERR_INVALID_STATE;
+  bus_acquired = true;
+  return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t dev) { bus_acquired = false; }
@@ -1,21 +1,32 @@
 #include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_spi_nand.h"
+#include "esp_spi_nand_common.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "uffs/uffs.h"
+#include "uffs/uffs_blockinfo.h"
+#include "uffs/uffs_buf.h"
+#include "uffs/uffs_crc.h"
+#include "uffs/uffs_ecc.h"
 #include "uffs/uffs_fd.h"
+#include "uffs/uffs_flash.h"
 #include "uffs/uffs_mtb.h"
 #include "uffs/uffs_os.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_tree.h"
 #include "unity.h"
+#include <inttypes.h>
 #include <stdarg.h> // for va_list
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 
 static const char *TAG = "test_main";
 
 extern void mock_nand_reset(void); // Defined in mock_spi_master.c
+extern uint32_t mock_page_read_count; // From mock_spi_master.c
 
 #define PFX "TEST: "
 
@@ -249,6 +260,131 @@ TEST_CASE("uffs bandwidth test", "[uffs][bandwidth]") {
   free(chunk);
 }
 
+// Byte-at-a-time CRC16, the way uffs_crc16update() used to be
+static u16 crc16_bytewise(const u16 *tbl, const u8 *p, int len, u16 crc) {
+  for (int i = 0; i < len; i++)
+    crc = (crc >> 8) ^ tbl[(crc ^ p[i]) & 0xFF];
+  return crc;
+}
+
+static double crc16_mbps(u16 (*f)(const void *, int, u16), const u8 *p,
+                         int len, int rounds) {
+  struct timeval start, end;
+  volatile u16 sink = 0;
+
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < rounds; i++)
+    sink ^= f(p, len, 0xFFFF);
+  gettimeofday(&end, NULL);
+  (void)sink;
+
+  double elapsed =
+      (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+  if (elapsed <= 0)
+    elapsed = 1e-6;
+  return (len * (double)rounds / 1024.0 / 1024.0) / elapsed;
+}
+
+static u16 crc_tbl[256];
+
+static u16 crc16_bytewise_f(const void *p, int len, u16 crc) {
+  return crc16_bytewise(crc_tbl, p, len, crc);
+}
+
+TEST_CASE("uffs crc16 bandwidth", "[uffs][bandwidth]") {
+  const int PAGE = 2048, ROUNDS = 2048;
+  u8 *buf = malloc(PAGE + 4);
+  TEST_ASSERT_NOT_NULL(buf);
+
+  for (int i = 0; i < 256; i++) {
+    u16 c = i;
+    for (int b = 0; b < 8; b++)
+      c = (c & 1) ? (c >> 1) ^ 0x8408 : c >> 1;
+    crc_tbl[i] = c;
+  }
+  for (int i = 0; i < PAGE + 4; i++)
+    buf[i] = (u8)rand();
+
+  // Same CRC at any alignment and length, with or without a hook
+  for (int align = 0; align < 4; align++) {
+    for (int len = 0; len <= 67; len++) {
+      u16 ref = crc16_bytewise(crc_tbl, buf + align, len, 0xFFFF);
+      TEST_ASSERT_EQUAL_HEX16(ref,
+                              uffs_crc16update_table(buf + align, len, 0xFFFF));
+      TEST_ASSERT_EQUAL_HEX16(ref, uffs_crc16sum(buf + align, len));
+    }
+    TEST_ASSERT_EQUAL_HEX16(crc16_bytewise(crc_tbl, buf + align, PAGE, 0x1234),
+                            uffs_crc16update(buf + align, PAGE, 0x1234));
+  }
+
+  ESP_LOGI(TAG, "CRC16 byte: %.2f MB/s",
+           crc16_mbps(crc16_bytewise_f, buf, PAGE, ROUNDS));
+  ESP_LOGI(TAG, "CRC16 slicing-by-4: %.2f MB/s",
+           crc16_mbps(uffs_crc16update_table, buf, PAGE, ROUNDS));
+#ifdef CONFIG_UFFS_ROM_CRC16
+  ESP_LOGI(TAG, "CRC16 ROM: %.2f MB/s",
+           crc16_mbps(uffs_crc16update, buf, PAGE, ROUNDS));
+#endif
+
+  free(buf);
+}
+
+static double ecc_mbps(const u8 *p, int len, int rounds) {
+  struct timeval start, end;
+  u8 ecc[UFFS_MAX_ECC_SIZE];
+
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < rounds; i++)
+    uffs_EccMake(p, len, ecc);
+  gettimeofday(&end, NULL);
+
+  double elapsed =
+      (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+  if (elapsed <= 0)
+    elapsed = 1e-6;
+  return (len * (double)rounds / 1024.0 / 1024.0) / elapsed;
+}
+
+TEST_CASE("uffs soft ecc bandwidth", "[uffs][bandwidth]") {
+  const int PAGE = 2048, ROUNDS = 1024;
+  u8 *word = malloc(PAGE); // aligned: 4 bytes a round
+  u8 *raw = malloc(PAGE + 1);
+  u8 *byte = raw + 1; // unaligned: a byte a round, as before
+  u8 ecc_w[UFFS_MAX_ECC_SIZE], ecc_b[UFFS_MAX_ECC_SIZE];
+  TEST_ASSERT_NOT_NULL(word);
+  TEST_ASSERT_NOT_NULL(raw);
+
+  // Both kernels give the same ECC for any data and length
+  for (int round = 0; round < 256; round++) {
+    int len = 1 + rand() % PAGE;
+    for (int i = 0; i < len; i++)
+      word[i] = (round & 7) == 0 ? 0xFF : (u8)rand();
+    memcpy(byte, word, len);
+    int n = uffs_EccMake(word, len, ecc_w);
+    TEST_ASSERT_EQUAL(n, uffs_EccMake(byte, len, ecc_b));
+    TEST_ASSERT_EQUAL_MEMORY(ecc_b, ecc_w, n);
+  }
+
+  // A single bit flip is still located and corrected
+  for (int i = 0; i < PAGE; i++)
+    word[i] = (u8)rand();
+  memcpy(byte, word, PAGE);
+  uffs_EccMake(word, PAGE, ecc_w);
+  for (int round = 0; round < 64; round++) {
+    int bit = rand() % (PAGE * 8);
+    word[bit / 8] ^= 1 << (bit % 8);
+    uffs_EccMake(word, PAGE, ecc_b);
+    TEST_ASSERT_EQUAL(1, uffs_EccCorrect(word, PAGE, ecc_w, ecc_b));
+    TEST_ASSERT_EQUAL_MEMORY(byte, word, PAGE);
+  }
+
+  ESP_LOGI(TAG, "ECC byte: %.2f MB/s", ecc_mbps(byte, PAGE, ROUNDS));
+  ESP_LOGI(TAG, "ECC word: %.2f MB/s", ecc_mbps(word, PAGE, ROUNDS));
+
+  free(word);
+  free(raw);
+}
+
 // Test initialization for all supported vendors
 extern uint8_t mock_mfr_id; // From mock_spi_master.c
 
@@ -429,6 +565,1470 @@ TEST_CASE("runtime flash size check", "[uffs][init]") {
   }
 }
 
+// Erased block taken off the tree for tests that program the flash directly,
+// so that UFFS neither hands it out nor keeps stale info on it meanwhile
+static TreeNode *scratch_block_get(void) {
+  TreeNode *node = uffs_TreeGetErasedNode(&uffs_dev);
+  TEST_ASSERT_NOT_NULL(node);
+  return node;
+}
+
+// Erase a block from scratch_block_get() and give it back to the tree
+static void scratch_block_put(TreeNode *node) {
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_TreeEraseNode(&uffs_dev, node));
+  uffs_TreeInsertToErasedListTail(&uffs_dev, node);
+}
+
+static void unmount_for_full_scan(void) {
+#ifdef CONFIG_TREE_CHECKPOINT
+  // No checkpoint, so the next mount scans all blocks
+  uffs_dev.ckpt.state = UFFS_CKPT_STATE_DISABLED;
+  for (int i = 0; i < UFFS_CKPT_BLOCKS; i++)
+    uffs_dev.ops->EraseBlock(&uffs_dev, uffs_dev.ckpt.start + i);
+#endif
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+}
+
+TEST_CASE("uffs block info cache", "[uffs][cache]") {
+  const int n = uffs_dev.bc.count;
+  const int base = 0x8000; // not real blocks, never loaded from flash
+  uffs_BlockInfo **bc = malloc(n * sizeof(uffs_BlockInfo *));
+  TEST_ASSERT_NOT_NULL(bc);
+
+  TEST_ASSERT_TRUE(uffs_BlockInfoIsAllFree(&uffs_dev));
+  for (int i = 0; i < n; i++) {
+    bc[i] = uffs_BlockInfoGet(&uffs_dev, base + i * 3);
+    TEST_ASSERT_NOT_NULL(bc[i]);
+  }
+  // All referenced, nothing to reuse
+  TEST_ASSERT_NULL(uffs_BlockInfoGet(&uffs_dev, base - 1));
+
+  for (int i = 0; i < n; i++)
+    uffs_BlockInfoPut(&uffs_dev, bc[i]);
+  for (int i = n - 1; i >= 0; i--) {
+    TEST_ASSERT_EQUAL_PTR(bc[i],
+                          uffs_BlockInfoFindInCache(&uffs_dev, base + i * 3));
+    uffs_BlockInfoPut(&uffs_dev, bc[i]);
+  }
+
+  // Least recently released ones are reused first, the rest stay cached
+  for (int i = 0; i < n / 2; i++) {
+    uffs_BlockInfo *p = uffs_BlockInfoGet(&uffs_dev, base + i * 3 + 1);
+    TEST_ASSERT_EQUAL_PTR(bc[n - 1 - i], p);
+    uffs_BlockInfoPut(&uffs_dev, p);
+  }
+  for (int i = 0; i < n; i++) {
+    uffs_BlockInfo *p = uffs_BlockInfoFindInCache(&uffs_dev, base + i * 3);
+    if (i >= n - n / 2) {
+      TEST_ASSERT_NULL(p);
+    } else {
+      TEST_ASSERT_EQUAL_PTR(bc[i], p);
+      uffs_BlockInfoPut(&uffs_dev, p);
+    }
+  }
+  TEST_ASSERT_TRUE(uffs_BlockInfoIsAllFree(&uffs_dev));
+  free(bc);
+}
+
+// Every cached page must be found through the buffer index
+static void check_page_buffer_index(void) {
+  for (uffs_Buf *buf = uffs_dev.buf.head; buf; buf = buf->next) {
+    if (buf->mark == UFFS_BUF_EMPTY)
+      continue;
+    TEST_ASSERT_EQUAL_PTR(buf, uffs_BufFind(&uffs_dev, buf->parent, buf->serial,
+                                            buf->page_id));
+  }
+}
+
+TEST_CASE("uffs page buffer cache", "[uffs][cache]") {
+  const int len = uffs_dev.com.pg_data_size * uffs_dev.buf.buf_max * 2;
+  uint8_t *data = malloc(len);
+  uint8_t *rd = malloc(len);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < len; i++)
+    data[i] = (uint8_t)(i * 7 + i / 251);
+
+  // More pages than buffers, victims are taken from the free list
+  int fd = uffs_open("/data/pbuf.bin", UO_CREATE | UO_TRUNC | UO_RDWR, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(len, uffs_write(fd, data, len));
+  check_page_buffer_index();
+  uffs_seek(fd, 0, USEEK_SET);
+  TEST_ASSERT_EQUAL(len, uffs_read(fd, rd, len));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+  check_page_buffer_index();
+  uffs_close(fd);
+
+  // Rename moves the cached file header page to the new parent
+  TEST_ASSERT_EQUAL(0, uffs_mkdir("/data/pbuf_dir/"));
+  TEST_ASSERT_EQUAL(0, uffs_rename("/data/pbuf.bin", "/data/pbuf_dir/pbuf.bin"));
+  check_page_buffer_index();
+  fd = uffs_open("/data/pbuf_dir/pbuf.bin", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  memset(rd, 0, len);
+  TEST_ASSERT_EQUAL(len, uffs_read(fd, rd, len));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+  uffs_close(fd);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/pbuf_dir/pbuf.bin"));
+  TEST_ASSERT_EQUAL(0, uffs_rmdir("/data/pbuf_dir/"));
+  check_page_buffer_index();
+  TEST_ASSERT_TRUE(uffs_BufIsAllFree(&uffs_dev));
+  free(rd);
+  free(data);
+}
+
+static int count_page_buffers(void) {
+  int n = 0;
+  for (uffs_Buf *buf = uffs_dev.buf.head; buf; buf = buf->next) {
+    if (buf->mark != UFFS_BUF_EMPTY)
+      n++;
+  }
+  return n;
+}
+
+TEST_CASE("uffs direct page read", "[uffs][cache]") {
+  const int pg = uffs_dev.com.pg_data_size;
+  const int len = pg * uffs_dev.attr->pages_per_block * 2 + pg / 2;
+  uint8_t *data = malloc(len);
+  uint8_t *rd = malloc(len);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < len; i++)
+    data[i] = (uint8_t)(i * 13 + i / 509);
+
+  int fd = uffs_open("/data/direct.bin", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(len, uffs_write(fd, data, len));
+  uffs_close(fd);
+
+  // Drop cached pages so they have to come from flash
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+
+  int before = count_page_buffers();
+  fd = uffs_open("/data/direct.bin", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  memset(rd, 0, len);
+  TEST_ASSERT_EQUAL(len, uffs_read(fd, rd, len));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+  // Only the first and the partial last page go through page buffers
+  TEST_ASSERT_LESS_OR_EQUAL(before + 3, count_page_buffers());
+
+  // Unaligned reads mix both paths
+  uffs_seek(fd, pg / 3, USEEK_SET);
+  memset(rd, 0, len);
+  TEST_ASSERT_EQUAL(len - pg / 3, uffs_read(fd, rd, len));
+  TEST_ASSERT_EQUAL_MEMORY(data + pg / 3, rd, len - pg / 3);
+  uffs_close(fd);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/direct.bin"));
+  free(rd);
+  free(data);
+}
+
+#ifdef CONFIG_UFFS_DIRECT_WRITE
+TEST_CASE("uffs direct page write", "[uffs][cache]") {
+  const int pg = uffs_dev.com.pg_data_size;
+  const int frame = 4096;
+  const int len = pg * uffs_dev.attr->pages_per_block * 2 + pg / 2;
+  uint8_t *data = malloc(len);
+  uint8_t *rd = malloc(len);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < len; i++)
+    data[i] = (uint8_t)(i * 11 + i / 263);
+
+  int before = count_page_buffers();
+  int fd = uffs_open("/data/dwrite.bin", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(len, uffs_write(fd, data, len));
+  // Whole pages are not staged in page buffers
+  TEST_ASSERT_LESS_OR_EQUAL(before + 4, count_page_buffers());
+  uffs_close(fd);
+
+  // Append in frames, starting from a partial page
+  fd = uffs_open("/data/dwrite.bin", UO_WRONLY | UO_APPEND, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  for (int ofs = 0; ofs < len; ofs += frame) {
+    int n = len - ofs < frame ? len - ofs : frame;
+    TEST_ASSERT_EQUAL(n, uffs_write(fd, data + ofs, n));
+  }
+  uffs_close(fd);
+
+  unmount_for_full_scan();
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+
+  fd = uffs_open("/data/dwrite.bin", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  for (int round = 0; round < 2; round++) {
+    memset(rd, 0, len);
+    TEST_ASSERT_EQUAL(len, uffs_read(fd, rd, len));
+    TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+  }
+  uffs_close(fd);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/dwrite.bin"));
+  free(rd);
+  free(data);
+}
+#endif
+
+#if CONFIG_UFFS_READ_AHEAD_PAGES > 0
+extern uint32_t mock_read_seq_count; // From mock_spi_master.c
+
+static uint32_t read_in_chunks(const char *name, uint8_t *rd, int len) {
+  const int chunk = 512;
+  int fd = uffs_open(name, UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  memset(rd, 0, len);
+  mock_page_read_count = 0;
+  for (int ofs = 0; ofs < len; ofs += chunk) {
+    int n = len - ofs < chunk ? len - ofs : chunk;
+    TEST_ASSERT_EQUAL(n, uffs_read(fd, rd + ofs, n));
+  }
+  uint32_t reads = mock_page_read_count;
+  uffs_close(fd);
+  return reads;
+}
+
+TEST_CASE("uffs sequential read-ahead", "[uffs][cache]") {
+  const int pg = uffs_dev.com.pg_data_size;
+  const int len = pg * (uffs_dev.attr->pages_per_block + 8) + 100;
+  uint8_t *data = malloc(len);
+  uint8_t *rd = malloc(len);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < len; i++)
+    data[i] = (uint8_t)(i * 5 + i / 127);
+
+  int fd = uffs_open("/data/ahead.bin", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(len, uffs_write(fd, data, len));
+  uffs_close(fd);
+
+  // Page by page without cache read sequential support
+  uffs_dev.ops->ReadPageSeq = NULL;
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  uint32_t plain_reads = read_in_chunks("/data/ahead.bin", rd, len);
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+
+  uffs_dev.ops->ReadPageSeq = uffs_spi_nand_read_page_seq_generic;
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  mock_read_seq_count = 0;
+  uint32_t ahead_reads = read_in_chunks("/data/ahead.bin", rd, len);
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+  ESP_LOGI(TAG, "Sequential read: %" PRIu32 " page reads, %" PRIu32
+           " with read-ahead (%" PRIu32 " sequential)",
+           plain_reads, ahead_reads, mock_read_seq_count);
+  TEST_ASSERT_GREATER_THAN(0, mock_read_seq_count);
+  TEST_ASSERT_LESS_THAN(plain_reads, ahead_reads);
+  check_page_buffer_index();
+
+  // Seeking around is not sequential, data still correct
+  fd = uffs_open("/data/ahead.bin", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  for (int ofs = len - 300; ofs > 0; ofs -= pg + 777) {
+    uint8_t tmp[300];
+    uffs_seek(fd, ofs, USEEK_SET);
+    TEST_ASSERT_EQUAL(sizeof(tmp), uffs_read(fd, tmp, sizeof(tmp)));
+    TEST_ASSERT_EQUAL_MEMORY(data + ofs, tmp, sizeof(tmp));
+  }
+  uffs_close(fd);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/ahead.bin"));
+  TEST_ASSERT_TRUE(uffs_BufIsAllFree(&uffs_dev));
+  free(rd);
+  free(data);
+}
+#endif
+
+// Every DIR/FILE node on tree must be in the child entry of its parent
+static void check_child_index(void) {
+  struct uffs_TreeSt *tree = &uffs_dev.tree;
+  uffs_Pool *pool = &uffs_dev.mem.tree_pool;
+
+  for (int type = UFFS_TYPE_DIR; type <= UFFS_TYPE_FILE; type++) {
+    u16 *entry = type == UFFS_TYPE_DIR ? tree->dir_entry : tree->file_entry;
+    u16 *child = type == UFFS_TYPE_DIR ? tree->dir_child : tree->file_child;
+    int len = type == UFFS_TYPE_DIR ? DIR_NODE_ENTRY_LEN : FILE_NODE_ENTRY_LEN;
+    int on_tree = 0, indexed = 0;
+    TreeNode *node;
+
+    for (int i = 0; i < len; i++) {
+      for (u16 x = entry[i]; x != EMPTY_NODE; x = node->hash_next) {
+        node = FROM_IDX(x, pool);
+        on_tree++;
+      }
+    }
+    for (int i = 0; i < CHILD_NODE_ENTRY_LEN; i++) {
+      for (u16 x = child[i]; x != EMPTY_NODE; x = node->child_next) {
+        node = FROM_IDX(x, pool);
+        u16 parent = type == UFFS_TYPE_DIR ? node->u.dir.parent
+                                           : node->u.file.parent;
+        TEST_ASSERT_EQUAL(i, GET_CHILD_HASH(parent));
+        indexed++;
+      }
+    }
+    TEST_ASSERT_EQUAL(on_tree, indexed);
+  }
+}
+
+static int count_dir(const char *path) {
+  int n = 0;
+  uffs_DIR *dir = uffs_opendir(path);
+  TEST_ASSERT_NOT_NULL(dir);
+  while (uffs_readdir(dir) != NULL)
+    n++;
+  uffs_closedir(dir);
+  return n;
+}
+
+TEST_CASE("uffs directory child index", "[uffs][tree]") {
+  const int big = 40;
+  char name[48];
+
+  TEST_ASSERT_EQUAL(0, uffs_mkdir("/data/ci_big/"));
+  TEST_ASSERT_EQUAL(0, uffs_mkdir("/data/ci_small/"));
+  TEST_ASSERT_EQUAL(0, uffs_mkdir("/data/ci_small/sub/"));
+  for (int i = 0; i < big; i++) {
+    snprintf(name, sizeof(name), "/data/ci_big/f%d", i);
+    int fd = uffs_open(name, UO_CREATE | UO_WRONLY, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    uffs_close(fd);
+  }
+  for (int i = 0; i < 3; i++) {
+    snprintf(name, sizeof(name), "/data/ci_small/s%d", i);
+    int fd = uffs_open(name, UO_CREATE | UO_WRONLY, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    uffs_close(fd);
+  }
+  check_child_index();
+  TEST_ASSERT_EQUAL(4, count_dir("/data/ci_small/"));
+  TEST_ASSERT_EQUAL(big, count_dir("/data/ci_big/"));
+
+  // Moving to another directory moves the node to the new parent's entry
+  TEST_ASSERT_EQUAL(0, uffs_rename("/data/ci_big/f7", "/data/ci_small/f7"));
+  TEST_ASSERT_EQUAL(0, uffs_rename("/data/ci_small/sub/", "/data/ci_big/sub/"));
+  check_child_index();
+  TEST_ASSERT_EQUAL(4, count_dir("/data/ci_small/"));
+  TEST_ASSERT_EQUAL(big, count_dir("/data/ci_big/"));
+  TEST_ASSERT_EQUAL(0, count_dir("/data/ci_big/sub/"));
+  TEST_ASSERT_NOT_EQUAL(0, uffs_rmdir("/data/ci_small/"));
+
+  // Index is rebuilt the same by a full scan
+  unmount_for_full_scan();
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  check_child_index();
+  TEST_ASSERT_EQUAL(4, count_dir("/data/ci_small/"));
+  TEST_ASSERT_EQUAL(big, count_dir("/data/ci_big/"));
+
+  for (int i = 0; i < big; i++) {
+    snprintf(name, sizeof(name), "/data/ci_big/f%d", i);
+    uffs_remove(name);
+  }
+  for (int i = 0; i < 3; i++) {
+    snprintf(name, sizeof(name), "/data/ci_small/s%d", i);
+    TEST_ASSERT_EQUAL(0, uffs_remove(name));
+  }
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/ci_small/f7"));
+  TEST_ASSERT_EQUAL(0, uffs_rmdir("/data/ci_big/sub/"));
+  TEST_ASSERT_EQUAL(0, uffs_rmdir("/data/ci_big/"));
+  TEST_ASSERT_EQUAL(0, uffs_rmdir("/data/ci_small/"));
+  check_child_index();
+}
+
+// The lowest serial not used by a DIR/FILE node or a suspended node
+static u16 free_serial_by_scan(void) {
+  for (u16 i = ROOT_DIR_SERIAL + 1; i < MAX_UFFS_FSN; i++) {
+    if (!uffs_TreeFindDirNode(&uffs_dev, i) &&
+        !uffs_TreeFindFileNode(&uffs_dev, i) &&
+        !uffs_TreeFindSuspendNode(&uffs_dev, i))
+      return i;
+  }
+  return INVALID_UFFS_SERIAL;
+}
+
+TEST_CASE("uffs free serial bitmap", "[uffs][tree]") {
+  const int files = 12;
+  char name[48];
+
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+  for (int i = 0; i < files; i++) {
+    snprintf(name, sizeof(name), "/data/fsn%d", i);
+    int fd = uffs_open(name, UO_CREATE | UO_WRONLY, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    uffs_close(fd);
+  }
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+
+  // Holes left by deleted objects are reused lowest first
+  struct uffs_stat st;
+  TEST_ASSERT_EQUAL(0, uffs_stat("/data/fsn3", &st));
+  u16 hole = st.st_ino;
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/fsn3"));
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/fsn8"));
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+  TEST_ASSERT_LESS_OR_EQUAL(hole, uffs_FindFreeFsnSerial(&uffs_dev));
+
+  // Suspended serial is not handed out
+  TreeNode node;
+  node.u.list.u.serial = uffs_FindFreeFsnSerial(&uffs_dev);
+  uffs_TreeSuspendAdd(&uffs_dev, &node);
+  TEST_ASSERT_NOT_EQUAL(node.u.list.u.serial,
+                        uffs_FindFreeFsnSerial(&uffs_dev));
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+  uffs_TreeRemoveSuspendNode(&uffs_dev, &node);
+  TEST_ASSERT_EQUAL(node.u.list.u.serial, uffs_FindFreeFsnSerial(&uffs_dev));
+
+  // Rebuilt by the tree scan
+  unmount_for_full_scan();
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+
+  for (int i = 0; i < files; i++) {
+    snprintf(name, sizeof(name), "/data/fsn%d", i);
+    uffs_remove(name);
+  }
+  TEST_ASSERT_EQUAL(free_serial_by_scan(), uffs_FindFreeFsnSerial(&uffs_dev));
+}
+
+extern int mock_prog_fail_block; // From mock_spi_master.c
+
+// Block map must give the same owner as searching the lists
+static void check_block_map(void) {
+  u16 *map = uffs_dev.tree.block_map;
+  TEST_ASSERT_NOT_NULL(map);
+  for (u16 b = uffs_dev.par.start; b <= uffs_dev.par.end; b++) {
+    int all = SEARCH_REGION_DIR | SEARCH_REGION_FILE | SEARCH_REGION_DATA |
+              SEARCH_REGION_BAD | SEARCH_REGION_ERASED;
+    int r1 = all, r2 = all;
+    TreeNode *n1 = uffs_TreeFindNodeByBlock(&uffs_dev, b, &r1);
+    uffs_dev.tree.block_map = NULL;
+    TreeNode *n2 = uffs_TreeFindNodeByBlock(&uffs_dev, b, &r2);
+    uffs_dev.tree.block_map = map;
+    TEST_ASSERT_EQUAL_PTR(n2, n1);
+    TEST_ASSERT_EQUAL(r2, r1);
+  }
+}
+
+TEST_CASE("uffs block to node map", "[uffs][tree]") {
+  const int len = uffs_dev.com.pg_data_size * uffs_dev.attr->pages_per_block;
+  uint8_t *data = malloc(len);
+  TEST_ASSERT_NOT_NULL(data);
+  memset(data, 0xA5, len);
+
+  check_block_map();
+  int fd = uffs_open("/data/bmap.bin", UO_CREATE | UO_TRUNC | UO_RDWR, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(len, uffs_write(fd, data, len));
+  uffs_close(fd);
+  check_block_map();
+
+  // Program failure on the next erased block: it goes to the bad list
+  // and the buffers are flushed to another block
+  int block = uffs_dev.tree.erased->u.list.block;
+  int region = SEARCH_REGION_ERASED;
+  TEST_ASSERT_NOT_NULL(uffs_TreeFindNodeByBlock(&uffs_dev, block, &region));
+  mock_prog_fail_block = block;
+  fd = uffs_open("/data/bmap.bin", UO_RDWR, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  uffs_seek(fd, 100, USEEK_SET);
+  TEST_ASSERT_EQUAL(100, uffs_write(fd, data, 100));
+  uffs_close(fd);
+  mock_prog_fail_block = -1;
+  check_block_map();
+  region = SEARCH_REGION_ERASED | SEARCH_REGION_BAD;
+  TEST_ASSERT_NOT_NULL(uffs_TreeFindNodeByBlock(&uffs_dev, block, &region));
+  TEST_ASSERT_EQUAL(SEARCH_REGION_BAD, region);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/bmap.bin"));
+  check_block_map();
+  unmount_for_full_scan();
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  check_block_map();
+  free(data);
+}
+
+#if CONFIG_DENTRY_CACHE_ENTRIES > 0
+static int list_dir(const char *path, uint32_t *mask) {
+  int n = 0;
+  uffs_DIR *dir = uffs_opendir(path);
+  TEST_ASSERT_NOT_NULL(dir);
+  *mask = 0;
+  for (struct uffs_dirent *ent; (ent = uffs_readdir(dir)) != NULL; n++) {
+    int idx;
+    TEST_ASSERT_EQUAL(1, sscanf(ent->d_name, "dc%d.txt", &idx));
+    *mask |= 1u << idx;
+  }
+  uffs_closedir(dir);
+  return n;
+}
+
+TEST_CASE("uffs dentry cache", "[uffs][cache]") {
+  const int files = 8;
+  char name[48];
+  struct uffs_stat st;
+  uint32_t mask;
+
+  TEST_ASSERT_EQUAL(0, uffs_mkdir("/data/dc_dir/"));
+  for (int i = 0; i < files; i++) {
+    snprintf(name, sizeof(name), "/data/dc_dir/dc%d.txt", i);
+    int fd = uffs_open(name, UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    TEST_ASSERT_EQUAL(4, uffs_write(fd, "abcd", 4));
+    uffs_close(fd);
+  }
+
+  // Start from empty page buffers and dentry cache
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+
+  TEST_ASSERT_EQUAL(files, list_dir("/data/dc_dir/", &mask));
+  TEST_ASSERT_EQUAL_HEX32((1u << files) - 1, mask);
+
+  // Headers are cached now, listing and lookups need no page read
+  uint32_t reads = mock_page_read_count;
+  uint32_t hits = uffs_dev.dcache.hit;
+  TEST_ASSERT_EQUAL(files, list_dir("/data/dc_dir/", &mask));
+  for (int i = 0; i < files; i++) {
+    snprintf(name, sizeof(name), "/data/dc_dir/dc%d.txt", i);
+    TEST_ASSERT_EQUAL(0, uffs_stat(name, &st));
+    TEST_ASSERT_EQUAL(4, st.st_size);
+  }
+  TEST_ASSERT_EQUAL(reads, mock_page_read_count);
+  TEST_ASSERT_GREATER_OR_EQUAL(hits + files * 2, uffs_dev.dcache.hit);
+
+  // Rename and delete drop the cached names
+  TEST_ASSERT_EQUAL(0, uffs_rename("/data/dc_dir/dc1.txt", "/data/dc_dir/dc9.txt"));
+  TEST_ASSERT_NOT_EQUAL(0, uffs_stat("/data/dc_dir/dc1.txt", &st));
+  TEST_ASSERT_EQUAL(0, uffs_stat("/data/dc_dir/dc9.txt", &st));
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/dc_dir/dc2.txt"));
+  TEST_ASSERT_NOT_EQUAL(0, uffs_stat("/data/dc_dir/dc2.txt", &st));
+  TEST_ASSERT_EQUAL(files - 1, list_dir("/data/dc_dir/", &mask));
+  TEST_ASSERT_EQUAL_HEX32(((1u << files) - 1 - 0x6) | (1u << 9), mask);
+
+  for (int i = 0; i < 10; i++) {
+    snprintf(name, sizeof(name), "/data/dc_dir/dc%d.txt", i);
+    uffs_remove(name);
+  }
+  TEST_ASSERT_EQUAL(0, uffs_rmdir("/data/dc_dir/"));
+}
+#endif
+
+#ifdef CONFIG_FILE_EXTENTS
+#define EXT_BYTE(ofs) ((uint8_t)((ofs) ^ ((ofs) >> 8) ^ ((ofs) >> 16)))
+
+// Every remembered node must be the one the tree gives for that fdn
+static int check_extents(uffs_Object *obj) {
+  int n = 0;
+  for (int fdn = 0; fdn < obj->extent_cap; fdn++) {
+    if (obj->extents[fdn] == EMPTY_NODE)
+      continue;
+    TreeNode *node = uffs_TreeFindDataNode(&uffs_dev, obj->serial, fdn);
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL(TO_IDX(node, &uffs_dev.mem.tree_pool), obj->extents[fdn]);
+    n++;
+  }
+  return n;
+}
+
+// Read back len bytes at ofs, seeking there first
+static void check_extent_data(uffs_Object *obj, int ofs, int len) {
+  uint8_t buf[64];
+  TEST_ASSERT_EQUAL(ofs, uffs_SeekObject(obj, ofs, USEEK_SET));
+  TEST_ASSERT_EQUAL(len, uffs_ReadObject(obj, buf, len));
+  for (int i = 0; i < len; i++)
+    TEST_ASSERT_EQUAL_HEX8(EXT_BYTE(ofs + i), buf[i]);
+}
+
+TEST_CASE("uffs file extent table", "[uffs][cache]") {
+  const int blk = uffs_dev.com.pg_data_size * uffs_dev.attr->pages_per_block;
+  const int blocks = 6;
+  uint8_t *data = malloc(blk * blocks);
+  TEST_ASSERT_NOT_NULL(data);
+  for (int i = 0; i < blk * blocks; i++)
+    data[i] = EXT_BYTE(i);
+
+  int fd = uffs_open("/data/ext.bin", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(blk * blocks, uffs_write(fd, data, blk * blocks));
+  uffs_close(fd);
+
+  uffs_Object *obj = uffs_GetObject();
+  TEST_ASSERT_NOT_NULL(obj);
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_OpenObject(obj, "/data/ext.bin", UO_RDWR));
+  TEST_ASSERT_NULL(obj->extents);
+
+  // Random seeks, backwards then again, fill the table once
+  for (int b = blocks - 1; b >= 0; b--)
+    check_extent_data(obj, b * blk + b * 13, 64);
+  int found = check_extents(obj);
+  TEST_ASSERT_GREATER_OR_EQUAL(blocks - 1, found);
+  for (int b = 0; b < blocks; b++)
+    check_extent_data(obj, b * blk + blk - 64, 64);
+  TEST_ASSERT_GREATER_OR_EQUAL(found, check_extents(obj));
+
+  // Truncate drops data nodes, none of them may stay in the table
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_TruncateObject(obj, blk * 2 + 5));
+  TEST_ASSERT_EQUAL(uffs_dev.tree.data_gen, obj->extent_gen);
+  TEST_ASSERT_LESS_OR_EQUAL(3, check_extents(obj));
+  TEST_ASSERT_EQUAL(blk * 2 + 5, uffs_SeekObject(obj, 0, USEEK_END));
+  TEST_ASSERT_EQUAL(blk * blocks - (blk * 2 + 5),
+                    uffs_WriteObject(obj, data + blk * 2 + 5,
+                                     blk * blocks - (blk * 2 + 5)));
+  for (int b = blocks - 1; b >= 0; b--)
+    check_extent_data(obj, b * blk + b * 29, 64);
+  TEST_ASSERT_GREATER_OR_EQUAL(blocks - 1, check_extents(obj));
+
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_CloseObject(obj));
+  TEST_ASSERT_NULL(obj->extents);
+  uffs_PutObject(obj);
+
+  TEST_ASSERT_EQUAL(0, uffs_remove("/data/ext.bin"));
+  free(data);
+}
+#endif
+
+TEST_CASE("spi nand command chain", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  const uint32_t page_addr = block * priv->block_size + 3;
+  uint8_t data[256], spare[16], rd[256], rd_spare[16];
+  spi_nand_chain_t chain;
+
+  for (int i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)(i ^ 0x5A);
+  memset(spare, 0xA5, sizeof(spare));
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->EraseBlock(&uffs_dev, block));
+
+  // More transactions than the queue depth, results collected on the way
+  uint8_t cmd_we = CMD_WRITE_ENABLE;
+  uint8_t cmd_load[3] = {CMD_PROGRAM_LOAD, 0, 0};
+  uint8_t cmd_random[3] = {CMD_PROGRAM_LOAD_RANDOM, priv->page_size >> 8,
+                           priv->page_size & 0xFF};
+  uint8_t cmd_exec[4] = {CMD_PROGRAM_EXECUTE, page_addr >> 16,
+                         page_addr >> 8, page_addr};
+  spi_nand_chain_init(&chain, priv->spi);
+  TEST_ASSERT_EQUAL(ESP_OK,
+                    spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_add(&chain, cmd_load, 3, data, 128,
+                                               NULL, 0));
+  uint8_t cmd_mid[3] = {CMD_PROGRAM_LOAD_RANDOM, 0, 128};
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_add(&chain, cmd_mid, 3, data + 128,
+                                               128, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_add(&chain, cmd_random, 3, spare,
+                                               sizeof(spare), NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK,
+                    spi_nand_chain_add(&chain, cmd_exec, 4, NULL, 0, NULL, 0));
+  TEST_ASSERT_GREATER_THAN(SPI_NAND_QUEUE_DEPTH, chain.count);
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_submit(&chain));
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_wait(&chain));
+  TEST_ASSERT_EQUAL(0, chain.count);
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_wait_busy(priv->spi, NAND_TIMEOUT_MS,
+                                               NULL));
+
+  uint8_t cmd_read[4] = {CMD_PAGE_READ, page_addr >> 16, page_addr >> 8,
+                         page_addr};
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_op(priv->spi, cmd_read, 4, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_read_from_cache(priv, rd, sizeof(rd),
+                                                     rd_spare,
+                                                     sizeof(rd_spare)));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, sizeof(data));
+  TEST_ASSERT_EQUAL_MEMORY(spare, rd_spare, sizeof(spare));
+
+  // Overflow is reported on run, nothing is sent
+  for (int i = 0; i <= SPI_NAND_CHAIN_MAX; i++)
+    spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, spi_nand_chain_run(&chain));
+  TEST_ASSERT_EQUAL(ESP_OK,
+                    spi_nand_chain_add(&chain, &cmd_we, 1, NULL, 0, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_chain_run(&chain));
+
+  scratch_block_put(scratch);
+}
+
+extern uint32_t mock_busy_us; // From mock_spi_master.c
+
+// Program and read back a page a few times, return the summed wait stats
+static void busy_wait_run(uint32_t block, spi_nand_wait_stats_t *prog,
+                          spi_nand_wait_stats_t *read) {
+  uint8_t data[64], rd[64];
+
+  memset(data, 0x3C, sizeof(data));
+  esp_uffs_spi_nand_reset_wait_stats(&uffs_dev);
+  for (int page = 0; page < 4; page++) {
+    TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                      uffs_dev.ops->WritePage(&uffs_dev, block, page, data,
+                                              sizeof(data), NULL, 0));
+    TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(uffs_dev.ops->ReadPage(
+        &uffs_dev, block, page, rd, sizeof(rd), NULL, NULL, 0)));
+    TEST_ASSERT_EQUAL_MEMORY(data, rd, sizeof(data));
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, esp_uffs_spi_nand_get_wait_stats(
+                                &uffs_dev, SPI_NAND_WAIT_PROG, prog));
+  TEST_ASSERT_EQUAL(ESP_OK, esp_uffs_spi_nand_get_wait_stats(
+                                &uffs_dev, SPI_NAND_WAIT_READ, read));
+}
+
+TEST_CASE("spi nand adaptive busy wait", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  spi_nand_wait_stats_t tick_prog, tick_read, prog, read, erase;
+
+  TEST_ASSERT_EQUAL(SPI_NAND_WAIT_MODE_ADAPTIVE, priv->wait_mode);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                    esp_uffs_spi_nand_get_wait_stats(
+                        &uffs_dev, SPI_NAND_WAIT_OP_MAX, &prog));
+
+  // Chip busy for 300 us after each array operation
+  mock_busy_us = 300;
+
+  // Polling once per tick: every wait takes a whole tick
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_TICK, 50, 300, 2000);
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->EraseBlock(&uffs_dev, block));
+  busy_wait_run(block, &tick_prog, &tick_read);
+
+  // Adaptive: sleep through the typical time, then poll
+  spi_nand_wait_init(priv, SPI_NAND_WAIT_MODE_ADAPTIVE, 50, 300, 2000);
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->EraseBlock(&uffs_dev, block));
+  TEST_ASSERT_EQUAL(ESP_OK, esp_uffs_spi_nand_get_wait_stats(
+                                &uffs_dev, SPI_NAND_WAIT_ERASE, &erase));
+  TEST_ASSERT_EQUAL(1, erase.count);
+  busy_wait_run(block, &prog, &read);
+
+  ESP_LOGI(TAG,
+           PFX "Busy wait prog: tick %" PRIu32 " us / %" PRIu32
+               " polls, adaptive %" PRIu32 " us / %" PRIu32 " polls",
+           (uint32_t)tick_prog.total_us, tick_prog.polls,
+           (uint32_t)prog.total_us, prog.polls);
+
+  TEST_ASSERT_EQUAL(4, tick_prog.count);
+  TEST_ASSERT_EQUAL(4, prog.count);
+  TEST_ASSERT_EQUAL(4, read.count);
+  TEST_ASSERT_GREATER_OR_EQUAL(4 * 300, (uint32_t)prog.total_us);
+  TEST_ASSERT_GREATER_OR_EQUAL(300, prog.max_us);
+  TEST_ASSERT_GREATER_OR_EQUAL(4, prog.sleeps);
+  TEST_ASSERT_LESS_THAN((uint32_t)tick_prog.total_us, (uint32_t)prog.total_us);
+  TEST_ASSERT_LESS_THAN((uint32_t)tick_read.total_us, (uint32_t)read.total_us);
+
+  mock_busy_us = 0;
+  scratch_block_put(scratch);
+}
+
+extern uint32_t mock_cache_read_count; // From mock_spi_master.c
+
+TEST_CASE("spi nand single cache read", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  uint8_t *data = malloc(priv->page_size);
+  uint8_t *rd = malloc(priv->page_size);
+  uint8_t spare[16], rd_spare[16];
+
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < priv->page_size; i++)
+    data[i] = (uint8_t)(i ^ (i >> 8));
+  for (int i = 0; i < sizeof(spare); i++)
+    spare[i] = (uint8_t)(0xF0 - i);
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 1, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+
+  // Whole page with spare: one cache read, split afterwards
+  mock_cache_read_count = 0;
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(
+      uffs_dev.ops->ReadPage(&uffs_dev, block, 1, rd, priv->page_size, NULL,
+                             rd_spare, sizeof(rd_spare))));
+  TEST_ASSERT_EQUAL(1, mock_cache_read_count);
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, priv->page_size);
+  TEST_ASSERT_EQUAL_MEMORY(spare, rd_spare, sizeof(spare));
+
+  // Part of the page with spare: the columns are apart, two reads
+  mock_cache_read_count = 0;
+  memset(rd_spare, 0, sizeof(rd_spare));
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(
+      uffs_dev.ops->ReadPage(&uffs_dev, block, 1, rd, 100, NULL, rd_spare,
+                             sizeof(rd_spare))));
+  TEST_ASSERT_EQUAL(2, mock_cache_read_count);
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, 100);
+  TEST_ASSERT_EQUAL_MEMORY(spare, rd_spare, sizeof(spare));
+
+  free(data);
+  free(rd);
+  scratch_block_put(scratch);
+}
+
+extern uint32_t mock_program_load_count; // From mock_spi_master.c
+extern uint32_t mock_unaligned_tx;       // From mock_spi_master.c
+
+TEST_CASE("spi nand single program load", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  const int hdr = 16;
+  uint8_t *data = malloc(priv->page_size);
+  uint8_t *rd = malloc(priv->page_size);
+  uint8_t spare[16], rd_spare[16];
+
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < priv->page_size; i++)
+    data[i] = (uint8_t)(i * 3 + 1);
+  memset(spare, 0x6C, sizeof(spare));
+
+  // Whole page with spare: one load, straight from the aligned bounce buffer
+  mock_program_load_count = 0;
+  mock_unaligned_tx = 0;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 0, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+  TEST_ASSERT_EQUAL(1, mock_program_load_count);
+
+  // Header and data pieces of a whole page are staged together as well
+  mock_program_load_count = 0;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePageDirect(
+                        &uffs_dev, block, 1, data, hdr, data + hdr,
+                        priv->page_size - hdr, spare, sizeof(spare)));
+  TEST_ASSERT_EQUAL(1, mock_program_load_count);
+  TEST_ASSERT_EQUAL(0, mock_unaligned_tx);
+
+  // Part of a page: data and spare loaded separately
+  mock_program_load_count = 0;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 2, data, 100,
+                                            spare, sizeof(spare)));
+  TEST_ASSERT_EQUAL(2, mock_program_load_count);
+
+  for (int page = 0; page < 3; page++) {
+    int len = page < 2 ? priv->page_size : 100;
+    memset(rd, 0, priv->page_size);
+    memset(rd_spare, 0, sizeof(rd_spare));
+    TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(
+        uffs_dev.ops->ReadPage(&uffs_dev, block, page, rd, priv->page_size,
+                               NULL, rd_spare, sizeof(rd_spare))));
+    TEST_ASSERT_EQUAL_MEMORY(data, rd, len);
+    TEST_ASSERT_EQUAL_MEMORY(spare, rd_spare, sizeof(spare));
+    if (len < priv->page_size)
+      TEST_ASSERT_EQUAL(0xFF, rd[len]);
+  }
+
+  free(data);
+  free(rd);
+  scratch_block_put(scratch);
+}
+
+extern uint32_t mock_cache_read_bytes; // From mock_spi_master.c
+
+TEST_CASE("spi nand tag-only spare read", "[uffs][spi]") {
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  const int tag_bytes =
+      uffs_dev.mem.spare_data_size - uffs_dev.mem.spare_tag_offs;
+  int (*read_spare)(uffs_Device *, u32, u32, int, u8 *, int) =
+      uffs_dev.ops->ReadPageSpare;
+  uffs_Tags tag, ref;
+
+  int fd = uffs_open("/data/tag.txt", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(3, uffs_write(fd, "tag", 3));
+  uffs_close(fd);
+  TEST_ASSERT_NOT_NULL(read_spare);
+  TEST_ASSERT_GREATER_THAN(0, uffs_dev.mem.spare_tag_offs);
+
+  // Tags read with and without the spare column read must be the same
+  for (int b = 0; b < 16; b++) {
+    memset(&tag, 0, sizeof(tag));
+    memset(&ref, 0, sizeof(ref));
+    mock_cache_read_bytes = 0;
+    int ret = uffs_FlashReadPageTag(&uffs_dev, b, 0, &tag);
+    TEST_ASSERT_EQUAL(tag_bytes, mock_cache_read_bytes);
+
+    uffs_dev.ops->ReadPageSpare = NULL;
+    mock_cache_read_bytes = 0;
+    TEST_ASSERT_EQUAL(ret, uffs_FlashReadPageTag(&uffs_dev, b, 0, &ref));
+    TEST_ASSERT_EQUAL(uffs_dev.mem.spare_data_size, mock_cache_read_bytes);
+    uffs_dev.ops->ReadPageSpare = read_spare;
+
+    TEST_ASSERT_EQUAL_MEMORY(&ref.s, &tag.s, sizeof(tag.s));
+    TEST_ASSERT_EQUAL(ref.seal_byte, tag.seal_byte);
+  }
+
+  // Bad block status byte of the second page, one byte over the bus
+  uint8_t spare[1] = {0x00}, status = 0xFF;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 1, NULL, 0,
+                                            spare, sizeof(spare)));
+  mock_cache_read_bytes = 0;
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(uffs_dev.ops->ReadPageSpare(
+      &uffs_dev, block, 1, uffs_dev.attr->block_status_offs, &status, 1)));
+  TEST_ASSERT_EQUAL(1, mock_cache_read_bytes);
+  TEST_ASSERT_EQUAL(0x00, status);
+
+  // Without IsBadBlock() the marker is found through the spare read
+  int (*is_bad)(uffs_Device *, u32) = uffs_dev.ops->IsBadBlock;
+  uffs_dev.ops->IsBadBlock = NULL;
+  TEST_ASSERT_TRUE(uffs_FlashIsBadBlock(&uffs_dev, block));
+  TEST_ASSERT_FALSE(uffs_FlashIsBadBlock(&uffs_dev, block + 1));
+  uffs_dev.ops->IsBadBlock = is_bad;
+
+  scratch_block_put(scratch);
+}
+
+#ifdef CONFIG_UFFS_SPI_NAND_CACHE_PROGRAM
+extern uint32_t mock_busy_loads;    // From mock_spi_master.c
+extern uint32_t mock_busy_rejects;  // From mock_spi_master.c
+
+static int pipeline_stop_err = UFFS_FLASH_NO_ERR;
+
+// Pipeline op failing the next stop with pipeline_stop_err
+static int write_pipeline_stop_err(uffs_Device *dev, UBOOL on) {
+  int ret = uffs_spi_nand_write_pipeline_generic(dev, on);
+  if (!on && pipeline_stop_err != UFFS_FLASH_NO_ERR) {
+    ret = pipeline_stop_err;
+    pipeline_stop_err = UFFS_FLASH_NO_ERR;
+  }
+  return ret;
+}
+
+static int dirty_page_count(void) {
+  int n = 0;
+  for (int i = 0; i < uffs_dev.cfg.dirty_groups; i++)
+    n += uffs_dev.buf.dirtyGroup[i].count;
+  return n;
+}
+
+TEST_CASE("spi nand cache program", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  const int size = 64 * 1024;
+  uint8_t *data = malloc(size);
+  uint8_t *chk = malloc(size);
+  uint8_t spare[16];
+
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(chk);
+  for (int i = 0; i < size; i++)
+    data[i] = (uint8_t)(i * 5 + 2);
+  memset(spare, 0xFF, sizeof(spare));
+
+  // The mock chip takes program loads while busy as Micron does
+  TEST_ASSERT_NULL(uffs_dev.ops->WritePipeline);
+  mock_mfr_id = 0x2C;
+  mock_busy_us = 200;
+  uffs_dev.ops->WritePipeline = uffs_spi_nand_write_pipeline_generic;
+
+  // A failed page is reported by the next page write, or when stopping
+  mock_prog_fail_block = block;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePipeline(&uffs_dev, U_TRUE));
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 0, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+  TEST_ASSERT_EQUAL(UFFS_FLASH_BAD_BLK,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 1, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 2, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+  TEST_ASSERT_EQUAL(UFFS_FLASH_BAD_BLK,
+                    uffs_dev.ops->WritePipeline(&uffs_dev, U_FALSE));
+  mock_prog_fail_block = -1;
+
+  // Flush to a new block, then append to its free pages. Direct writes
+  // don't go through the buffer flush, turn them off.
+  int (*write_direct)(uffs_Device *, u32, u32, const u8 *, int, const u8 *,
+                      int, const u8 *, int) = uffs_dev.ops->WritePageDirect;
+  uffs_dev.ops->WritePageDirect = NULL;
+  mock_busy_loads = mock_busy_rejects = 0;
+  int fd = uffs_open("/data/cprog.bin", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size / 2, uffs_write(fd, data, size / 2));
+  uffs_close(fd);
+  fd = uffs_open("/data/cprog.bin", UO_WRONLY | UO_APPEND, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size / 2, uffs_write(fd, data + size / 2, size / 2));
+  uffs_close(fd);
+
+  ESP_LOGI(TAG, "Program loads while busy: %" PRIu32, mock_busy_loads);
+#if defined(CONFIG_PAGE_WRITE_VERIFY) && CONFIG_PAGE_WRITE_VERIFY_INTERVAL == 1
+  TEST_ASSERT_EQUAL(0, mock_busy_loads); // Pages are read back, no overlap
+#else
+  TEST_ASSERT_GREATER_THAN(0, mock_busy_loads);
+#endif
+  TEST_ASSERT_EQUAL(0, mock_busy_rejects);
+
+#if !defined(CONFIG_PAGE_WRITE_VERIFY) || CONFIG_PAGE_WRITE_VERIFY_INTERVAL != 1
+  // I/O error of the page left programming, reported when the pipeline
+  // stops: that page stays dirty and is written again by the next flush
+  uffs_dev.ops->WritePipeline = write_pipeline_stop_err;
+  pipeline_stop_err = UFFS_FLASH_IO_ERR;
+  fd = uffs_open("/data/cprog.bin", UO_WRONLY | UO_APPEND, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(priv->page_size * 2,
+                    uffs_write(fd, data, priv->page_size * 2));
+  uffs_close(fd);
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR, pipeline_stop_err);
+  TEST_ASSERT_EQUAL(1, dirty_page_count());
+  uffs_dev.ops->WritePipeline = uffs_spi_nand_write_pipeline_generic;
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_BufFlushAll(&uffs_dev));
+  TEST_ASSERT_EQUAL(0, dirty_page_count());
+#endif
+
+  uffs_dev.ops->WritePipeline = NULL;
+  uffs_dev.ops->WritePageDirect = write_direct;
+  mock_busy_us = 0;
+  mock_mfr_id = 0xEF;
+
+  fd = uffs_open("/data/cprog.bin", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size, uffs_read(fd, chk, size));
+  uffs_close(fd);
+  TEST_ASSERT_EQUAL_MEMORY(data, chk, size);
+
+  free(data);
+  free(chk);
+  scratch_block_put(scratch);
+}
+#endif
+
+TEST_CASE("uffs page write verify", "[uffs][verify]") {
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  TreeNode *scratch2 = scratch_block_get();
+  const uint32_t block2 = scratch2->u.list.block;
+  uffs_Buf *buf = uffs_BufClone(&uffs_dev, NULL);
+  uffs_Tags tag;
+  int ret;
+
+  TEST_ASSERT_NOT_NULL(buf);
+  for (int i = 0; i < uffs_dev.com.pg_data_size; i++)
+    buf->data[i] = (uint8_t)(i * 3 + 1);
+  memset(&tag, 0xFF, sizeof(tag));
+  tag.s.type = UFFS_TYPE_DATA;
+  tag.s.serial = 100;
+  tag.s.parent = 10;
+  tag.s.page_id = 0;
+  tag.s.data_len = uffs_dev.com.pg_data_size;
+
+  // Page, tag and mini header come back in one read
+  mock_page_read_count = 0;
+  mock_cache_read_bytes = 0;
+  ret = uffs_FlashWritePageCombine(&uffs_dev, block, 0, buf, &tag);
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(ret));
+#ifdef CONFIG_PAGE_WRITE_VERIFY
+  TEST_ASSERT_EQUAL(1, mock_page_read_count);
+#if CONFIG_PAGE_WRITE_VERIFY_LEVEL == UFFS_VERIFY_TAG
+  TEST_ASSERT_EQUAL(uffs_dev.com.header_size + uffs_dev.mem.spare_data_size,
+                    mock_cache_read_bytes);
+#else
+  TEST_ASSERT_EQUAL(uffs_dev.com.pg_size + uffs_dev.mem.spare_data_size,
+                    mock_cache_read_bytes);
+#endif
+#else
+  TEST_ASSERT_EQUAL(0, mock_page_read_count);
+#endif
+
+#if defined(CONFIG_PAGE_WRITE_VERIFY) && CONFIG_PAGE_WRITE_VERIFY_INTERVAL > 1
+  // Not sampled, left to the program status
+  mock_page_read_count = 0;
+  ret = uffs_FlashWritePageCombine(&uffs_dev, block, 1, buf, &tag);
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(ret));
+  TEST_ASSERT_EQUAL(0, mock_page_read_count);
+#endif
+
+  // Programming page 0 again ANDs the bits: the tag no longer matches
+  tag.s.serial = 101;
+  ret = uffs_FlashWritePageCombine(&uffs_dev, block, 0, buf, &tag);
+#ifdef CONFIG_PAGE_WRITE_VERIFY
+  TEST_ASSERT_EQUAL(UFFS_FLASH_BAD_BLK, ret);
+#else
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(ret));
+#endif
+
+  // Same tag, other data: only the full verify reads the data back
+  tag.s.serial = 100;
+  buf->data[0] ^= 0xFF;
+  ret = uffs_FlashWritePageCombine(&uffs_dev, block2, 0, buf, &tag);
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(ret));
+  buf->data[0] ^= 0xFF;
+  ret = uffs_FlashWritePageCombine(&uffs_dev, block2, 0, buf, &tag);
+#if defined(CONFIG_PAGE_WRITE_VERIFY) &&                                       \
+    CONFIG_PAGE_WRITE_VERIFY_LEVEL == UFFS_VERIFY_FULL
+  TEST_ASSERT_EQUAL(UFFS_FLASH_BAD_BLK, ret);
+#else
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(ret));
+#endif
+
+  uffs_BufFreeClone(&uffs_dev, buf);
+  scratch_block_put(scratch);
+  scratch_block_put(scratch2);
+}
+
+#ifdef CONFIG_UFFS_SPI_NAND_QUAD
+extern uint32_t mock_quad_bytes; // From mock_spi_master.c
+
+TEST_CASE("spi nand quad transfers", "[uffs][spi]") {
+  spi_nand_priv_t *priv = (spi_nand_priv_t *)uffs_dev.attr->_private;
+  TreeNode *scratch = scratch_block_get();
+  const uint32_t block = scratch->u.list.block;
+  uint8_t *data = malloc(priv->page_size);
+  uint8_t *rd = malloc(priv->page_size);
+  uint8_t spare[16], rd_spare[16];
+
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(rd);
+  for (int i = 0; i < priv->page_size; i++)
+    data[i] = (uint8_t)(i * 7);
+  memset(spare, 0x5A, sizeof(spare));
+
+  // Winbond: x4 without a QE bit, data and spare both on 4 lines
+  TEST_ASSERT_TRUE(priv->quad);
+  mock_quad_bytes = 0;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_NO_ERR,
+                    uffs_dev.ops->WritePage(&uffs_dev, block, 0, data,
+                                            priv->page_size, spare,
+                                            sizeof(spare)));
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(
+      uffs_dev.ops->ReadPage(&uffs_dev, block, 0, rd, priv->page_size, NULL,
+                             rd_spare, sizeof(rd_spare))));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, priv->page_size);
+  TEST_ASSERT_EQUAL_MEMORY(spare, rd_spare, sizeof(spare));
+  TEST_ASSERT_EQUAL(2 * (priv->page_size + sizeof(spare)), mock_quad_bytes);
+
+  // GigaDevice: QE bit set by InitFlash before x4 transfers
+  uffs_Device dev_gd;
+  uint8_t cmd_cfg[2] = {CMD_GET_FEATURE, REG_CONFIG};
+  uint8_t cfg = 0;
+  memset(&dev_gd, 0, sizeof(dev_gd));
+  mock_mfr_id = 0xC8;
+  TEST_ASSERT_EQUAL(ESP_OK,
+                    esp_uffs_spi_nand_init(&dev_gd, (spi_device_handle_t)0x1));
+  spi_nand_priv_t *priv_gd = (spi_nand_priv_t *)dev_gd.attr->_private;
+  TEST_ASSERT_FALSE(priv_gd->quad);
+  TEST_ASSERT_EQUAL(0, dev_gd.ops->InitFlash(&dev_gd));
+  TEST_ASSERT_TRUE(priv_gd->quad);
+  TEST_ASSERT_EQUAL(ESP_OK, spi_nand_op(priv_gd->spi, cmd_cfg, 2, &cfg, 1));
+  TEST_ASSERT_EQUAL(CFG_QE, cfg & CFG_QE);
+
+  memset(rd, 0, priv->page_size);
+  TEST_ASSERT_FALSE(UFFS_FLASH_HAVE_ERR(dev_gd.ops->ReadPage(
+      &dev_gd, block, 0, rd, priv->page_size, NULL, NULL, 0)));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd, priv->page_size);
+
+  mock_mfr_id = 0xEF;
+  free(dev_gd.attr->_private);
+  free(dev_gd.attr);
+  free(dev_gd.ops);
+  free(data);
+  free(rd);
+  scratch_block_put(scratch);
+}
+#endif
+
+TEST_CASE("uffs batched block scan", "[uffs][mount]") {
+  int fd = uffs_open("/data/scan.txt", UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(4, uffs_write(fd, "scan", 4));
+  uffs_close(fd);
+  TEST_ASSERT_NOT_NULL(uffs_dev.ops->ScanBlockMeta);
+
+  unmount_for_full_scan();
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  uint32_t batched_reads = mock_page_read_count;
+
+  // Same scan, reading the block meta one by one
+  int (*scan)(uffs_Device *, u32, const u32 *, int, u8 *, int, u8 *, int) =
+      uffs_dev.ops->ScanBlockMeta;
+  uffs_dev.ops->ScanBlockMeta = NULL;
+  unmount_for_full_scan();
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  uffs_dev.ops->ScanBlockMeta = scan;
+
+  ESP_LOGI(TAG, "Mount page reads: batched %" PRIu32 ", one by one %" PRIu32,
+           batched_reads, mock_page_read_count);
+  TEST_ASSERT_LESS_THAN(mock_page_read_count, batched_reads);
+
+  // The batch decodes the UFFS spare layout, leave other layouts to the driver
+  uffs_dev.attr->layout_opt = UFFS_LAYOUT_FLASH;
+  TEST_ASSERT_EQUAL(UFFS_FLASH_UNKNOWN_ERR,
+                    uffs_FlashScanBlockMeta(&uffs_dev, NULL, NULL));
+  uffs_dev.attr->layout_opt = UFFS_LAYOUT_UFFS;
+
+  char buf[8] = {0};
+  fd = uffs_open("/data/scan.txt", UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(4, uffs_read(fd, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_STRING("scan", buf);
+  uffs_close(fd);
+}
+
+#ifdef CONFIG_UFFS_SPI_NAND_BBT
+TEST_CASE("uffs bad block table", "[uffs][mount]") {
+  // Taken off the tree for good, it is found bad on the next mount
+  const int bad = scratch_block_get()->u.list.block;
+  char magic[4];
+
+  // Table blocks are kept away from UFFS
+  TEST_ASSERT_NOT_NULL(uffs_dev.ops->IsBadBlock);
+  for (int i = 0; i < SPI_NAND_BBT_BLOCKS; i++)
+    TEST_ASSERT_NOT_NULL(uffs_TreeFindBadNodeByBlock(&uffs_dev, i));
+
+  TEST_ASSERT_EQUAL(U_SUCC, uffs_FlashMarkBadBlock(&uffs_dev, bad));
+  unmount_for_full_scan();
+
+  // Marker on the block is lost, the table still has it
+  uffs_dev.ops->EraseBlock(&uffs_dev, bad);
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  ESP_LOGI(TAG, "Mount with bad block table: %" PRIu32 " page reads",
+           mock_page_read_count);
+  TEST_ASSERT_LESS_THAN(2 * uffs_dev.attr->total_blocks, mock_page_read_count);
+  TEST_ASSERT_NOT_NULL(uffs_TreeFindBadNodeByBlock(&uffs_dev, bad));
+
+  // One copy lost: loaded from the mirror, then repaired
+  unmount_for_full_scan();
+  uffs_dev.ops->EraseBlock(&uffs_dev, 0);
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_NOT_NULL(uffs_TreeFindBadNodeByBlock(&uffs_dev, bad));
+  uffs_dev.ops->ReadPage(&uffs_dev, 0, 0, (u8 *)magic, sizeof(magic), NULL,
+                         NULL, 0);
+  TEST_ASSERT_EQUAL_MEMORY("BBT0", magic, sizeof(magic));
+}
+
+extern uint32_t mock_erase_count; // From mock_spi_master.c
+
+// Header of the table copy in block, 0 if the block has no table
+static uint16_t bbt_copies_of(int block) {
+  struct {
+    uint32_t magic, version, blocks;
+    uint16_t crc, copies;
+  } hdr;
+  uffs_dev.ops->ReadPage(&uffs_dev, block, 0, (u8 *)&hdr, sizeof(hdr), NULL,
+                         NULL, 0);
+  return memcmp(&hdr.magic, "BBT0", 4) == 0 ? hdr.copies : 0;
+}
+
+TEST_CASE("uffs bad block table copies", "[uffs][mount]") {
+  const int offs = uffs_dev.attr->block_status_offs;
+  u8 spare[64];
+
+  // Stale copy: only that copy is rewritten
+  unmount_for_full_scan();
+  uffs_dev.ops->EraseBlock(&uffs_dev, 0);
+  mock_erase_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL(1, mock_erase_count);
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, bbt_copies_of(0));
+
+  // Copy that can't be written: dropped once, not retried on next mounts
+  unmount_for_full_scan();
+  uffs_dev.ops->EraseBlock(&uffs_dev, 0);
+  mock_prog_fail_block = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL_HEX16(0xFFFE, bbt_copies_of(1));
+  unmount_for_full_scan();
+  mock_erase_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL(0, mock_erase_count);
+  mock_prog_fail_block = -1;
+
+  // First use with a factory bad table block: its marker is kept
+  unmount_for_full_scan();
+  uffs_dev.ops->EraseBlock(&uffs_dev, 0);
+  uffs_dev.ops->EraseBlock(&uffs_dev, 1);
+  memset(spare, 0xFF, sizeof(spare));
+  spare[offs] = 0x00;
+  uffs_dev.ops->WritePage(&uffs_dev, 1, 0, NULL, 0, spare, offs + 1);
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL_HEX16(0xFFFD, bbt_copies_of(0));
+  memset(spare, 0xFF, sizeof(spare));
+  uffs_dev.ops->ReadPage(&uffs_dev, 1, 0, NULL, 0, NULL, spare, offs + 1);
+  TEST_ASSERT_EQUAL_HEX8(0x00, spare[offs]);
+}
+#endif
+
+#ifdef CONFIG_TREE_CHECKPOINT
+TEST_CASE("uffs tree checkpoint", "[uffs][mount]") {
+  const char *fname = "/data/ckpt.txt";
+  const char *content = "tree checkpoint";
+  char buf[32] = {0};
+
+  int fd = uffs_open(fname, UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(strlen(content), uffs_write(fd, content, strlen(content)));
+  uffs_close(fd);
+
+  // Clean unmount writes the checkpoint
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+
+  // Remount must restore the tree without scanning every block
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  ESP_LOGI(TAG, "Mount with checkpoint: %" PRIu32 " page reads",
+           mock_page_read_count);
+  TEST_ASSERT_LESS_THAN(uffs_dev.attr->total_blocks, mock_page_read_count);
+  TEST_ASSERT_EQUAL(UFFS_CKPT_STATE_CLEAN, uffs_dev.ckpt.state);
+
+  fd = uffs_open(fname, UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(strlen(content), uffs_read(fd, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_STRING(content, buf);
+  uffs_close(fd);
+
+  // Any flash modification is recorded in the journal
+  TEST_ASSERT_EQUAL(0, uffs_remove(fname));
+  TEST_ASSERT_GREATER_THAN(0, uffs_dev.ckpt.jnl_count);
+
+  // The new checkpoint taken on unmount reflects the removal
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_TRUE(uffs_open(fname, UO_RDONLY, 0) < 0);
+}
+
+TEST_CASE("uffs tree checkpoint journal replay", "[uffs][mount]") {
+  const char *fname = "/data/journal.bin";
+  const char *gone = "/data/gone.txt";
+  const int size = 300 * 1024; // spans several data blocks
+  uint8_t *data = malloc(size);
+  uint8_t *chk = malloc(size);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(chk);
+  for (int i = 0; i < size; i++)
+    data[i] = (uint8_t)(i * 7 + 3);
+
+  int fd = uffs_open(gone, UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  uffs_write(fd, "bye", 3);
+  uffs_close(fd);
+
+  // Take a checkpoint
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  TEST_ASSERT_EQUAL(UFFS_CKPT_STATE_CLEAN, uffs_dev.ckpt.state);
+
+  // Change the tree after the checkpoint
+  fd = uffs_open(fname, UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size, uffs_write(fd, data, size));
+  uffs_close(fd);
+  TEST_ASSERT_EQUAL(0, uffs_remove(gone));
+  TEST_ASSERT_EQUAL(UFFS_CKPT_STATE_CLEAN, uffs_dev.ckpt.state);
+  TEST_ASSERT_GREATER_THAN(0, uffs_dev.ckpt.jnl_count);
+
+  // Power loss: no new checkpoint is written
+  uffs_dev.ckpt.state = UFFS_CKPT_STATE_DISABLED;
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  uint32_t replay_reads = mock_page_read_count;
+
+  TEST_ASSERT_TRUE(uffs_open(gone, UO_RDONLY, 0) < 0);
+  fd = uffs_open(fname, UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size, uffs_seek(fd, 0, USEEK_END));
+  uffs_seek(fd, 0, USEEK_SET);
+  TEST_ASSERT_EQUAL(size, uffs_read(fd, chk, size));
+  TEST_ASSERT_EQUAL_MEMORY(data, chk, size);
+  uffs_close(fd);
+
+  // Same flash content without any checkpoint: full scan
+  uffs_dev.ckpt.state = UFFS_CKPT_STATE_DISABLED;
+  for (int i = 0; i < UFFS_CKPT_BLOCKS; i++)
+    uffs_dev.ops->EraseBlock(&uffs_dev, uffs_dev.ckpt.start + i);
+  TEST_ASSERT_EQUAL(0, uffs_UnMount("/data/"));
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  ESP_LOGI(TAG, "Mount page reads: journal replay %" PRIu32 ", full scan %" PRIu32,
+           replay_reads, mock_page_read_count);
+  TEST_ASSERT_LESS_THAN(mock_page_read_count, replay_reads);
+
+  free(data);
+  free(chk);
+}
+#endif
+
+#ifdef CONFIG_LAZY_MOUNT
+static TreeNode *find_root_file(const char *name) {
+  return uffs_TreeFindFileNodeByName(&uffs_dev, name, strlen(name),
+                                     uffs_MakeSum16(name, strlen(name)),
+                                     ROOT_DIR_SERIAL);
+}
+
+TEST_CASE("uffs lazy mount", "[uffs][mount]") {
+  const char *names[] = {"/data/lazy1.bin", "/data/lazy2.bin"};
+  const int size = 200 * 1024; // spans several data blocks
+  uint8_t *data = malloc(size);
+  uint8_t *chk = malloc(size);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_NOT_NULL(chk);
+  for (int i = 0; i < size; i++)
+    data[i] = (uint8_t)(i * 5 + 1);
+
+  for (int i = 0; i < 2; i++) {
+    int fd = uffs_open(names[i], UO_CREATE | UO_TRUNC | UO_WRONLY, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    TEST_ASSERT_EQUAL(size, uffs_write(fd, data, size));
+    uffs_close(fd);
+  }
+
+  unmount_for_full_scan();
+
+  mock_page_read_count = 0;
+  TEST_ASSERT_EQUAL(0, uffs_Mount("/data/"));
+  ESP_LOGI(TAG, "Lazy mount: %" PRIu32 " page reads", mock_page_read_count);
+
+  // DATA blocks are not checked by mount
+  TreeNode *node1 = find_root_file("lazy1.bin");
+  TreeNode *node2 = find_root_file("lazy2.bin");
+  TEST_ASSERT_NOT_NULL(node1);
+  TEST_ASSERT_NOT_NULL(node2);
+  TEST_ASSERT_EQUAL_HEX32(UFFS_LAZY_LEN, node1->u.file.len);
+  TEST_ASSERT_EQUAL_HEX32(UFFS_LAZY_LEN, node2->u.file.len);
+
+  // First open resolves the file
+  int fd = uffs_open(names[0], UO_RDONLY, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+  TEST_ASSERT_EQUAL(size, node1->u.file.len);
+  TEST_ASSERT_EQUAL(size, uffs_seek(fd, 0, USEEK_END));
+  uffs_seek(fd, 0, USEEK_SET);
+  TEST_ASSERT_EQUAL(size, uffs_read(fd, chk, size));
+  TEST_ASSERT_EQUAL_MEMORY(data, chk, size);
+  uffs_close(fd);
+  TEST_ASSERT_EQUAL_HEX32(UFFS_LAZY_LEN, node2->u.file.len);
+
+  // Background scan resolves the rest
+  TEST_ASSERT_EQUAL(0, uffs_lazy_scan("/data/"));
+  TEST_ASSERT_EQUAL(size, node2->u.file.len);
+
+  struct uffs_stat st;
+  TEST_ASSERT_EQUAL(0, uffs_stat(names[1], &st));
+  TEST_ASSERT_EQUAL(size, st.st_size);
+
+  free(data);
+  free(chk);
+}
+#endif
+
 void app_main(void) {
   ESP_LOGI(TAG, "Running UFFS Comprehensive Host Test Suite...");
 